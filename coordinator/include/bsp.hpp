@@ -0,0 +1,228 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <boost/asio.hpp>
+#include "partition.hpp"
+
+// Bulk synchronous traversal over a partitioned contact graph. Every
+// shard runs the same queries; in each superstep a shard expands its
+// frontier locally and batches the ghosts it reached into one message
+// per other shard. The exchange is all to all over a mesh of TCP
+// connections and doubles as the barrier between supersteps.
+class BspShard
+{
+private:
+    struct frame{
+        uint64_t value = 0;
+        uint32_t count = 0;
+        std::vector<uint32_t> ids;
+    };
+
+    shard_graph g;
+    boost::asio::io_context io;
+    std::vector<std::unique_ptr<boost::asio::ip::tcp::socket>> peers;
+    std::vector<uint64_t> visited; // Owned vertices reached by this query
+    std::vector<uint64_t> sent;    // Ghosts already passed to their owner
+
+    void exchange(std::vector<frame>& out, std::vector<frame>& in);
+    uint64_t sum(uint64_t value);
+public:
+    explicit BspShard(shard_graph g);
+
+    // Joins the mesh of shards listening on base_port + shard. Blocks
+    // until every shard is connected.
+    void Connect(const std::string& host, uint16_t base_port);
+
+    // Number of vertices within k hops of vertex local on shard source,
+    // over all shards. Every shard must make the same call.
+    uint64_t KHop(uint32_t source, uint32_t local, uint32_t k);
+
+    const shard_graph& Graph() const { return g; }
+};
+
+inline BspShard::BspShard(shard_graph g) : g(std::move(g)){
+    peers.resize(this->g.shards);
+    visited.assign((this->g.owned + 63) / 64, 0);
+    sent.assign((this->g.Ghosts() + 63) / 64, 0);
+}
+
+inline void BspShard::Connect(const std::string& host, uint16_t base_port){
+    using boost::asio::ip::tcp;
+    tcp::acceptor acceptor(io, tcp::endpoint(tcp::v4(), base_port + g.shard));
+    auto address = boost::asio::ip::make_address(host);
+
+    // Lower shards are dialled, higher ones dial in
+    for(uint32_t s = 0; s < g.shard; s++){
+        auto socket = std::unique_ptr<tcp::socket>(new tcp::socket(io));
+        for(int tries = 0; ; tries++){
+            boost::system::error_code ec;
+            socket->connect(tcp::endpoint(address, base_port + s), ec);
+            if(!ec){
+                break;
+            }
+            socket->close();
+            if(tries == 500){
+                throw std::runtime_error("Shard " + std::to_string(s) + " is not listening");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        boost::asio::write(*socket, boost::asio::buffer(&g.shard, sizeof(g.shard)));
+        socket->set_option(tcp::no_delay(true));
+        peers[s] = std::move(socket);
+    }
+    for(uint32_t i = g.shard + 1; i < g.shards; i++){
+        auto socket = std::unique_ptr<tcp::socket>(new tcp::socket(io));
+        acceptor.accept(*socket);
+        uint32_t s;
+        boost::asio::read(*socket, boost::asio::buffer(&s, sizeof(s)));
+        if(s <= g.shard || s >= g.shards || peers[s]){
+            throw std::runtime_error("Unexpected shard " + std::to_string(s));
+        }
+        socket->set_option(tcp::no_delay(true));
+        peers[s] = std::move(socket);
+    }
+}
+
+// Sends out[s] to every other shard s and fills in[s] with what it sent
+// here. All writes and reads are in flight together, so large batches
+// can not deadlock on full socket buffers.
+inline void BspShard::exchange(std::vector<frame>& out, std::vector<frame>& in){
+    boost::system::error_code failed;
+    in.resize(g.shards);
+    for(uint32_t s = 0; s < g.shards; s++){
+        if(s == g.shard){
+            continue;
+        }
+        frame& o = out[s];
+        o.count = static_cast<uint32_t>(o.ids.size());
+        std::vector<boost::asio::const_buffer> bufs{
+            boost::asio::buffer(&o.value, sizeof(o.value)),
+            boost::asio::buffer(&o.count, sizeof(o.count)),
+            boost::asio::buffer(o.ids)};
+        boost::asio::async_write(*peers[s], bufs,
+            [&failed](boost::system::error_code ec, size_t){
+                if(ec){
+                    failed = ec;
+                }
+            });
+
+        // A shard passes each vertex it owns here at most once a query
+        frame& f = in[s];
+        auto& socket = *peers[s];
+        uint32_t owned = g.owned;
+        std::vector<boost::asio::mutable_buffer> head{
+            boost::asio::buffer(&f.value, sizeof(f.value)),
+            boost::asio::buffer(&f.count, sizeof(f.count))};
+        boost::asio::async_read(socket, head,
+            [&failed, &f, &socket, owned](boost::system::error_code ec, size_t){
+                if(!ec && f.count > owned){
+                    ec = boost::asio::error::message_size;
+                }
+                if(ec){
+                    failed = ec;
+                    return;
+                }
+                f.ids.resize(f.count);
+                boost::asio::async_read(socket, boost::asio::buffer(f.ids),
+                    [&failed](boost::system::error_code ec, size_t){
+                        if(ec){
+                            failed = ec;
+                        }
+                    });
+            });
+    }
+    io.restart();
+    io.run();
+    if(failed){
+        throw std::runtime_error("Shard exchange failed: " + failed.message());
+    }
+}
+
+// Sum of value over all shards
+inline uint64_t BspShard::sum(uint64_t value){
+    std::vector<frame> out(g.shards), in;
+    for(auto& o : out){
+        o.value = value;
+    }
+    exchange(out, in);
+    for(uint32_t s = 0; s < g.shards; s++){
+        if(s != g.shard){
+            value += in[s].value;
+        }
+    }
+    return value;
+}
+
+inline uint64_t BspShard::KHop(uint32_t source, uint32_t local, uint32_t k){
+    std::fill(visited.begin(), visited.end(), 0);
+    std::fill(sent.begin(), sent.end(), 0);
+    std::vector<uint32_t> frontier, next;
+    if(source == g.shard && local < g.owned){
+        visited[local / 64] |= 1ULL << (local % 64);
+        frontier.push_back(local);
+    }
+    uint64_t reached = frontier.size();
+
+    std::vector<frame> out(g.shards), in;
+    for(uint32_t hop = 0; hop < k; hop++){
+        next.clear();
+        for(auto& o : out){
+            o.ids.clear();
+        }
+        for(uint32_t u : frontier){
+            for(uint64_t e = g.csr.offsets[u]; e < g.csr.offsets[u + 1]; e++){
+                uint32_t v = g.csr.edges[e];
+                if(v < g.owned){
+                    if(!(visited[v / 64] >> (v % 64) & 1)){
+                        visited[v / 64] |= 1ULL << (v % 64);
+                        next.push_back(v);
+                    }
+                }else{
+                    uint32_t i = v - g.owned;
+                    if(!(sent[i / 64] >> (i % 64) & 1)){
+                        sent[i / 64] |= 1ULL << (i % 64);
+                        out[g.ghost_owner[i]].ids.push_back(g.ghost_local[i]);
+                    }
+                }
+            }
+        }
+
+        // Every shard learns how much work is left anywhere, so all stop
+        // on the same superstep
+        uint64_t active = next.size();
+        for(auto& o : out){
+            active += o.ids.size();
+        }
+        for(auto& o : out){
+            o.value = active;
+        }
+        exchange(out, in);
+        for(uint32_t s = 0; s < g.shards; s++){
+            if(s == g.shard){
+                continue;
+            }
+            active += in[s].value;
+            for(uint32_t v : in[s].ids){
+                if(v >= g.owned){
+                    throw std::runtime_error("Shard message names an unknown vertex");
+                }
+                if(!(visited[v / 64] >> (v % 64) & 1)){
+                    visited[v / 64] |= 1ULL << (v % 64);
+                    next.push_back(v);
+                }
+            }
+        }
+        reached += next.size();
+        frontier.swap(next);
+        if(active == 0){
+            break;
+        }
+    }
+    return sum(reached);
+}
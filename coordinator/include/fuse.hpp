@@ -0,0 +1,409 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/types/vector.hpp>
+#include <secovid/tokens.hpp>
+
+// Binary fuse filters over the infected tokens the coordinator publishes
+// (Graf and Lemire, "Binary Fuse Filters: Fast and Smaller Than Xor
+// Filters"). A key sets three slots in consecutive segments of an array
+// of fingerprints so that their xor is the key's fingerprint; a lookup
+// is three reads and nothing is stored per key but its fingerprint.
+//
+// With 8 bit fingerprints a key costs about 9 bits and a token that was
+// never published matches 1 time in 256; with 16 bits, about 18 bits
+// and 1 in 65536. A hit is only a hint, confirmed through the mailbox.
+//
+// Builds are deterministic: hashes are sorted before they are placed,
+// and seeds count up from a fixed start, so every coordinator publishes
+// byte identical filters for the same tokens.
+
+inline uint64_t fuse_mix(uint64_t h){
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Sorts uniformly spread 64 bit values: a counting pass on the top 11
+// bits, then each bucket on its own while it is in cache
+inline void sort_hashes(std::vector<uint64_t>& v){
+    std::vector<uint64_t> tmp(v.size());
+    std::vector<size_t> end(2048, 0);
+    for(uint64_t x : v){
+        end[x >> 53]++;
+    }
+    size_t sum = 0;
+    for(auto& e : end){
+        sum += e;
+        e = sum - e; // Start for now
+    }
+    for(uint64_t x : v){
+        tmp[end[x >> 53]++] = x;
+    }
+    #pragma omp parallel for schedule(dynamic, 16)
+    for(int b = 0; b < 2048; b++){
+        std::sort(tmp.begin() + (b == 0 ? 0 : end[b - 1]), tmp.begin() + end[b]);
+    }
+    v.swap(tmp);
+}
+
+inline uint64_t token_key(const rolling_token& t){
+    return fuse_mix(t.hi ^ fuse_mix(t.lo));
+}
+
+template<class T>
+class BinaryFuseFilter
+{
+private:
+    const static int MAX_ATTEMPTS = 100;
+
+    uint64_t seed = 0;
+    uint32_t segment_length = 0;
+    uint32_t segment_mask = 0;
+    uint32_t segment_count_length = 0;
+    std::vector<T> fingerprints;
+
+    uint32_t position(int i, uint64_t hash) const;
+    static T fingerprint(uint64_t hash) { return static_cast<T>(hash ^ (hash >> 32)); }
+    bool build(const std::vector<uint64_t>& keys);
+public:
+    BinaryFuseFilter() {}
+    // Filter over keys, which may repeat
+    explicit BinaryFuseFilter(std::vector<uint64_t> keys);
+
+    bool Contains(uint64_t key) const;
+    bool Contains(const rolling_token& t) const { return Contains(token_key(t)); }
+    uint64_t Bytes() const { return fingerprints.size() * sizeof(T); }
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(seed, segment_length, segment_count_length, fingerprints);
+        segment_mask = segment_length - 1;
+    }
+    // Throws if a deserialized filter could read out of bounds
+    void Check() const;
+};
+typedef BinaryFuseFilter<uint8_t> BinaryFuse8;
+typedef BinaryFuseFilter<uint16_t> BinaryFuse16;
+
+template<class T>
+inline uint32_t BinaryFuseFilter<T>::position(int i, uint64_t hash) const{
+    uint32_t h = static_cast<uint32_t>((static_cast<unsigned __int128>(hash) * segment_count_length) >> 64);
+    if(i == 1){
+        h += segment_length;
+        h ^= static_cast<uint32_t>(hash >> 18) & segment_mask;
+    }else if(i == 2){
+        h += 2 * segment_length;
+        h ^= static_cast<uint32_t>(hash) & segment_mask;
+    }
+    return h;
+}
+
+template<class T>
+inline BinaryFuseFilter<T>::BinaryFuseFilter(std::vector<uint64_t> keys){
+    if(keys.empty()){
+        return;
+    }
+
+    // Segment sizes and slack from the paper, for three hashes
+    uint64_t n = keys.size();
+    double logn = std::log(std::max<double>(n, 2));
+    segment_length = n <= 1 ? 4 : 1u << static_cast<int>(std::floor(logn / std::log(3.33) + 2.25));
+    segment_length = std::min<uint32_t>(segment_length, 1 << 18);
+    segment_mask = segment_length - 1;
+    double factor = n <= 1 ? 0 : std::max(1.125, 0.875 + 0.25 * std::log(1e6) / logn);
+    uint64_t capacity = static_cast<uint64_t>(std::round(n * factor));
+    uint64_t segments = std::max<uint64_t>((capacity + segment_length - 1) / segment_length, 3) - 2;
+    segment_count_length = static_cast<uint32_t>(segments * segment_length);
+    fingerprints.assign((segments + 2) * segment_length, 0);
+
+    for(int attempt = 0; attempt < MAX_ATTEMPTS; attempt++){
+        seed = fuse_mix(0x5ec0 + attempt);
+        if(build(keys)){
+            return;
+        }
+    }
+    throw std::runtime_error("Could not build a binary fuse filter");
+}
+
+// Peels the 3-hypergraph of the keys' slots and assigns fingerprints in
+// reverse, false if the seed leaves a cycle
+template<class T>
+inline bool BinaryFuseFilter<T>::build(const std::vector<uint64_t>& keys){
+    size_t m = fingerprints.size();
+    std::vector<uint64_t> hashes(keys.size());
+    #pragma omp parallel for
+    for(size_t i = 0; i < keys.size(); i++){
+        hashes[i] = fuse_mix(keys[i] + seed);
+    }
+    // The first slot grows with the hash, so in hash order the slots are
+    // visited nearly in order. Repeated keys would never peel.
+    sort_hashes(hashes);
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    size_t n = hashes.size();
+
+    // Keys per slot, times 4, with the xor of which hash put them there
+    // in the low bits, and the xor of their hashes
+    std::vector<uint8_t> count(m, 0);
+    std::vector<uint64_t> xored(m, 0);
+    for(uint64_t h : hashes){
+        for(int i = 0; i < 3; i++){
+            uint32_t p = position(i, h);
+            if(count[p] >= 0xfc){
+                return false;
+            }
+            count[p] = static_cast<uint8_t>((count[p] + 4) ^ i);
+            xored[p] ^= h;
+        }
+    }
+
+    std::vector<uint32_t> queue;
+    for(uint32_t p = 0; p < m; p++){
+        if(count[p] >> 2 == 1){
+            queue.push_back(p);
+        }
+    }
+    std::vector<uint64_t> order;
+    std::vector<uint8_t> which;
+    order.reserve(n);
+    which.reserve(n);
+    while(!queue.empty()){
+        uint32_t p = queue.back();
+        queue.pop_back();
+        if(count[p] >> 2 != 1){
+            continue;
+        }
+        uint64_t h = xored[p];
+        int found = count[p] & 3;
+        order.push_back(h);
+        which.push_back(static_cast<uint8_t>(found));
+        for(int i = 0; i < 3; i++){
+            if(i == found){
+                continue;
+            }
+            uint32_t q = position(i, h);
+            count[q] = static_cast<uint8_t>((count[q] - 4) ^ i);
+            xored[q] ^= h;
+            if(count[q] >> 2 == 1){
+                queue.push_back(q);
+            }
+        }
+        count[p] = 0;
+    }
+    if(order.size() != n){
+        return false;
+    }
+
+    std::fill(fingerprints.begin(), fingerprints.end(), 0);
+    for(size_t k = n; k-- > 0; ){
+        uint64_t h = order[k];
+        T f = fingerprint(h);
+        for(int i = 0; i < 3; i++){
+            if(i != which[k]){
+                f ^= fingerprints[position(i, h)];
+            }
+        }
+        fingerprints[position(which[k], h)] = f;
+    }
+    return true;
+}
+
+template<class T>
+inline bool BinaryFuseFilter<T>::Contains(uint64_t key) const{
+    if(fingerprints.empty()){
+        return false;
+    }
+    uint64_t h = fuse_mix(key + seed);
+    T f = fingerprint(h);
+    f ^= fingerprints[position(0, h)] ^ fingerprints[position(1, h)] ^ fingerprints[position(2, h)];
+    return f == 0;
+}
+
+template<class T>
+inline void BinaryFuseFilter<T>::Check() const{
+    if(fingerprints.empty()){
+        return;
+    }
+    if(segment_length == 0 || (segment_length & (segment_length - 1))
+        || segment_count_length % segment_length
+        || fingerprints.size() != static_cast<uint64_t>(segment_count_length) + 2 * segment_length){
+        throw std::runtime_error("Malformed binary fuse filter");
+    }
+}
+
+// One day's infected tokens as published: a filter per batch appended
+// during the day, usually one an hour. Clients fetch only the batches
+// they have not seen, and a day can be compacted into a single filter
+// once it is over.
+//
+// Only the coordinator, which appended every batch and so holds their
+// keys, can compact; clients only ever hold filters. A compacted day
+// takes no more batches. Serialize from a client's Cursor sends a
+// client still on the batches the one filter, which replaces them on
+// Apply, and sends nothing to a client that already has it.
+//
+// A lookup checks every batch, so false positives add up: 24 hourly
+// batches of 8 bit fingerprints match about 1 token in 11, not 1 in
+// 256. Small batches also cost more per key, as the fuse segments do
+// not shrink with them: a batch of a hundred keys takes 15 bits a key
+// at 8 bits, 30 at 16. Batches are 16 bit by default, which keeps a
+// full day near 1 in 2700; FalsePositiveRate gives the bound for the
+// batches held, and Compact brings it back to one filter's.
+template<class T = uint16_t>
+class DailyFilter
+{
+private:
+    uint32_t day = 0;
+    std::vector<BinaryFuseFilter<T>> batches;
+    std::vector<uint64_t> keys; // Kept by the coordinator for Compact, never sent
+    size_t keyed = 0;           // Batches whose keys are in keys
+    bool compacted = false;
+public:
+    // Cursor of a client holding the compacted day
+    const static uint64_t COMPACTED = UINT64_MAX;
+
+    DailyFilter() {}
+    explicit DailyFilter(uint32_t day) : day(day) {}
+
+    uint32_t Day() const { return day; }
+    size_t Batches() const { return batches.size(); }
+    bool Compacted() const { return compacted; }
+    // Where this filter's next update starts, to pass to Serialize
+    uint64_t Cursor() const { return compacted ? COMPACTED : batches.size(); }
+    uint64_t Bytes() const;
+    // Chance that a token never published matches some batch
+    double FalsePositiveRate() const;
+
+    // Publishes tokens as a new batch
+    void Append(const std::vector<rolling_token>& tokens);
+    // Rebuilds every batch into one filter. Throws unless this filter
+    // appended every batch it holds.
+    void Compact();
+    bool Contains(const rolling_token& t) const;
+
+    // Update for a client at cursor first: the batches from first on
+    // while the day is open, the compacted filter once it is not
+    std::string Serialize(uint64_t first = 0) const;
+    // Applies an update serialized from this filter's Cursor
+    void Apply(const std::string& cdata);
+};
+
+template<class T>
+inline uint64_t DailyFilter<T>::Bytes() const{
+    uint64_t bytes = 0;
+    for(auto& b : batches){
+        bytes += b.Bytes();
+    }
+    return bytes;
+}
+
+template<class T>
+inline double DailyFilter<T>::FalsePositiveRate() const{
+    double miss = 1.0 - std::ldexp(1.0, -8 * static_cast<int>(sizeof(T)));
+    return 1.0 - std::pow(miss, static_cast<double>(batches.size()));
+}
+
+template<class T>
+inline void DailyFilter<T>::Append(const std::vector<rolling_token>& tokens){
+    if(compacted){
+        throw std::runtime_error("Filter day is compacted");
+    }
+    std::vector<uint64_t> batch(tokens.size());
+    #pragma omp parallel for
+    for(size_t i = 0; i < tokens.size(); i++){
+        batch[i] = token_key(tokens[i]);
+    }
+    keys.insert(keys.end(), batch.begin(), batch.end());
+    batches.emplace_back(std::move(batch));
+    keyed++;
+}
+
+template<class T>
+inline void DailyFilter<T>::Compact(){
+    if(compacted){
+        return;
+    }
+    if(keyed != batches.size()){
+        throw std::runtime_error("Filter does not hold the keys of every batch");
+    }
+    BinaryFuseFilter<T> all(keys);
+    batches.clear();
+    batches.push_back(std::move(all));
+    std::vector<uint64_t>().swap(keys);
+    keyed = 0;
+    compacted = true;
+}
+
+template<class T>
+inline bool DailyFilter<T>::Contains(const rolling_token& t) const{
+    uint64_t key = token_key(t);
+    for(auto& b : batches){
+        if(b.Contains(key)){
+            return true;
+        }
+    }
+    return false;
+}
+
+template<class T>
+inline std::string DailyFilter<T>::Serialize(uint64_t first) const{
+    std::vector<BinaryFuseFilter<T>> rest;
+    uint64_t from = first;
+    if(compacted && first != COMPACTED){
+        rest = batches;
+        from = 0;
+    }else if(first < batches.size()){
+        rest.assign(batches.begin() + first, batches.end());
+    }
+    std::stringstream ss;
+    {
+        cereal::PortableBinaryOutputArchive oarchive(ss);
+        oarchive(day, compacted, from, rest);
+    }
+    return ss.str();
+}
+
+template<class T>
+inline void DailyFilter<T>::Apply(const std::string& cdata){
+    std::stringstream ss(cdata);
+    uint32_t d;
+    bool whole;
+    uint64_t from;
+    std::vector<BinaryFuseFilter<T>> rest;
+    {
+        cereal::PortableBinaryInputArchive iarchive(ss);
+        iarchive(d, whole, from, rest);
+    }
+    for(auto& b : rest){
+        b.Check();
+    }
+    if(batches.empty() && !compacted){
+        day = d;
+    }
+    bool follows = whole
+        ? (from == 0 && rest.size() == 1) || (from == COMPACTED && rest.empty() && compacted)
+        : !compacted && from == batches.size();
+    if(d != day || !follows){
+        throw std::runtime_error("Filter batches do not follow on from this filter");
+    }
+    if(whole && from == 0){
+        // The compacted day replaces the batches
+        batches.clear();
+        std::vector<uint64_t>().swap(keys);
+        keyed = 0;
+        compacted = true;
+    }
+    for(auto& b : rest){
+        batches.push_back(std::move(b));
+    }
+}
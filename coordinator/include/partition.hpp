@@ -0,0 +1,196 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <secovid/csr.hpp>
+
+// Splits the aggregate contact graph over shards so that most contacts
+// stay inside one shard.
+//
+// Vertices are first cut into equal runs of a BFS order, which already
+// keeps neighbourhoods together, then refined by label propagation: a
+// vertex moves to the shard most of its neighbours are in, as long as
+// that shard stays within slack of an even share.
+
+// Where every vertex of the aggregate graph lives
+struct partition{
+    uint32_t shards = 1;
+    std::vector<uint32_t> owner; // Shard of each vertex
+    std::vector<uint32_t> local; // Its vertex id on that shard
+};
+typedef struct partition partition;
+
+// A shard's part of the graph. Vertices below owned live here; the rest
+// are ghosts, copies of vertices on other shards that mark cut edges.
+struct shard_graph{
+    uint32_t shard = 0;
+    uint32_t shards = 1;
+    uint32_t owned = 0;
+    std::vector<uint32_t> global;      // Aggregate id of every vertex, ghosts included
+    std::vector<uint32_t> ghost_owner; // Shard of ghost owned + i
+    std::vector<uint32_t> ghost_local; // Its vertex id on that shard
+    csr_graph csr;                     // Rows of the owned vertices
+
+    uint32_t Ghosts() const { return static_cast<uint32_t>(ghost_owner.size()); }
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(shard, shards, owned, global, ghost_owner, ghost_local,
+            csr.offsets, csr.edges, csr.times);
+    }
+};
+typedef struct shard_graph shard_graph;
+
+// Vertices of g in BFS order, every component in turn
+inline std::vector<uint32_t> bfs_order(const csr_graph& g){
+    uint32_t n = g.Vertices();
+    std::vector<uint32_t> order;
+    std::vector<bool> seen(n, false);
+    order.reserve(n);
+    for(uint32_t s = 0; s < n; s++){
+        if(seen[s]){
+            continue;
+        }
+        seen[s] = true;
+        size_t head = order.size();
+        order.push_back(s);
+        while(head < order.size()){
+            uint32_t u = order[head++];
+            for(uint64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++){
+                uint32_t v = g.edges[e];
+                if(!seen[v]){
+                    seen[v] = true;
+                    order.push_back(v);
+                }
+            }
+        }
+    }
+    return order;
+}
+
+inline void number_vertices(partition& p){
+    std::vector<uint32_t> next(p.shards, 0);
+    p.local.resize(p.owner.size());
+    for(size_t v = 0; v < p.owner.size(); v++){
+        p.local[v] = next[p.owner[v]]++;
+    }
+}
+
+// Baseline that ignores the graph, shard by vertex id
+inline partition hash_partition(const csr_graph& g, uint32_t shards){
+    partition p;
+    p.shards = std::max<uint32_t>(shards, 1);
+    p.owner.resize(g.Vertices());
+    for(uint32_t v = 0; v < g.Vertices(); v++){
+        p.owner[v] = v % p.shards;
+    }
+    number_vertices(p);
+    return p;
+}
+
+inline partition label_propagation(const csr_graph& g, uint32_t shards, int rounds = 10, double slack = 0.05){
+    partition p;
+    p.shards = std::max<uint32_t>(shards, 1);
+    uint32_t n = g.Vertices();
+    p.owner.resize(n);
+    std::vector<uint64_t> size(p.shards, 0);
+    std::vector<uint32_t> order = bfs_order(g);
+    for(uint32_t i = 0; i < n; i++){
+        uint32_t s = static_cast<uint32_t>(static_cast<uint64_t>(i) * p.shards / n);
+        p.owner[order[i]] = s;
+        size[s]++;
+    }
+
+    uint64_t cap = static_cast<uint64_t>((1 + slack) * n / p.shards) + 1;
+    std::vector<uint64_t> count(p.shards, 0);
+    std::vector<uint32_t> touched;
+    for(int r = 0; r < rounds; r++){
+        uint64_t moved = 0;
+        for(uint32_t u : order){
+            touched.clear();
+            for(uint64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++){
+                uint32_t s = p.owner[g.edges[e]];
+                if(count[s]++ == 0){
+                    touched.push_back(s);
+                }
+            }
+            // Ties stay put so labels settle
+            uint32_t from = p.owner[u];
+            uint32_t best = from;
+            for(uint32_t s : touched){
+                if(count[s] > count[best] && size[s] < cap){
+                    best = s;
+                }
+            }
+            for(uint32_t s : touched){
+                count[s] = 0;
+            }
+            if(best != from){
+                p.owner[u] = best;
+                size[from]--;
+                size[best]++;
+                moved++;
+            }
+        }
+        if(moved <= n / 1000){
+            break;
+        }
+    }
+    number_vertices(p);
+    return p;
+}
+
+// Share of edges whose ends are on different shards
+inline double cut_ratio(const csr_graph& g, const partition& p){
+    uint64_t cut = 0;
+    for(uint32_t u = 0; u < g.Vertices(); u++){
+        for(uint64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++){
+            cut += p.owner[u] != p.owner[g.edges[e]];
+        }
+    }
+    return g.edges.empty() ? 0 : static_cast<double>(cut) / g.edges.size();
+}
+
+inline std::vector<shard_graph> split_graph(const csr_graph& g, const partition& p){
+    std::vector<shard_graph> rez(p.shards);
+    for(uint32_t s = 0; s < p.shards; s++){
+        rez[s].shard = s;
+        rez[s].shards = p.shards;
+    }
+    for(uint32_t v = 0; v < g.Vertices(); v++){
+        shard_graph& sg = rez[p.owner[v]];
+        sg.global.push_back(v);
+        sg.owned++;
+    }
+
+    // Ghost of v on each shard, stamped by the shard that made it
+    std::vector<uint32_t> ghost(g.Vertices());
+    std::vector<uint32_t> stamp(g.Vertices(), UINT32_MAX);
+    for(uint32_t s = 0; s < p.shards; s++){
+        shard_graph& sg = rez[s];
+        sg.csr.offsets.assign(1, 0);
+        for(uint32_t i = 0; i < sg.owned; i++){
+            uint32_t u = sg.global[i];
+            for(uint64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++){
+                uint32_t v = g.edges[e];
+                uint32_t w = p.owner[v];
+                if(w == s){
+                    sg.csr.edges.push_back(p.local[v]);
+                }else{
+                    if(stamp[v] != s){
+                        stamp[v] = s;
+                        ghost[v] = sg.owned + sg.Ghosts();
+                        sg.global.push_back(v);
+                        sg.ghost_owner.push_back(w);
+                        sg.ghost_local.push_back(p.local[v]);
+                    }
+                    sg.csr.edges.push_back(ghost[v]);
+                }
+                sg.csr.times.push_back(g.times[e]);
+            }
+            sg.csr.offsets.push_back(sg.csr.edges.size());
+        }
+    }
+    return rez;
+}
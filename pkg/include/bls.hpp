@@ -0,0 +1,332 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <mcl/bls12_381.hpp>
+
+using namespace mcl::bn;
+
+// BLS signatures on BLS12-381 for secure-contact contract signing.
+//
+// Signatures are hashes of the message into G1 times the secret key, so
+// each is one 48 byte point, and public keys are the key times a fixed
+// base in G2. Signatures add up: the sum of every member's signature on
+// a contract checks against the sum of their public keys with a product
+// of two pairings, whatever the size of the group. Adding keys is only
+// safe when each key has shown it knows its secret, so members join a
+// contract with a proof of possession, a signature on their own key.
+//
+// initPairing(mcl::BLS12_381) must have been called first.
+
+static const std::string BLS_SIG_TAG = "SCV-BLS-SIG";
+static const std::string BLS_POP_TAG = "SCV-BLS-POP";
+
+struct bls_key {
+    Fr s;
+    G2 pub;
+};
+
+typedef struct bls_key bls_key;
+
+// Base for public keys, derived so that nobody knows its logarithm
+inline const G2& bls_base(){
+    static const G2 base = []{
+        G2 q;
+        std::string seed = "SCV-BLS-BASE";
+        hashAndMapToG2(q, seed.c_str(), seed.size());
+        return q;
+    }();
+    return base;
+}
+
+inline void bls_hash(G1& h, const std::string& tag, const std::string& msg){
+    std::string m = tag + msg;
+    hashAndMapToG1(h, m.c_str(), m.size());
+}
+
+inline auto bls_keygen(){
+    bls_key k;
+    k.s.setByCSPRNG();
+    G2::mul(k.pub, bls_base(), k.s);
+    return k;
+}
+
+inline auto bls_sign(const bls_key& k, const std::string& msg){
+    G1 h, sig;
+    bls_hash(h, BLS_SIG_TAG, msg);
+    G1::mul(sig, h, k.s);
+    return sig;
+}
+
+inline auto bls_prove(const bls_key& k){
+    G1 h, pop;
+    bls_hash(h, BLS_POP_TAG, k.pub.serializeToHexStr());
+    G1::mul(pop, h, k.s);
+    return pop;
+}
+
+// True when e(-sig, base) * prod e(h[i], pub[i]) is one, with a single
+// final exponentiation for the whole product
+inline bool bls_check(const G1& sig, const std::vector<G1>& h, const std::vector<G2>& pub){
+    if(sig.isZero() || h.size() != pub.size()){
+        return false;
+    }
+    std::vector<G1> ps(h.size() + 1);
+    std::vector<G2> qs(h.size() + 1);
+    G1::neg(ps[0], sig);
+    qs[0] = bls_base();
+    for(size_t i = 0; i < h.size(); i++){
+        if(pub[i].isZero()){
+            return false;
+        }
+        ps[i + 1] = h[i];
+        qs[i + 1] = pub[i];
+    }
+    GT f;
+    millerLoopVec(f, ps.data(), qs.data(), ps.size());
+    finalExp(f, f);
+    return f.isOne();
+}
+
+inline bool bls_verify(const G2& pub, const std::string& msg, const G1& sig){
+    std::vector<G1> h(1);
+    bls_hash(h[0], BLS_SIG_TAG, msg);
+    return bls_check(sig, h, {pub});
+}
+
+inline bool bls_verify_pop(const G2& pub, const G1& pop){
+    std::vector<G1> h(1);
+    bls_hash(h[0], BLS_POP_TAG, pub.serializeToHexStr());
+    return bls_check(pop, h, {pub});
+}
+
+inline auto bls_aggregate(const std::vector<G1>& sigs){
+    G1 sum;
+    sum.clear();
+    for(auto& s : sigs){
+        G1::add(sum, sum, s);
+    }
+    return sum;
+}
+
+// An aggregate of signatures on distinct messages, one Miller loop per
+// signer. Repeated messages must go through a contract instead, so they
+// are rejected here: without proofs of possession a key chosen against
+// another signer's could forge their share of a shared message.
+inline bool bls_aggregate_verify(const std::vector<G2>& pubs, const std::vector<std::string>& msgs, const G1& sig){
+    if(pubs.size() != msgs.size() || pubs.empty()){
+        return false;
+    }
+    std::vector<std::string> sorted(msgs);
+    std::sort(sorted.begin(), sorted.end());
+    if(std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()){
+        return false;
+    }
+    std::vector<G1> h(msgs.size());
+    for(size_t i = 0; i < msgs.size(); i++){
+        bls_hash(h[i], BLS_SIG_TAG, msgs[i]);
+    }
+    return bls_check(sig, h, pubs);
+}
+
+struct contract_member {
+    std::string uid;
+    G2 pub;
+    G1 pop;
+};
+
+typedef struct contract_member contract_member;
+
+// A contract between a group of users to view each other's reports. All
+// members sign the same text, the terms followed by every member's uid,
+// and the signatures fold into one point as they arrive.
+class SecureContract
+{
+private:
+    std::string message;
+    std::vector<contract_member> members;
+    std::vector<bool> signed_by;
+    G1 signature;
+public:
+    // Throws if a member's proof of possession does not check out
+    SecureContract(const std::string& terms, std::vector<contract_member> members);
+
+    const std::string& Message() const { return message; }
+    size_t Members() const { return members.size(); }
+    size_t Signatures() const;
+    bool Complete() const { return Signatures() == members.size(); }
+
+    // Folds in a member's signature, throwing if they already signed.
+    // Use VerifyShare on a failed contract to find a bad one.
+    void Add(size_t member, const G1& sig);
+    bool VerifyShare(size_t member, const G1& sig) const { return bls_verify(members[member].pub, message, sig); }
+    // Checks the aggregate against the members who signed
+    bool Verify() const;
+    // The aggregate, 48 bytes as 96 hex digits
+    std::string Signature() const { return signature.serializeToHexStr(); }
+    // Takes an aggregate published by another party, throwing if it is
+    // not a point of the signature group
+    void SetSignature(const std::string& hex, const std::vector<bool>& signers);
+};
+
+inline SecureContract::SecureContract(const std::string& terms, std::vector<contract_member> members) : members(std::move(members)){
+    message = terms;
+    for(auto& m : this->members){
+        if(!bls_verify_pop(m.pub, m.pop)){
+            throw std::runtime_error("Bad proof of possession from " + m.uid);
+        }
+        message += "\n" + m.uid;
+    }
+    signed_by.assign(this->members.size(), false);
+    signature.clear();
+}
+
+inline size_t SecureContract::Signatures() const{
+    size_t n = 0;
+    for(bool b : signed_by){
+        n += b;
+    }
+    return n;
+}
+
+inline void SecureContract::Add(size_t member, const G1& sig){
+    if(member >= members.size() || signed_by[member]){
+        throw std::runtime_error("Signature from a member who cannot sign");
+    }
+    signed_by[member] = true;
+    G1::add(signature, signature, sig);
+}
+
+inline bool SecureContract::Verify() const{
+    G2 apk;
+    apk.clear();
+    for(size_t i = 0; i < members.size(); i++){
+        if(signed_by[i]){
+            G2::add(apk, apk, members[i].pub);
+        }
+    }
+    std::vector<G1> h(1);
+    bls_hash(h[0], BLS_SIG_TAG, message);
+    return bls_check(signature, h, {apk});
+}
+
+inline void SecureContract::SetSignature(const std::string& hex, const std::vector<bool>& signers){
+    if(signers.size() != members.size()){
+        throw std::runtime_error("Signers do not match the contract");
+    }
+    G1 sig;
+    try{
+        sig.deserializeHexStr(hex);
+    }catch(const std::exception&){
+        throw std::runtime_error("Malformed contract signature");
+    }
+    if(!sig.isValid() || !sig.isValidOrder()){
+        throw std::runtime_error("Contract signature is not in the signature group");
+    }
+    signature = sig;
+    signed_by = signers;
+}
+
+struct signed_report {
+    G2 pub;
+    std::string msg;
+    G1 sig;
+};
+
+typedef struct signed_report signed_report;
+
+// Checks many signatures on different messages at once. Each signature
+// is weighted by a fresh random scalar so that errors cannot cancel, and
+// the whole batch becomes one multi-pairing
+//     e(-sum r[i] sig[i], base) * prod_signers e(sum r[i] h[i], pub) == 1
+// with one Miller loop per distinct signer and one final
+// exponentiation. Reports from N distinct signers still take N + 1
+// Miller loops against 2N one by one, so the saving there is mostly
+// the N - 1 final exponentiations; many reports per signer is where a
+// batch pays. A failed batch is split in halves until the bad
+// signatures are found.
+class BatchVerifier
+{
+private:
+    std::vector<signed_report> reports;
+
+    bool check(const std::vector<size_t>& batch, const std::vector<G1>& h) const;
+    void bisect(const std::vector<size_t>& batch, const std::vector<G1>& h, std::vector<size_t>& bad) const;
+public:
+    void Add(const G2& pub, const std::string& msg, const G1& sig) { reports.push_back(signed_report{pub, msg, sig}); }
+    size_t Size() const { return reports.size(); }
+    void Clear() { reports.clear(); }
+    // Indices of the reports that do not verify, in order
+    std::vector<size_t> Verify() const;
+};
+
+inline bool BatchVerifier::check(const std::vector<size_t>& batch, const std::vector<G1>& h) const{
+    std::vector<Fr> r(batch.size());
+    std::vector<G1> sigs(batch.size());
+    std::unordered_map<std::string, std::vector<size_t>> by_signer;
+    for(size_t i = 0; i < batch.size(); i++){
+        r[i].setByCSPRNG();
+        sigs[i] = reports[batch[i]].sig;
+        by_signer[reports[batch[i]].pub.serializeToHexStr()].push_back(i);
+    }
+
+    std::vector<G1> ps;
+    std::vector<G2> qs;
+    ps.reserve(by_signer.size() + 1);
+    qs.reserve(by_signer.size() + 1);
+    G1 sum;
+    G1::mulVec(sum, sigs.data(), r.data(), sigs.size());
+    G1::neg(sum, sum);
+    ps.push_back(sum);
+    qs.push_back(bls_base());
+    for(auto& signer : by_signer){
+        std::vector<G1> hs;
+        std::vector<Fr> rs;
+        for(size_t i : signer.second){
+            hs.push_back(h[batch[i]]);
+            rs.push_back(r[i]);
+        }
+        G1 weighted;
+        G1::mulVec(weighted, hs.data(), rs.data(), hs.size());
+        ps.push_back(weighted);
+        qs.push_back(reports[batch[signer.second[0]]].pub);
+    }
+
+    GT f;
+    millerLoopVec(f, ps.data(), qs.data(), ps.size());
+    finalExp(f, f);
+    return f.isOne();
+}
+
+inline void BatchVerifier::bisect(const std::vector<size_t>& batch, const std::vector<G1>& h, std::vector<size_t>& bad) const{
+    if(batch.empty() || check(batch, h)){
+        return;
+    }
+    if(batch.size() == 1){
+        bad.push_back(batch[0]);
+        return;
+    }
+    size_t half = batch.size() / 2;
+    bisect(std::vector<size_t>(batch.begin(), batch.begin() + half), h, bad);
+    bisect(std::vector<size_t>(batch.begin() + half, batch.end()), h, bad);
+}
+
+inline std::vector<size_t> BatchVerifier::Verify() const{
+    std::vector<G1> h(reports.size());
+    std::vector<size_t> batch, bad;
+    for(size_t i = 0; i < reports.size(); i++){
+        // Points at infinity would drop out of the product unchecked
+        if(reports[i].sig.isZero() || reports[i].pub.isZero()){
+            bad.push_back(i);
+            continue;
+        }
+        bls_hash(h[i], BLS_SIG_TAG, reports[i].msg);
+        batch.push_back(i);
+    }
+    bisect(batch, h, bad);
+    std::sort(bad.begin(), bad.end());
+    return bad;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <sodium.h>
+#include <mcl/bls12_381.hpp>
+#include "pkg.hpp"
+
+// Two level identity based encryption (Gentry and Silverberg), so that
+// regional sub-PKGs extract keys for the users of their domain and the
+// root master key is only used to start a region.
+//
+// The root is the ordinary PKG, extracting a region's domain key
+// s0 * H(D) for D = hibe_domain_id(domain) with extract_domain. The tag
+// keeps domain keys apart from the keys of users named like a domain,
+// and PKG::extract refuses identities that start with it. A region
+// draws its own secret s1, publishes Q1 = s1 * P, and gives a user of
+// the domain
+//     S = s0 * H(D) + s1 * H(domain/user)
+// A sender only needs the root's public key and the domain and user
+// names: with U0 = rP and U1 = r H(domain/user), the user recovers the
+// same e(g1, H(D))^r an ordinary encryption to D would use from
+// e(U0, S) / e(Q1, U1), one pairing product.
+
+struct hibe_key {
+    G2 s;       // s0 * H(D) + s1 * H(domain/user)
+    G2 domain;  // H(D)
+    G1 q;       // The region's public Q1
+};
+
+struct hibe_ciphertext {
+    G1 U0;
+    G2 U1;
+    std::vector<unsigned char> V;
+    unsigned char nonce[crypto_secretbox_NONCEBYTES];
+};
+
+typedef struct hibe_key hibe_key;
+typedef struct hibe_ciphertext hibe_ciphertext;
+
+// Names with a '/' are rejected, as a/b + c and a + b/c would share a path
+inline std::string hibe_path(const std::string& domain, const std::string& user){
+    if(domain.find('/') != std::string::npos || user.find('/') != std::string::npos){
+        throw std::runtime_error("Domain and user names can not hold '/'");
+    }
+    return domain + "/" + user;
+}
+
+class SubPKG
+{
+private:
+    std::string domain;
+    id_pri_key domain_key; // From the root PKG's extract_domain(domain)
+    Fr s;
+public:
+    // Throws unless domain_key is the root's key for domain
+    SubPKG(const std::string& domain, id_pri_key domain_key, const m_pub_k& root);
+    G1 q; // Public Q1 = s1 * P
+
+    hibe_key extract(const std::string& user) const;
+};
+
+inline SubPKG::SubPKG(const std::string& domain, id_pri_key domain_key, const m_pub_k& root)
+    : domain(domain), domain_key(domain_key){
+    std::string id = hibe_domain_id(domain);
+    G2 h;
+    hashAndMapToG2(h, id.c_str(), id.size());
+    if(h != domain_key.q){
+        throw std::runtime_error("Domain key is not for " + domain);
+    }
+    // d = s0 * H(D) exactly when e(P, d) == e(g1, H(D))
+    GT left, right;
+    pairing(left, generator, domain_key.d);
+    pairing(right, root.g1, domain_key.q);
+    if(left != right){
+        throw std::runtime_error("Domain key for " + domain + " was not extracted by this root");
+    }
+    s.setByCSPRNG();
+    G1::mul(q, generator, s);
+}
+
+inline hibe_key SubPKG::extract(const std::string& user) const{
+    std::string path = hibe_path(domain, user);
+    G2 h, t;
+    hashAndMapToG2(h, path.c_str(), path.size());
+    G2::mul(t, h, s);
+    hibe_key k;
+    G2::add(k.s, domain_key.d, t);
+    k.domain = domain_key.q;
+    k.q = q;
+    return k;
+}
+
+inline auto hibe_encrypt(m_pub_k* key, const std::string& domain, const std::string& user, const std::string& msg,
+    EphemeralPool* pool = nullptr){
+    G2 qd, qu;
+    GT g, er;
+    std::string id = hibe_domain_id(domain);
+    std::string path = hibe_path(domain, user);
+    hashAndMapToG2(qd, id.c_str(), id.size());
+    hashAndMapToG2(qu, path.c_str(), path.size());
+    pairing(g, key->g1, qd);
+
+    hibe_ciphertext c;
+    ephemeral eph = pool != nullptr ? pool->Take() : new_ephemeral();
+    c.U0 = eph.rp;
+    G2::mul(c.U1, qu, eph.r);
+    GT::pow(er, g, eph.r);
+    wipe_ephemeral(eph);
+
+    char buffer[65];
+    auto sk = serialize(qd, c.U0, er);
+    sha256(&sk[0], buffer);
+    randombytes_buf(c.nonce, sizeof(c.nonce));
+    c.V.resize(crypto_secretbox_MACBYTES + msg.size());
+    crypto_secretbox_easy(c.V.data(), reinterpret_cast<const unsigned char*>(msg.data()), msg.size(),
+        c.nonce, reinterpret_cast<unsigned char*>(buffer));
+    return c;
+}
+
+// False if c was not for k
+inline bool hibe_decrypt(const hibe_key& k, const hibe_ciphertext& c, std::string& msg){
+    // e(U0, S) * e(-Q1, U1) in one product
+    G1 ps[2];
+    G2 qs[2] = {k.s, c.U1};
+    ps[0] = c.U0;
+    G1::neg(ps[1], k.q);
+    GT e;
+    millerLoopVec(e, ps, qs, 2);
+    finalExp(e, e);
+
+    char buffer[65];
+    auto sk = serialize(k.domain, c.U0, e);
+    sha256(&sk[0], buffer);
+    if(c.V.size() < crypto_secretbox_MACBYTES){
+        return false;
+    }
+    msg.resize(c.V.size() - crypto_secretbox_MACBYTES);
+    return crypto_secretbox_open_easy(reinterpret_cast<unsigned char*>(&msg[0]), c.V.data(), c.V.size(),
+        c.nonce, reinterpret_cast<unsigned char*>(buffer)) == 0;
+}
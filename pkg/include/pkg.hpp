@@ -19,11 +19,23 @@
 
 #pragma once
 
+#include <deque>
+#include <chrono>
+#include <mutex>
 #include <tuple>
+#include <string>
+#include <thread>
 #include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <condition_variable>
 #include <sodium.h>
 #include <sodium/crypto_secretbox.h>
 #include <mcl/bls12_381.hpp>
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
 #include "utils.hpp"
 #include <iostream>
 
@@ -57,29 +69,165 @@ typedef struct master_pri_k m_pri_k;
 typedef struct id_pri_key id_pri_key;
 
 
+// Prefix of the identities HIBE domain keys are extracted for (see
+// hibe.hpp), which user identities may not start with
+static const std::string HIBE_DOMAIN_TAG = "hibe-domain:";
+
+// Identity the root extracts a region's domain key for
+inline std::string hibe_domain_id(const std::string& domain){
+    if(domain.find('/') != std::string::npos){
+        throw std::runtime_error("Domain names can not hold '/'");
+    }
+    return HIBE_DOMAIN_TAG + domain;
+}
+
 class PKG
 {
 private:
     m_pri_k m_pri;
+    id_pri_key extractId(const char* id, size_t len) const;
 public:
     PKG();
     m_pub_k m_pub;
+    // Throws for identities starting with HIBE_DOMAIN_TAG
     id_pri_key extract(char* id);
+    // Domain key of a HIBE region, for its SubPKG
+    id_pri_key extract_domain(const std::string& domain);
 };
 
 
-inline auto encrypt(m_pub_k* key, char* id, char* msg){
+// Ephemeral (r, rP) pairs drawn ahead of time. Neither depends on the
+// recipient, so a thread keeps the pool topped up while nothing is being
+// sent and encryption in a burst is left with the pairing and GT work.
+// An empty pool falls back to drawing a pair inline. Scalars are wiped
+// once they leave the pool or are used.
+struct ephemeral {
+    Fr r;
+    G1 rp;
+};
+
+typedef struct ephemeral ephemeral;
+
+inline ephemeral new_ephemeral(){
+    ephemeral e;
+    e.r.setByCSPRNG();
+    G1::mul(e.rp, generator, e.r);
+    return e;
+}
+
+inline void wipe_ephemeral(ephemeral& e){
+    sodium_memzero(&e.r, sizeof(e.r));
+}
+
+class EphemeralPool
+{
+private:
+    size_t capacity;
+    std::chrono::milliseconds quiet;
+    std::deque<ephemeral> ready;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread filler;
+    std::chrono::steady_clock::time_point last_take;
+    bool stop = false;
+public:
+    // The background thread refills once no pair has been taken for quiet
+    explicit EphemeralPool(size_t capacity = 4096, std::chrono::milliseconds quiet = std::chrono::milliseconds(50))
+        : capacity(capacity), quiet(quiet) {}
+    ~EphemeralPool();
+    EphemeralPool(const EphemeralPool&) = delete;
+    EphemeralPool& operator=(const EphemeralPool&) = delete;
+
+    // Draws pairs on this thread until the pool is full
+    void Fill();
+    // Keeps the pool full from a background thread
+    void Start();
+    ephemeral Take();
+    size_t Size();
+};
+
+inline EphemeralPool::~EphemeralPool(){
+    {
+        std::lock_guard<std::mutex> l(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    if(filler.joinable()){
+        filler.join();
+    }
+    for(auto& e : ready){
+        wipe_ephemeral(e);
+    }
+}
+
+inline void EphemeralPool::Fill(){
+    std::unique_lock<std::mutex> l(lock);
+    while(!stop && ready.size() < capacity){
+        l.unlock();
+        ephemeral e = new_ephemeral();
+        l.lock();
+        ready.push_back(e);
+        wipe_ephemeral(e);
+    }
+}
+
+inline void EphemeralPool::Start(){
+    if(filler.joinable()){
+        return;
+    }
+    filler = std::thread([this](){
+        std::unique_lock<std::mutex> l(lock);
+        while(!stop){
+            wake.wait(l, [this](){ return stop || ready.size() < capacity; });
+            // Refill only once a burst is over, a pair at a time so that
+            // the next burst does not wait on the filler for the CPU
+            auto idle = std::chrono::steady_clock::now() - last_take;
+            if(stop || idle < quiet){
+                wake.wait_for(l, quiet - idle);
+                continue;
+            }
+            l.unlock();
+            ephemeral e = new_ephemeral();
+            l.lock();
+            ready.push_back(e);
+            wipe_ephemeral(e);
+        }
+    });
+}
+
+inline ephemeral EphemeralPool::Take(){
+    std::unique_lock<std::mutex> l(lock);
+    last_take = std::chrono::steady_clock::now();
+    if(ready.empty()){
+        l.unlock();
+        wake.notify_one();
+        return new_ephemeral();
+    }
+    ephemeral e = ready.front();
+    wipe_ephemeral(ready.front());
+    ready.pop_front();
+    l.unlock();
+    wake.notify_one();
+    return e;
+}
+
+inline size_t EphemeralPool::Size(){
+    std::lock_guard<std::mutex> l(lock);
+    return ready.size();
+}
+
+inline auto encrypt(m_pub_k* key, char* id, char* msg, EphemeralPool* pool = nullptr){
     G2 q; GT g, er;
     hashAndMapToG2(q, id, strlen(id));
     pairing(g, key->g1, q);
     
-    G1 rp;
-    Fr r; r.setByCSPRNG();
-
-    // Curve point generator
+    ephemeral eph = pool != nullptr ? pool->Take() : new_ephemeral();
+    G1 rp = eph.rp;
+    Fr r = eph.r;
 
-    G1::mul(rp, generator, r);
     GT::pow(er, g, r);
+    sodium_memzero(&r, sizeof(r));
+    wipe_ephemeral(eph);
 
 
     int CIPHERTEXT_LEN = crypto_secretbox_MACBYTES + strlen(msg);
@@ -126,3 +274,180 @@ inline auto decrypt(id_pri_key k, ciphertext c){
     }
     
 }
+
+// One message for many identities. A single r and U = rP are drawn for
+// the whole broadcast, the body is sealed once under a random key, and
+// each recipient gets only that key wrapped under their share
+// e(g1, q)^r. The pairing e(g1, q) does not depend on r, so it is kept
+// per identity and a recipient costs one GT pow.
+struct broadcast_ciphertext{
+    G1 U;
+    unsigned char nonce[crypto_secretbox_NONCEBYTES];
+    std::vector<unsigned char> body;
+    // Per recipient, a nonce then the sealed body key
+    std::vector<std::vector<unsigned char>> keys;
+
+    template<class Archive>
+    void save(Archive & archive) const{
+        std::vector<unsigned char> n(nonce, nonce + sizeof(nonce));
+        archive(U.serializeToHexStr(), n, body, keys);
+    }
+
+    template<class Archive>
+    void load(Archive & archive){
+        std::string u;
+        std::vector<unsigned char> n;
+        archive(u, n, body, keys);
+        if(n.size() != sizeof(nonce)){
+            throw std::runtime_error("Malformed broadcast");
+        }
+        U.deserializeHexStr(u);
+        memcpy(nonce, n.data(), sizeof(nonce));
+    }
+};
+
+typedef struct broadcast_ciphertext broadcast_ciphertext;
+
+// For the Mailbox, which holds strings
+inline std::string broadcast_serialize(const broadcast_ciphertext& c){
+    std::stringstream ss;
+    {
+        cereal::PortableBinaryOutputArchive oarchive(ss);
+        oarchive(c);
+    }
+    return ss.str();
+}
+
+inline broadcast_ciphertext broadcast_deserialize(const std::string& cdata){
+    std::stringstream ss(cdata);
+    broadcast_ciphertext c;
+    {
+        cereal::PortableBinaryInputArchive iarchive(ss);
+        iarchive(c);
+    }
+    return c;
+}
+
+// Key the recipient of q derives from U and their share, as in encrypt:
+// the raw SHA-256 of the three. Callers wipe it once used.
+static_assert(crypto_hash_sha256_BYTES == crypto_secretbox_KEYBYTES, "wrap key is one digest");
+inline void wrap_key(const G2& q, const G1& U, const GT& er, unsigned char key[crypto_secretbox_KEYBYTES]){
+    auto sk = serialize(q, U, er);
+    crypto_hash_sha256(key, reinterpret_cast<const unsigned char*>(sk.data()), sk.size());
+    sodium_memzero(&sk[0], sk.size());
+}
+
+// Safe to share between threads. The pairings of the last max_cached
+// identities are kept, about 800 bytes each, and the oldest are dropped
+// first.
+class Broadcaster
+{
+private:
+    struct recipient {
+        G2 q;
+        GT g; // e(g1, q)
+    };
+
+    m_pub_k m_pub;
+    EphemeralPool* pool;
+    size_t max_cached;
+    std::mutex lock;
+    std::unordered_map<std::string, recipient> cached;
+    std::deque<std::string> order; // Oldest first
+
+    recipient recipientOf(const std::string& id);
+public:
+    explicit Broadcaster(m_pub_k key, EphemeralPool* pool = nullptr, size_t max_cached = 65536)
+        : m_pub(key), pool(pool), max_cached(max_cached) {}
+    broadcast_ciphertext Encrypt(const std::vector<std::string>& ids, const std::string& msg);
+    size_t Cached();
+};
+
+inline Broadcaster::recipient Broadcaster::recipientOf(const std::string& id){
+    {
+        std::lock_guard<std::mutex> l(lock);
+        auto it = cached.find(id);
+        if(it != cached.end()){
+            return it->second;
+        }
+    }
+    // Outside the lock, so other senders are not held up by the pairing
+    recipient r;
+    hashAndMapToG2(r.q, id.c_str(), id.size());
+    pairing(r.g, m_pub.g1, r.q);
+
+    std::lock_guard<std::mutex> l(lock);
+    if(max_cached > 0 && cached.emplace(id, r).second){
+        order.push_back(id);
+        while(order.size() > max_cached){
+            cached.erase(order.front());
+            order.pop_front();
+        }
+    }
+    return r;
+}
+
+inline size_t Broadcaster::Cached(){
+    std::lock_guard<std::mutex> l(lock);
+    return cached.size();
+}
+
+inline broadcast_ciphertext Broadcaster::Encrypt(const std::vector<std::string>& ids, const std::string& msg){
+    broadcast_ciphertext c;
+    ephemeral eph = pool != nullptr ? pool->Take() : new_ephemeral();
+    c.U = eph.rp;
+
+    unsigned char key[crypto_secretbox_KEYBYTES];
+    crypto_secretbox_keygen(key);
+    randombytes_buf(c.nonce, sizeof(c.nonce));
+    c.body.resize(crypto_secretbox_MACBYTES + msg.size());
+    crypto_secretbox_easy(c.body.data(), reinterpret_cast<const unsigned char*>(msg.data()), msg.size(), c.nonce, key);
+
+    for(auto& id : ids){
+        recipient to = recipientOf(id);
+        GT er;
+        GT::pow(er, to.g, eph.r);
+        unsigned char wrap[crypto_secretbox_KEYBYTES];
+        wrap_key(to.q, c.U, er, wrap);
+
+        std::vector<unsigned char> wrapped(crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES + sizeof(key));
+        randombytes_buf(wrapped.data(), crypto_secretbox_NONCEBYTES);
+        crypto_secretbox_easy(wrapped.data() + crypto_secretbox_NONCEBYTES, key, sizeof(key), wrapped.data(), wrap);
+        sodium_memzero(wrap, sizeof(wrap));
+        c.keys.push_back(std::move(wrapped));
+    }
+    sodium_memzero(key, sizeof(key));
+    wipe_ephemeral(eph);
+    return c;
+}
+
+// One pairing, then the wrapped keys are tried in turn; false if none
+// of them is for k
+inline bool broadcast_decrypt(const id_pri_key& k, const broadcast_ciphertext& c, std::string& msg){
+    GT e;
+    pairing(e, c.U, k.d);
+    unsigned char wrap[crypto_secretbox_KEYBYTES];
+    wrap_key(k.q, c.U, e, wrap);
+
+    unsigned char key[crypto_secretbox_KEYBYTES];
+    bool found = false;
+    for(auto& wrapped : c.keys){
+        if(wrapped.size() == crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES + sizeof(key)
+            && crypto_secretbox_open_easy(key, wrapped.data() + crypto_secretbox_NONCEBYTES,
+                wrapped.size() - crypto_secretbox_NONCEBYTES, wrapped.data(), wrap) == 0){
+            found = true;
+            break;
+        }
+    }
+    sodium_memzero(wrap, sizeof(wrap));
+    if(!found){
+        return false;
+    }
+    bool ok = c.body.size() >= crypto_secretbox_MACBYTES;
+    if(ok){
+        msg.resize(c.body.size() - crypto_secretbox_MACBYTES);
+        ok = crypto_secretbox_open_easy(reinterpret_cast<unsigned char*>(&msg[0]), c.body.data(), c.body.size(), c.nonce, key) == 0;
+    }
+    sodium_memzero(key, sizeof(key));
+    return ok;
+}
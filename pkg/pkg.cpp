@@ -20,10 +20,23 @@ PKG::PKG(){
 
 }
 
-id_pri_key PKG::extract(char* id){
+id_pri_key PKG::extractId(const char* id, size_t len) const{
     G2 q, d;
-    hashAndMapToG2(q, id, strlen(id));
+    hashAndMapToG2(q, id, len);
     G2::mul(d, q, this->m_pri.s);
     id_pri_key k {d,q};
     return k;
+}
+
+// A user named like a domain would otherwise get that domain's key
+id_pri_key PKG::extract(char* id){
+    if(strncmp(id, HIBE_DOMAIN_TAG.c_str(), HIBE_DOMAIN_TAG.size()) == 0){
+        throw std::runtime_error("Identities starting with the HIBE domain tag are domain keys");
+    }
+    return extractId(id, strlen(id));
+}
+
+id_pri_key PKG::extract_domain(const std::string& domain){
+    std::string id = hibe_domain_id(domain);
+    return extractId(id.c_str(), id.size());
 }
\ No newline at end of file
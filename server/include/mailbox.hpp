@@ -0,0 +1,372 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <openssl/sha.h>
+
+// Mailboxes for IBE ciphertexts, kept as append-only segment files.
+//
+// Every message is a record appended to the current segment: a header
+// naming the recipient by a hash of their identity, then the bytes as
+// given. Segments are sized up front and mapped read only, so readers
+// get pointers straight into the page cache, or have the kernel send
+// the bytes with sendfile, while writers keep appending with pwrite.
+// An index in memory lists where each recipient's records are; writers
+// only hold its lock to push a location, never while writing.
+//
+// Records carry a global sequence number, which readers keep as a
+// cursor. Whole segments are dropped once they are old.
+
+const static uint32_t MAILBOX_MAGIC = 0x4d424f58; // "MBOX"
+const static uint64_t MAILBOX_SEGMENT_BYTES = 64 << 20;
+
+struct mailbox_header{
+    uint32_t magic;
+    uint32_t length;
+    uint64_t id;
+    uint64_t sequence;
+    uint32_t check;
+    uint32_t pad;
+};
+typedef struct mailbox_header mailbox_header;
+
+// Where a record's bytes are, and which record it is
+struct mailbox_location{
+    uint64_t sequence;
+    uint32_t segment;
+    uint32_t offset; // Of the bytes, past the header
+    uint32_t length;
+};
+typedef struct mailbox_location mailbox_location;
+
+// A record's bytes, in place in a segment mapping
+struct mailbox_item{
+    uint64_t sequence;
+    const char* data;
+    uint32_t length;
+};
+typedef struct mailbox_item mailbox_item;
+
+// Recipients are known to the mailbox by the first 8 bytes of the
+// SHA-256 of their identity
+inline uint64_t mailbox_id(const std::string& identity){
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(identity.data()), identity.size(), hash);
+    uint64_t id;
+    memcpy(&id, hash, sizeof(id));
+    return id;
+}
+
+// FNV-1a, to tell a torn record from a whole one when reopening
+inline uint32_t mailbox_check(const char* data, size_t length){
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < length; i++){
+        h = (h ^ static_cast<uint8_t>(data[i])) * 16777619u;
+    }
+    return h;
+}
+
+class MailboxSegment
+{
+private:
+    int fd = -1;
+    const char* base = nullptr;
+    uint64_t capacity = 0;
+public:
+    // Opens or creates the segment file at path, capacity bytes long
+    MailboxSegment(const std::string& path, uint64_t capacity);
+    ~MailboxSegment();
+    MailboxSegment(const MailboxSegment&) = delete;
+    MailboxSegment& operator=(const MailboxSegment&) = delete;
+
+    int File() const { return fd; }
+    const char* Data() const { return base; }
+    uint64_t Capacity() const { return capacity; }
+};
+
+inline MailboxSegment::MailboxSegment(const std::string& path, uint64_t capacity) : capacity(capacity){
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    if(fd < 0){
+        throw std::runtime_error("Could not open mailbox segment " + path);
+    }
+    off_t size = lseek(fd, 0, SEEK_END);
+    if(size < static_cast<off_t>(capacity) && ftruncate(fd, capacity) != 0){
+        ::close(fd);
+        throw std::runtime_error("Could not size mailbox segment " + path);
+    }
+    void* p = mmap(nullptr, capacity, PROT_READ, MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED){
+        ::close(fd);
+        throw std::runtime_error("Could not map mailbox segment " + path);
+    }
+    base = static_cast<const char*>(p);
+}
+
+inline MailboxSegment::~MailboxSegment(){
+    munmap(const_cast<char*>(base), capacity);
+    ::close(fd);
+}
+
+class Mailbox
+{
+private:
+    std::string dir;
+    uint64_t segment_bytes;
+
+    std::mutex appending; // Held by one writer at a time
+    uint64_t tail = 0;    // Where the next record goes in the last segment
+
+    std::mutex lock; // Guards everything below
+    std::map<uint32_t, std::shared_ptr<MailboxSegment>> segments;
+    std::unordered_map<uint64_t, std::vector<mailbox_location>> index;
+    uint64_t next_sequence = 1;
+
+    std::string path(uint32_t segment) const { return dir + "/" + std::to_string(segment) + ".seg"; }
+    void load(uint32_t segment);
+    std::shared_ptr<MailboxSegment> segment(uint32_t n);
+    std::vector<mailbox_location> locate(uint64_t id, uint64_t after, size_t limit);
+public:
+    // Opens the mailbox in dir, which must exist, reading back any
+    // segments already there
+    explicit Mailbox(const std::string& dir, uint64_t segment_bytes = MAILBOX_SEGMENT_BYTES);
+
+    // Appends messages for id, returning the sequence of the last
+    uint64_t Append(uint64_t id, const std::vector<std::string>& messages);
+    uint64_t Append(uint64_t id, const std::string& message) { return Append(id, std::vector<std::string>{message}); }
+
+    // Up to limit of id's records after sequence after, pointing into the
+    // segments. They stay valid while segments holds them.
+    std::vector<mailbox_item> Read(uint64_t id, uint64_t after, std::vector<std::shared_ptr<MailboxSegment>>& segments, size_t limit = SIZE_MAX);
+    // Writes up to limit of id's records after sequence after to socket
+    // or file fd, each as its length then its bytes, straight from the
+    // page cache. Returns the last sequence sent, or after.
+    uint64_t Send(int fd, uint64_t id, uint64_t after, size_t limit = SIZE_MAX);
+
+    // Sequence of the newest record, 0 when empty
+    uint64_t Last();
+    size_t Segments();
+    // Drops every segment but the newest keep
+    void Expire(size_t keep);
+};
+
+inline Mailbox::Mailbox(const std::string& dir, uint64_t segment_bytes) : dir(dir), segment_bytes(segment_bytes){
+    if(segment_bytes > UINT32_MAX){
+        throw std::runtime_error("Mailbox segments must fit 32 bit offsets");
+    }
+    std::vector<uint32_t> found;
+    if(DIR* d = opendir(dir.c_str())){
+        while(struct dirent* e = readdir(d)){
+            unsigned long n;
+            char rest[8];
+            if(sscanf(e->d_name, "%lu.se%7s", &n, rest) == 2 && strcmp(rest, "g") == 0){
+                found.push_back(static_cast<uint32_t>(n));
+            }
+        }
+        closedir(d);
+    }else{
+        throw std::runtime_error("No mailbox directory " + dir);
+    }
+    std::sort(found.begin(), found.end());
+    for(uint32_t n : found){
+        load(n);
+    }
+    if(segments.empty()){
+        segments[0] = std::make_shared<MailboxSegment>(path(0), segment_bytes);
+    }
+}
+
+// Rebuilds the index from a segment, stopping at the first record that
+// is not whole
+inline void Mailbox::load(uint32_t n){
+    auto s = std::make_shared<MailboxSegment>(path(n), segment_bytes);
+    segments[n] = s;
+    uint64_t at = 0;
+    while(at + sizeof(mailbox_header) <= s->Capacity()){
+        mailbox_header h;
+        memcpy(&h, s->Data() + at, sizeof(h));
+        uint64_t end = at + sizeof(h) + h.length;
+        if(h.magic != MAILBOX_MAGIC || end > s->Capacity()
+            || mailbox_check(s->Data() + at + sizeof(h), h.length) != h.check){
+            break;
+        }
+        index[h.id].push_back(mailbox_location{h.sequence, n, static_cast<uint32_t>(at + sizeof(h)), h.length});
+        next_sequence = std::max(next_sequence, h.sequence + 1);
+        at = end;
+    }
+    tail = at;
+}
+
+inline std::shared_ptr<MailboxSegment> Mailbox::segment(uint32_t n){
+    std::lock_guard<std::mutex> l(lock);
+    auto it = segments.find(n);
+    return it == segments.end() ? nullptr : it->second;
+}
+
+inline uint64_t Mailbox::Append(uint64_t id, const std::vector<std::string>& messages){
+    for(auto& m : messages){
+        if(sizeof(mailbox_header) + m.size() > segment_bytes){
+            throw std::runtime_error("Message does not fit a mailbox segment");
+        }
+    }
+    std::lock_guard<std::mutex> a(appending);
+    std::vector<mailbox_location> written;
+    uint64_t last = 0;
+    size_t i = 0;
+    while(i < messages.size()){
+        uint32_t n;
+        uint64_t sequence;
+        std::shared_ptr<MailboxSegment> s;
+        {
+            std::lock_guard<std::mutex> l(lock);
+            n = segments.rbegin()->first;
+            s = segments.rbegin()->second;
+            sequence = next_sequence;
+        }
+        // As many messages as fit go out in one write
+        std::string buf;
+        uint64_t at = tail;
+        for(; i < messages.size(); i++){
+            const std::string& m = messages[i];
+            if(at + buf.size() + sizeof(mailbox_header) + m.size() > segment_bytes){
+                break;
+            }
+            mailbox_header h{MAILBOX_MAGIC, static_cast<uint32_t>(m.size()), id, sequence++,
+                mailbox_check(m.data(), m.size()), 0};
+            written.push_back(mailbox_location{h.sequence, n, static_cast<uint32_t>(at + buf.size() + sizeof(h)), h.length});
+            buf.append(reinterpret_cast<const char*>(&h), sizeof(h));
+            buf.append(m);
+        }
+        if(!buf.empty()){
+            const char* p = buf.data();
+            size_t left = buf.size();
+            off_t off = at;
+            while(left > 0){
+                ssize_t w = pwrite(s->File(), p, left, off);
+                if(w <= 0){
+                    throw std::runtime_error("Could not write to the mailbox");
+                }
+                p += w;
+                left -= w;
+                off += w;
+            }
+            tail = at + buf.size();
+        }
+
+        std::lock_guard<std::mutex> l(lock);
+        for(auto& w : written){
+            index[id].push_back(w);
+        }
+        if(!written.empty()){
+            last = written.back().sequence;
+            next_sequence = last + 1;
+        }
+        written.clear();
+        if(i < messages.size()){
+            // The segment is full; start the next
+            segments[n + 1] = std::make_shared<MailboxSegment>(path(n + 1), segment_bytes);
+            tail = 0;
+        }
+    }
+    return last;
+}
+
+inline std::vector<mailbox_location> Mailbox::locate(uint64_t id, uint64_t after, size_t limit){
+    std::lock_guard<std::mutex> l(lock);
+    auto it = index.find(id);
+    if(it == index.end()){
+        return {};
+    }
+    auto& v = it->second;
+    auto first = std::upper_bound(v.begin(), v.end(), after,
+        [](uint64_t s, const mailbox_location& loc){ return s < loc.sequence; });
+    auto last = static_cast<size_t>(v.end() - first) > limit ? first + limit : v.end();
+    return std::vector<mailbox_location>(first, last);
+}
+
+inline std::vector<mailbox_item> Mailbox::Read(uint64_t id, uint64_t after, std::vector<std::shared_ptr<MailboxSegment>>& held, size_t limit){
+    std::vector<mailbox_item> items;
+    // held may come in with segments from earlier reads, so held.back()
+    // is only known to be held_segment once this call has pushed it
+    bool pushed = false;
+    uint32_t held_segment = 0;
+    for(auto& loc : locate(id, after, limit)){
+        if(!pushed || held_segment != loc.segment){
+            auto s = segment(loc.segment);
+            if(!s){
+                continue; // Expired since it was located
+            }
+            held.push_back(std::move(s));
+            held_segment = loc.segment;
+            pushed = true;
+        }
+        items.push_back(mailbox_item{loc.sequence, held.back()->Data() + loc.offset, loc.length});
+    }
+    return items;
+}
+
+inline uint64_t Mailbox::Send(int fd, uint64_t id, uint64_t after, size_t limit){
+    uint64_t last = after;
+    for(auto& loc : locate(id, after, limit)){
+        auto s = segment(loc.segment);
+        if(!s){
+            continue;
+        }
+        uint32_t length = loc.length;
+        if(write(fd, &length, sizeof(length)) != sizeof(length)){
+            throw std::runtime_error("Could not send a mailbox record");
+        }
+        off_t off = loc.offset;
+        size_t left = length;
+        while(left > 0){
+            ssize_t w = sendfile(fd, s->File(), &off, left);
+            if(w <= 0){
+                throw std::runtime_error("Could not send a mailbox record");
+            }
+            left -= w;
+        }
+        last = loc.sequence;
+    }
+    return last;
+}
+
+inline uint64_t Mailbox::Last(){
+    std::lock_guard<std::mutex> l(lock);
+    return next_sequence - 1;
+}
+
+inline size_t Mailbox::Segments(){
+    std::lock_guard<std::mutex> l(lock);
+    return segments.size();
+}
+
+inline void Mailbox::Expire(size_t keep){
+    std::lock_guard<std::mutex> a(appending);
+    std::lock_guard<std::mutex> l(lock);
+    keep = std::max<size_t>(keep, 1);
+    while(segments.size() > keep){
+        uint32_t n = segments.begin()->first;
+        // Mapped until the last reader lets go
+        segments.erase(segments.begin());
+        std::remove(path(n).c_str());
+        for(auto it = index.begin(); it != index.end(); ){
+            auto& v = it->second;
+            auto first = std::find_if(v.begin(), v.end(), [n](const mailbox_location& loc){ return loc.segment > n; });
+            v.erase(v.begin(), first);
+            it = v.empty() ? index.erase(it) : std::next(it);
+        }
+    }
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <immintrin.h>
+#include <boost/asio.hpp>
+#include <openssl/rand.h>
+
+// Two server private information retrieval over fixed size mailbox
+// buckets (Chor, Goldreich, Kushilevitz and Sudan). Both servers hold
+// the same buckets. To fetch bucket i a client draws a random bit
+// vector, sends it to one server and the same vector with bit i flipped
+// to the other; each server answers with the xor of the buckets its
+// vector selects, and the two answers xor to bucket i. Either server on
+// its own sees a uniformly random vector, so as long as the two do not
+// collude neither learns which mailbox was read.
+//
+// Answering reads the whole database, so servers take queries in
+// batches and xor each bucket into every answer that selects it while
+// it is in cache. The xor runs on AVX-512 or AVX2 when the CPU has them.
+
+const static uint32_t PIR_BATCH = 8; // Queries answered per pass over the buckets
+const static uint32_t PIR_MAX_QUERIES = 64 * PIR_BATCH; // Queries a server takes in one request
+
+inline void pir_xor_scalar(uint8_t* acc, const uint8_t* rec, size_t bytes){
+    for(size_t i = 0; i < bytes; i += 8){
+        uint64_t a, r;
+        memcpy(&a, acc + i, 8);
+        memcpy(&r, rec + i, 8);
+        a ^= r;
+        memcpy(acc + i, &a, 8);
+    }
+}
+
+__attribute__((target("avx2")))
+inline void pir_xor_avx2(uint8_t* acc, const uint8_t* rec, size_t bytes){
+    for(size_t i = 0; i < bytes; i += 64){
+        __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i + 32));
+        __m256i r0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rec + i));
+        __m256i r1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rec + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_xor_si256(a0, r0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i + 32), _mm256_xor_si256(a1, r1));
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void pir_xor_avx512(uint8_t* acc, const uint8_t* rec, size_t bytes){
+    for(size_t i = 0; i < bytes; i += 64){
+        __m512i a = _mm512_loadu_si512(acc + i);
+        __m512i r = _mm512_loadu_si512(rec + i);
+        _mm512_storeu_si512(acc + i, _mm512_xor_si512(a, r));
+    }
+}
+
+// acc ^= rec over bytes, a multiple of 64
+inline void pir_xor(uint8_t* acc, const uint8_t* rec, size_t bytes){
+    static const int level = __builtin_cpu_supports("avx512f") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+    if(level == 2){
+        pir_xor_avx512(acc, rec, bytes);
+    }else if(level == 1){
+        pir_xor_avx2(acc, rec, bytes);
+    }else{
+        pir_xor_scalar(acc, rec, bytes);
+    }
+}
+
+// Bucket holding the mail of a mailbox id. Nothing copies Mailbox
+// records into buckets yet; whoever fills a PirDatabase places them.
+inline uint64_t pir_bucket(uint64_t id, uint64_t buckets){
+    return id % buckets;
+}
+
+class PirDatabase
+{
+private:
+    uint64_t buckets;
+    uint64_t bucket_bytes;
+    std::vector<uint8_t> data;
+public:
+    // bucket_bytes is rounded up to a multiple of 64
+    PirDatabase(uint64_t buckets, uint64_t bucket_bytes);
+
+    uint64_t Buckets() const { return buckets; }
+    uint64_t BucketBytes() const { return bucket_bytes; }
+    uint64_t QueryBytes() const { return (buckets + 7) / 8; }
+    uint8_t* Bucket(uint64_t i) { return &data[i * bucket_bytes]; }
+    const uint8_t* Bucket(uint64_t i) const { return &data[i * bucket_bytes]; }
+
+    // One answer per query, each BucketBytes long
+    std::vector<std::string> Answer(const std::vector<std::string>& queries) const;
+};
+
+inline PirDatabase::PirDatabase(uint64_t buckets, uint64_t bucket_bytes)
+    : buckets(buckets), bucket_bytes((bucket_bytes + 63) / 64 * 64), data(buckets * this->bucket_bytes, 0) {}
+
+inline std::vector<std::string> PirDatabase::Answer(const std::vector<std::string>& queries) const{
+    for(auto& q : queries){
+        if(q.size() != QueryBytes()){
+            throw std::runtime_error("PIR query does not match the database");
+        }
+    }
+    std::vector<std::string> answers(queries.size(), std::string(bucket_bytes, '\0'));
+    for(size_t first = 0; first < queries.size(); first += PIR_BATCH){
+        size_t count = std::min<size_t>(PIR_BATCH, queries.size() - first);
+        #pragma omp parallel
+        {
+            // Each thread xors a slice of the buckets into its own
+            // answers, which are then folded together
+            std::vector<uint8_t> acc(count * bucket_bytes, 0);
+            #pragma omp for schedule(static)
+            for(int64_t b = 0; b < static_cast<int64_t>(buckets); b++){
+                for(size_t q = 0; q < count; q++){
+                    const std::string& bits = queries[first + q];
+                    if((static_cast<uint8_t>(bits[b >> 3]) >> (b & 7)) & 1){
+                        pir_xor(&acc[q * bucket_bytes], Bucket(b), bucket_bytes);
+                    }
+                }
+            }
+            #pragma omp critical
+            for(size_t q = 0; q < count; q++){
+                pir_xor(reinterpret_cast<uint8_t*>(&answers[first + q][0]), &acc[q * bucket_bytes], bucket_bytes);
+            }
+        }
+    }
+    return answers;
+}
+
+// The client side: a pair of queries per bucket and the bucket back
+// from the pair of answers
+class PirClient
+{
+private:
+    uint64_t buckets;
+public:
+    explicit PirClient(uint64_t buckets) : buckets(buckets) {}
+
+    std::pair<std::string, std::string> Query(uint64_t bucket) const;
+    static std::string Decode(const std::string& a, const std::string& b);
+};
+
+inline std::pair<std::string, std::string> PirClient::Query(uint64_t bucket) const{
+    if(bucket >= buckets){
+        throw std::runtime_error("No such PIR bucket");
+    }
+    std::string a((buckets + 7) / 8, '\0');
+    if(RAND_bytes(reinterpret_cast<unsigned char*>(&a[0]), static_cast<int>(a.size())) != 1){
+        throw std::runtime_error("Out of randomness for a PIR query");
+    }
+    // Bits past the last bucket carry nothing
+    if(buckets % 8){
+        a.back() = static_cast<char>(static_cast<uint8_t>(a.back()) & ((1u << (buckets % 8)) - 1));
+    }
+    std::string b = a;
+    b[bucket >> 3] = static_cast<char>(static_cast<uint8_t>(b[bucket >> 3]) ^ (1u << (bucket & 7)));
+    return std::make_pair(a, b);
+}
+
+inline std::string PirClient::Decode(const std::string& a, const std::string& b){
+    if(a.size() != b.size()){
+        throw std::runtime_error("PIR answers do not match");
+    }
+    std::string out = a;
+    for(size_t i = 0; i < out.size(); i++){
+        out[i] ^= b[i];
+    }
+    return out;
+}
+
+// Serves PIR queries over TCP, one connection at a time. A request is a
+// uint32 count then count queries; the reply is count answers.
+class PirServer
+{
+private:
+    const PirDatabase& db;
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor acceptor;
+public:
+    PirServer(const PirDatabase& db, uint16_t port)
+        : db(db), acceptor(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)) {}
+
+    // Answers the next client until it hangs up, closing on a client
+    // that sends too many queries at once
+    void ServeOne();
+};
+
+inline void PirServer::ServeOne(){
+    boost::asio::ip::tcp::socket socket(io);
+    acceptor.accept(socket);
+    socket.set_option(boost::asio::ip::tcp::no_delay(true));
+    boost::system::error_code ec;
+    while(true){
+        uint32_t count;
+        boost::asio::read(socket, boost::asio::buffer(&count, sizeof(count)), ec);
+        if(ec){
+            return;
+        }
+        // A bad client only loses its connection
+        if(count > PIR_MAX_QUERIES){
+            socket.close(ec);
+            return;
+        }
+        std::vector<std::string> queries(count, std::string(db.QueryBytes(), '\0'));
+        for(auto& q : queries){
+            boost::asio::read(socket, boost::asio::buffer(&q[0], q.size()), ec);
+            if(ec){
+                return;
+            }
+        }
+        for(auto& a : db.Answer(queries)){
+            boost::asio::write(socket, boost::asio::buffer(a), ec);
+            if(ec){
+                return;
+            }
+        }
+    }
+}
+
+// Fetches buckets from a pair of servers, one socket to each
+class PirFetcher
+{
+private:
+    PirClient client;
+    uint64_t bucket_bytes;
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::socket a;
+    boost::asio::ip::tcp::socket b;
+
+    static void exchange(boost::asio::ip::tcp::socket& s, const std::vector<std::string>& queries);
+    static std::vector<std::string> collect(boost::asio::ip::tcp::socket& s, size_t count, uint64_t bytes);
+public:
+    PirFetcher(uint64_t buckets, uint64_t bucket_bytes, const std::string& host, uint16_t port_a, uint16_t port_b);
+
+    // Sent in requests of at most PIR_MAX_QUERIES
+    std::vector<std::string> Fetch(const std::vector<uint64_t>& buckets);
+};
+
+inline PirFetcher::PirFetcher(uint64_t buckets, uint64_t bucket_bytes, const std::string& host, uint16_t port_a, uint16_t port_b)
+    : client(buckets), bucket_bytes((bucket_bytes + 63) / 64 * 64), a(io), b(io){
+    auto address = boost::asio::ip::make_address(host);
+    a.connect(boost::asio::ip::tcp::endpoint(address, port_a));
+    b.connect(boost::asio::ip::tcp::endpoint(address, port_b));
+    a.set_option(boost::asio::ip::tcp::no_delay(true));
+    b.set_option(boost::asio::ip::tcp::no_delay(true));
+}
+
+inline void PirFetcher::exchange(boost::asio::ip::tcp::socket& s, const std::vector<std::string>& queries){
+    uint32_t count = static_cast<uint32_t>(queries.size());
+    boost::asio::write(s, boost::asio::buffer(&count, sizeof(count)));
+    for(auto& q : queries){
+        boost::asio::write(s, boost::asio::buffer(q));
+    }
+}
+
+inline std::vector<std::string> PirFetcher::collect(boost::asio::ip::tcp::socket& s, size_t count, uint64_t bytes){
+    std::vector<std::string> answers(count, std::string(bytes, '\0'));
+    for(auto& r : answers){
+        boost::asio::read(s, boost::asio::buffer(&r[0], r.size()));
+    }
+    return answers;
+}
+
+inline std::vector<std::string> PirFetcher::Fetch(const std::vector<uint64_t>& buckets){
+    std::vector<std::string> out;
+    for(size_t first = 0; first < buckets.size(); first += PIR_MAX_QUERIES){
+        size_t count = std::min<size_t>(PIR_MAX_QUERIES, buckets.size() - first);
+        std::vector<std::string> qa, qb;
+        for(size_t i = first; i < first + count; i++){
+            auto q = client.Query(buckets[i]);
+            qa.push_back(std::move(q.first));
+            qb.push_back(std::move(q.second));
+        }
+        // Both servers work at once
+        exchange(a, qa);
+        exchange(b, qb);
+        auto ra = collect(a, count, bucket_bytes);
+        auto rb = collect(b, count, bucket_bytes);
+        for(size_t i = 0; i < count; i++){
+            out.push_back(PirClient::Decode(ra[i], rb[i]));
+        }
+    }
+    return out;
+}
@@ -0,0 +1,426 @@
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <condition_variable>
+#include <boost/asio.hpp>
+#include "mailbox.hpp"
+
+// Waking mailbox readers when mail lands instead of having them poll.
+//
+// Clients subscribe to a prefix of the identity hash, which hides their
+// exact identity among everyone sharing the prefix. Subscriptions hang
+// off a radix tree with a nibble per level, so a new record walks at
+// most 16 nodes to find everyone it concerns however many subscribers
+// there are. A client either long-polls, taking the first record after
+// its cursor and leaving, or keeps a stream open and is sent the id and
+// sequence of every record under its prefix. Nothing runs while no mail
+// arrives: waiters sleep on condition variables or in the io loop.
+
+class PrefixIndex
+{
+private:
+    struct entry{
+        uint64_t handle;
+        uint64_t prefix;
+        int bits;
+    };
+    struct node{
+        std::unique_ptr<node> child[16];
+        std::vector<entry> entries;
+        uint64_t since = 0; // Newest sequence when the node was made
+        uint64_t last = 0;  // Newest sequence under the node since
+    };
+
+    node root;
+
+    static bool matches(const entry& e, uint64_t id){
+        return e.bits == 0 || (id >> (64 - e.bits)) == (e.prefix >> (64 - e.bits));
+    }
+    static int nibble(uint64_t prefix, int depth){ return static_cast<int>((prefix >> (60 - 4 * depth)) & 0xf); }
+    static void check(int bits);
+public:
+    // Node holding prefixes of bits bits, made if missing
+    node* Find(uint64_t prefix, int bits);
+    void Insert(uint64_t handle, uint64_t prefix, int bits);
+    // Removes a subscription, then the nodes left with nothing under them
+    void Erase(uint64_t handle, uint64_t prefix, int bits);
+    // Records sequence under every node on id's path and calls f with
+    // the handle of every prefix id falls under
+    template<class F>
+    void Publish(uint64_t id, uint64_t sequence, F f);
+    // Newest sequence that may be under prefix, erring high for
+    // prefixes nobody watches, which take their nearest watched
+    // ancestor's. Makes no nodes, so clients can not grow the tree.
+    uint64_t Last(uint64_t prefix, int bits) const;
+};
+
+inline void PrefixIndex::check(int bits){
+    if(bits < 0 || bits > 64){
+        throw std::runtime_error("Prefix must be 0 to 64 bits");
+    }
+}
+
+inline PrefixIndex::node* PrefixIndex::Find(uint64_t prefix, int bits){
+    check(bits);
+    node* n = &root;
+    for(int depth = 0; depth < bits / 4; depth++){
+        auto& c = n->child[nibble(prefix, depth)];
+        if(!c){
+            // Anything up to what the parent has seen may be under it
+            c.reset(new node());
+            c->since = std::max(n->since, n->last);
+        }
+        n = c.get();
+    }
+    return n;
+}
+
+inline void PrefixIndex::Insert(uint64_t handle, uint64_t prefix, int bits){
+    Find(prefix, bits)->entries.push_back(entry{handle, prefix, bits});
+}
+
+inline void PrefixIndex::Erase(uint64_t handle, uint64_t prefix, int bits){
+    check(bits);
+    std::vector<node*> path(1, &root);
+    for(int depth = 0; depth < bits / 4; depth++){
+        node* c = path.back()->child[nibble(prefix, depth)].get();
+        if(c == nullptr){
+            return;
+        }
+        path.push_back(c);
+    }
+    auto& v = path.back()->entries;
+    for(size_t i = 0; i < v.size(); i++){
+        if(v[i].handle == handle){
+            v[i] = v.back();
+            v.pop_back();
+            break;
+        }
+    }
+    for(int depth = static_cast<int>(path.size()) - 1; depth > 0; depth--){
+        node* n = path[depth];
+        if(!n->entries.empty()){
+            return;
+        }
+        for(auto& c : n->child){
+            if(c){
+                return;
+            }
+        }
+        path[depth - 1]->child[nibble(prefix, depth - 1)].reset();
+    }
+}
+
+template<class F>
+inline void PrefixIndex::Publish(uint64_t id, uint64_t sequence, F f){
+    node* n = &root;
+    for(int depth = 0; n != nullptr; depth++){
+        n->last = std::max(n->last, sequence);
+        for(auto& e : n->entries){
+            if(matches(e, id)){
+                f(e.handle);
+            }
+        }
+        if(depth == 16){
+            break;
+        }
+        n = n->child[(id >> (60 - 4 * depth)) & 0xf].get();
+    }
+}
+
+inline uint64_t PrefixIndex::Last(uint64_t prefix, int bits) const{
+    check(bits);
+    const node* n = &root;
+    for(int depth = 0; depth < bits / 4; depth++){
+        const node* c = n->child[nibble(prefix, depth)].get();
+        if(c == nullptr){
+            break;
+        }
+        n = c;
+    }
+    return std::max(n->since, n->last);
+}
+
+class Subscriptions
+{
+private:
+    struct subscriber{
+        uint64_t prefix;
+        int bits;
+        std::function<void(uint64_t, uint64_t)> notify;
+    };
+
+    std::mutex lock;
+    PrefixIndex index;
+    std::unordered_map<uint64_t, subscriber> subscribers;
+    uint64_t next_handle = 1;
+public:
+    // Calls notify with the id and sequence of every record published
+    // under the prefix from now on, until unsubscribed. notify runs on
+    // the publishing thread and must not block.
+    uint64_t Subscribe(uint64_t prefix, int bits, std::function<void(uint64_t, uint64_t)> notify);
+    void Unsubscribe(uint64_t handle);
+
+    // Long-polls for a record under the prefix newer than after. Returns
+    // its sequence, or after on timeout. May return early for a prefix
+    // nobody watched before; reading then finds nothing new.
+    uint64_t Wait(uint64_t prefix, int bits, uint64_t after, std::chrono::milliseconds timeout);
+    // Newest sequence that may be under the prefix
+    uint64_t Last(uint64_t prefix, int bits);
+
+    void Publish(uint64_t id, uint64_t sequence);
+};
+
+inline uint64_t Subscriptions::Subscribe(uint64_t prefix, int bits, std::function<void(uint64_t, uint64_t)> notify){
+    std::lock_guard<std::mutex> l(lock);
+    uint64_t handle = next_handle++;
+    index.Insert(handle, prefix, bits);
+    subscribers[handle] = subscriber{prefix, bits, std::move(notify)};
+    return handle;
+}
+
+inline void Subscriptions::Unsubscribe(uint64_t handle){
+    std::lock_guard<std::mutex> l(lock);
+    auto it = subscribers.find(handle);
+    if(it == subscribers.end()){
+        return;
+    }
+    index.Erase(handle, it->second.prefix, it->second.bits);
+    subscribers.erase(it);
+}
+
+inline uint64_t Subscriptions::Wait(uint64_t prefix, int bits, uint64_t after, std::chrono::milliseconds timeout){
+    struct waiter{
+        std::mutex lock;
+        std::condition_variable wake;
+        uint64_t sequence = 0;
+    };
+    auto w = std::make_shared<waiter>();
+    uint64_t handle;
+    {
+        std::lock_guard<std::mutex> l(lock);
+        uint64_t last = index.Last(prefix, bits);
+        if(last > after){
+            return last;
+        }
+        handle = next_handle++;
+        index.Insert(handle, prefix, bits);
+        subscribers[handle] = subscriber{prefix, bits, [w](uint64_t, uint64_t sequence){
+            std::lock_guard<std::mutex> l(w->lock);
+            w->sequence = std::max(w->sequence, sequence);
+            w->wake.notify_one();
+        }};
+    }
+    uint64_t sequence;
+    {
+        std::unique_lock<std::mutex> l(w->lock);
+        w->wake.wait_for(l, timeout, [&w](){ return w->sequence != 0; });
+        sequence = w->sequence;
+    }
+    Unsubscribe(handle);
+    return sequence != 0 ? sequence : after;
+}
+
+inline uint64_t Subscriptions::Last(uint64_t prefix, int bits){
+    std::lock_guard<std::mutex> l(lock);
+    return index.Last(prefix, bits);
+}
+
+inline void Subscriptions::Publish(uint64_t id, uint64_t sequence){
+    std::lock_guard<std::mutex> l(lock);
+    index.Publish(id, sequence, [&](uint64_t handle){
+        subscribers.at(handle).notify(id, sequence);
+    });
+}
+
+// Delivers into a mailbox and wakes whoever watches the recipient
+inline uint64_t deliver(Mailbox& box, Subscriptions& subs, uint64_t id, const std::vector<std::string>& messages){
+    uint64_t last = box.Append(id, messages);
+    for(uint64_t s = last + 1 - messages.size(); s <= last; s++){
+        subs.Publish(id, s);
+    }
+    return last;
+}
+
+// Push over TCP. A client sends a request
+//     uint64 prefix, uint8 bits, uint8 mode, uint64 after
+// and is sent frames of uint64 id, uint64 sequence. In long-poll mode
+// (0) one frame is sent and the connection closed; on timeout it holds
+// a zero id and after itself, and a zero id with a newer sequence means
+// mail may have landed before the request; in stream mode (1) frames follow until the
+// client goes away. Every connection lives in one io loop, so idle
+// clients cost a socket and nothing else.
+//
+// A stream client that reads slower than its mail arrives has at most
+// max_frames frames queued. Past that they collapse into one frame of a
+// zero id and the newest sequence, which like a long poll's tells the
+// client to read the mailbox from its cursor.
+class PushServer
+{
+private:
+    struct connection{
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::steady_timer timer;
+        uint64_t request[2] = {0, 0};
+        uint8_t options[2] = {0, 0}; // Bits, mode
+        uint64_t after = 0;
+        uint64_t handle = 0;
+        bool done = false;
+        bool writing = false;
+        std::deque<std::pair<uint64_t, uint64_t>> frames;
+        std::pair<uint64_t, uint64_t> out;
+
+        explicit connection(boost::asio::io_context& io) : socket(io), timer(io) {}
+    };
+
+    Subscriptions& subs;
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor acceptor;
+    std::chrono::milliseconds poll_timeout;
+    size_t max_frames;
+    std::unordered_map<uint64_t, std::weak_ptr<connection>> live; // By handle, touched by the loop only
+    std::thread loop;
+
+    void accept();
+    void start(std::shared_ptr<connection> c);
+    void send(std::shared_ptr<connection> c, uint64_t id, uint64_t sequence);
+    void flush(std::shared_ptr<connection> c);
+    void finish(std::shared_ptr<connection> c);
+public:
+    PushServer(Subscriptions& subs, uint16_t port, std::chrono::milliseconds poll_timeout = std::chrono::seconds(30),
+        size_t max_frames = 1024);
+    ~PushServer();
+    PushServer(const PushServer&) = delete;
+    PushServer& operator=(const PushServer&) = delete;
+
+    uint16_t Port() const { return acceptor.local_endpoint().port(); }
+};
+
+inline PushServer::PushServer(Subscriptions& subs, uint16_t port, std::chrono::milliseconds poll_timeout, size_t max_frames)
+    : subs(subs), acceptor(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)), poll_timeout(poll_timeout),
+    max_frames(std::max<size_t>(max_frames, 1)){
+    accept();
+    loop = std::thread([this](){ io.run(); });
+}
+
+inline PushServer::~PushServer(){
+    io.stop();
+    if(loop.joinable()){
+        loop.join();
+    }
+    // Nothing may post to the loop once it is gone
+    for(auto& l : live){
+        subs.Unsubscribe(l.first);
+    }
+}
+
+inline void PushServer::accept(){
+    auto c = std::make_shared<connection>(io);
+    acceptor.async_accept(c->socket, [this, c](const boost::system::error_code& ec){
+        if(!ec){
+            start(c);
+        }
+        accept();
+    });
+}
+
+inline void PushServer::start(std::shared_ptr<connection> c){
+    std::vector<boost::asio::mutable_buffer> bufs{
+        boost::asio::buffer(&c->request[0], sizeof(uint64_t)),
+        boost::asio::buffer(c->options),
+        boost::asio::buffer(&c->after, sizeof(c->after))};
+    boost::asio::async_read(c->socket, bufs, [this, c](const boost::system::error_code& ec, size_t){
+        int bits = c->options[0];
+        bool stream = c->options[1] == 1;
+        if(ec || bits > 64){
+            return;
+        }
+        // Records come in on other threads and are handed to the loop
+        c->handle = subs.Subscribe(c->request[0], bits, [this, c](uint64_t id, uint64_t sequence){
+            boost::asio::post(io, [this, c, id, sequence](){ send(c, id, sequence); });
+        });
+        live[c->handle] = c;
+        if(!stream){
+            // Mail may have landed before the client asked
+            uint64_t last = subs.Last(c->request[0], bits);
+            if(last > c->after){
+                send(c, 0, last);
+            }
+            if(!c->done){
+                c->timer.expires_after(poll_timeout);
+                c->timer.async_wait([this, c](const boost::system::error_code& ec){
+                    if(!ec){
+                        send(c, 0, c->after);
+                    }
+                });
+            }
+        }
+        // A read only ends when the client hangs up
+        boost::asio::async_read(c->socket, boost::asio::buffer(c->request), [this, c](const boost::system::error_code&, size_t){
+            finish(c);
+        });
+    });
+}
+
+inline void PushServer::send(std::shared_ptr<connection> c, uint64_t id, uint64_t sequence){
+    if(c->done){
+        return;
+    }
+    if(c->frames.size() >= max_frames){
+        uint64_t newest = std::max(sequence, c->frames.back().second);
+        c->frames.clear();
+        c->frames.emplace_back(0, newest);
+        return; // Already waiting on a write
+    }
+    c->frames.emplace_back(id, sequence);
+    if(c->options[1] != 1){
+        // A long poll answers once
+        subs.Unsubscribe(c->handle);
+        c->timer.cancel();
+        c->done = true;
+    }
+    flush(c);
+}
+
+inline void PushServer::flush(std::shared_ptr<connection> c){
+    if(c->writing || c->frames.empty()){
+        return;
+    }
+    c->writing = true;
+    c->out = c->frames.front();
+    c->frames.pop_front();
+    std::vector<boost::asio::const_buffer> bufs{
+        boost::asio::buffer(&c->out.first, sizeof(uint64_t)),
+        boost::asio::buffer(&c->out.second, sizeof(uint64_t))};
+    boost::asio::async_write(c->socket, bufs, [this, c](const boost::system::error_code& ec, size_t){
+        c->writing = false;
+        if(ec){
+            finish(c);
+        }else if(c->done && c->frames.empty()){
+            boost::system::error_code ignored;
+            c->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+        }else{
+            flush(c);
+        }
+    });
+}
+
+inline void PushServer::finish(std::shared_ptr<connection> c){
+    subs.Unsubscribe(c->handle);
+    live.erase(c->handle);
+    c->done = true;
+    c->frames.clear();
+    c->timer.cancel();
+    boost::system::error_code ignored;
+    c->socket.close(ignored);
+}
@@ -0,0 +1,66 @@
+// BatchVerifier against checking BLS signatures one by one.
+//
+//   bench_bls [reports] [bad]
+//
+// Signs reports (default 1000) from as many distinct signers, then from
+// 10 signers sharing them, and times BatchVerifier::Verify against a
+// bls_verify per report, first with every signature good and then with
+// bad ones (default 0) that the batch has to bisect for.
+#include <chrono>
+#include <iostream>
+#include <secovid/bls.hpp>
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto bench(const std::string& name, size_t reports, size_t signers, size_t bad) -> bool{
+    std::vector<bls_key> keys(signers);
+    for(auto& k : keys){
+        k = bls_keygen();
+    }
+    std::vector<signed_report> batch;
+    for(size_t i = 0; i < reports; i++){
+        const bls_key& k = keys[i % signers];
+        std::string msg = "report " + std::to_string(i);
+        // Spread the bad ones out so each needs its own bisection
+        bool wrong = bad > 0 && i % (reports / bad + 1) == 0;
+        batch.push_back(signed_report{k.pub, msg, bls_sign(k, wrong ? "forged" : msg)});
+    }
+
+    size_t one_bad = 0;
+    double t = seconds([&]{
+        for(auto& r : batch){
+            one_bad += !bls_verify(r.pub, r.msg, r.sig);
+        }
+    });
+    std::cout << name << "_one_by_one," << reports << "," << reports / t << ",sigs/s" << std::endl;
+
+    BatchVerifier v;
+    for(auto& r : batch){
+        v.Add(r.pub, r.msg, r.sig);
+    }
+    std::vector<size_t> found;
+    t = seconds([&]{ found = v.Verify(); });
+    std::cout << name << "_batch," << reports << "," << reports / t << ",sigs/s" << std::endl;
+    std::cout << name << "_bad," << reports << "," << found.size() << ",sigs" << std::endl;
+    return found.size() == one_bad;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    size_t reports = argc > 1 ? std::stoull(argv[1]) : 1000;
+    size_t bad = argc > 2 ? std::stoull(argv[2]) : 0;
+    initPairing(mcl::BLS12_381);
+    std::cout << "metric,reports,value,unit" << std::endl;
+    bool ok = bench("distinct_signers", reports, reports, 0);
+    ok = bench("ten_signers", reports, 10, 0) && ok;
+    if(bad > 0){
+        ok = bench("distinct_signers_with_bad", reports, reports, bad) && ok;
+        ok = bench("ten_signers_with_bad", reports, 10, bad) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+// Broadcast encryption against encrypting to each recipient.
+//
+//   bench_broadcast [largest group] [message bytes]
+//
+// For groups of 10 recipients up to the largest (default 1000) in steps
+// of ten, times a separate encrypt per recipient, a first broadcast
+// that pairs every identity and a second one from the cache, and
+// compares the bytes sent: a separate ciphertext costs a 48 byte point,
+// a nonce and a tag besides the message (default 1000 bytes), the
+// broadcast one serialized ciphertext.
+#include <chrono>
+#include <iostream>
+#include <secovid/pkg.hpp>
+
+G1 generator;
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto main(int argc, char* argv[]) -> int{
+    size_t largest = argc > 1 ? std::stoull(argv[1]) : 1000;
+    size_t bytes = argc > 2 ? std::stoull(argv[2]) : 1000;
+    PKG root;
+    std::string msg(bytes, 'x');
+    std::cout << "recipients,metric,value,unit" << std::endl;
+    int wrong = 0;
+    for(size_t n = 10; n <= largest; n *= 10){
+        std::vector<std::string> ids;
+        for(size_t i = 0; i < n; i++){
+            ids.push_back("user" + std::to_string(i) + "@example.org");
+        }
+
+        double t = seconds([&]{
+            for(auto& id : ids){
+                encrypt(&root.m_pub, const_cast<char*>(id.c_str()), const_cast<char*>(msg.c_str()));
+            }
+        });
+        std::cout << n << ",separate," << t * 1e3 << ",ms" << std::endl;
+        std::cout << n << ",separate_bytes," << n * (48 + crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES + bytes) << ",bytes" << std::endl;
+
+        Broadcaster b(root.m_pub);
+        broadcast_ciphertext c;
+        t = seconds([&]{ c = b.Encrypt(ids, msg); });
+        std::cout << n << ",broadcast_first," << t * 1e3 << ",ms" << std::endl;
+        t = seconds([&]{ c = b.Encrypt(ids, msg); });
+        std::cout << n << ",broadcast_cached," << t * 1e3 << ",ms" << std::endl;
+        std::cout << n << ",broadcast_bytes," << broadcast_serialize(c).size() << ",bytes" << std::endl;
+
+        std::string out;
+        id_pri_key last = root.extract(const_cast<char*>(ids.back().c_str()));
+        t = seconds([&]{ wrong += !broadcast_decrypt(last, c, out) || out != msg; });
+        std::cout << n << ",broadcast_decrypt," << t * 1e3 << ",ms" << std::endl;
+    }
+    std::cout << "all,wrong," << wrong << "," << std::endl;
+    return wrong == 0 ? 0 : 1;
+}
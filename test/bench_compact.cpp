@@ -0,0 +1,77 @@
+// Compares the compact contact_data format against cereal on payload
+// size and encode/decode throughput.
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <secovid/compact.hpp>
+
+auto random_graph(int vertices, int edges, std::mt19937& gen) -> contact_data{
+    contact_data d;
+    d.uid = "ALICE";
+    d.graph.resize(std::max(vertices, SIZE));
+    d.times.resize(d.graph.size());
+    std::uniform_int_distribution<> pick(0, vertices - 1);
+    std::uniform_int_distribution<> minute(0, 14 * 24 * 60);
+    uint32_t start = 1589500000;
+    for(int v = 0; v < vertices; v++){
+        std::string uid(64, '0'); // sha256 hex digest
+        for(auto& c : uid){
+            c = "0123456789abcdef"[gen() % 16];
+        }
+        d.uv[v] = uid;
+        d.vu[uid] = v;
+    }
+    for(int i = 0; i < edges; i++){
+        int u = pick(gen), v = pick(gen);
+        uint32_t begin = start + 60 * minute(gen);
+        contact_interval t{begin, begin + 60 * (uint32_t) (gen() % 30)};
+        d.graph[u].push_back(v);
+        d.graph[v].push_back(u);
+        d.times[u].push_back(t);
+        d.times[v].push_back(t);
+    }
+    return d;
+}
+
+template<class F>
+auto seconds(int rounds, F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++){
+        f();
+    }
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count() / rounds;
+}
+
+auto main() -> int{
+    std::mt19937 gen(42);
+    Contact c("ALICE");
+    const int rounds = 20;
+
+    for(int vertices : {10, 100, 1000, 10000}){
+        auto d = random_graph(vertices, vertices * 4, gen);
+
+        std::string cereal_buf, compact_buf;
+        double cereal_enc = seconds(rounds, [&]{
+            std::stringstream ss;
+            {
+                cereal::PortableBinaryOutputArchive oarchive(ss);
+                oarchive(d);
+            }
+            cereal_buf = ss.str();
+        });
+        double cereal_dec = seconds(rounds, [&]{ c.Deserialize(cereal_buf); });
+        double compact_enc = seconds(rounds, [&]{ compact_buf = compact_encode(d); });
+        double compact_dec = seconds(rounds, [&]{ compact_decode(compact_buf); });
+
+        std::cout << vertices << " vertices, " << vertices * 4 << " edges" << std::endl;
+        std::cout << "  cereal:  " << cereal_buf.size() << " bytes, encode "
+                  << cereal_buf.size() / cereal_enc / 1e6 << " MB/s, decode "
+                  << cereal_buf.size() / cereal_dec / 1e6 << " MB/s" << std::endl;
+        std::cout << "  compact: " << compact_buf.size() << " bytes ("
+                  << (double) cereal_buf.size() / compact_buf.size() << "x smaller), encode "
+                  << cereal_buf.size() / compact_enc / 1e6 << " MB/s, decode "
+                  << cereal_buf.size() / compact_dec / 1e6 << " MB/s (of cereal bytes)" << std::endl;
+    }
+    return 0;
+}
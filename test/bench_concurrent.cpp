@@ -0,0 +1,76 @@
+// ConcurrentContact merge throughput against writer threads.
+//
+//   bench_concurrent [edges] [max threads]
+//
+// Splits a generated graph (default 1M edges) into uploads of 1000
+// edges and merges them all with 1, 2, 4, ... writer threads, then
+// times single small merges into the full graph, whose cost should not
+// grow with the graph.
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <secovid/concurrent_contact.hpp>
+#include "graph_gen.hpp"
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto merge_all(ConcurrentContact& c, const std::vector<contact_data>& uploads, int threads) -> void{
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> writing;
+    for(int i = 0; i < threads; i++){
+        writing.emplace_back([&]{
+            for(size_t k; (k = next++) < uploads.size(); ){
+                c.Merge(uploads[k]);
+            }
+        });
+    }
+    for(auto& t : writing){
+        t.join();
+    }
+}
+
+auto main(int argc, char* argv[]) -> int{
+    graph_gen_params p;
+    p.edges = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    int max_threads = argc > 2 ? std::stoi(argv[2]) : 8;
+    p.vertices = static_cast<uint32_t>(p.edges / 8);
+    generated_graph g = generate_contacts(p);
+    auto uploads = to_uploads(g, 1000);
+
+    std::cout << "metric,threads,value,unit" << std::endl;
+    std::cout << "hardware_threads,0," << std::thread::hardware_concurrency() << "," << std::endl;
+    for(int threads = 1; threads <= max_threads; threads *= 2){
+        ConcurrentContact c;
+        double t = seconds([&]{ merge_all(c, uploads, threads); });
+        std::cout << "merge," << threads << "," << p.edges / t << ",edges/s" << std::endl;
+        // Every edge again, all of it already there
+        t = seconds([&]{ merge_all(c, uploads, threads); });
+        std::cout << "merge_again," << threads << "," << p.edges / t << ",edges/s" << std::endl;
+    }
+
+    // One new contact of an existing user into graphs of growing size
+    for(uint64_t edges = p.edges / 100; edges <= p.edges; edges *= 10){
+        ConcurrentContact c;
+        std::vector<contact_data> part(uploads.begin(), uploads.begin() + std::max<uint64_t>(1, edges / 1000));
+        merge_all(c, part, 1);
+        const int merges = 1000;
+        double t = seconds([&]{
+            for(int i = 0; i < merges; i++){
+                contact_data d;
+                d.uid = generated_uid(i);
+                d.uv = {{0, generated_uid(i)}, {1, "NEW" + std::to_string(i)}};
+                d.graph = {{1}, {0}};
+                d.times = {{{0, 1}}, {{0, 1}}};
+                c.Merge(d);
+            }
+        });
+        std::cout << "small_merge_at_" << edges << ",1," << t / merges * 1e6 << ",us" << std::endl;
+    }
+    return 0;
+}
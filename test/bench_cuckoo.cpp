@@ -0,0 +1,69 @@
+// Size and accuracy of contact_filter sketches.
+//
+//   bench_cuckoo [max uids]
+//
+// Builds the filter of a Contact holding 1k, 10k, ... UIDs up to max
+// uids (default 1M), plus a few sizes in between, and reports the real
+// bits per entry, the false positive rate over UIDs that are not in it
+// and whether every UID survives a round trip and removing half.
+#include <chrono>
+#include <iostream>
+#include <secovid/cuckoo.hpp>
+#include "graph_gen.hpp"
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto bench(uint32_t uids) -> bool{
+    graph_gen_params p;
+    p.vertices = uids;
+    p.edges = uids * 4; // Leaves few vertices without a contact
+    Contact c("BENCH");
+    c.AddContact("ALICE", to_contact_data(generate_contacts(p)));
+
+    CuckooFilter f;
+    double t = seconds([&]{ f = contact_filter(c); });
+    uint64_t n = f.Count();
+    std::cout << "build," << n << "," << t * 1e3 << ",ms" << std::endl;
+    std::cout << "bits_per_entry," << n << "," << f.Bytes() * 8.0 / n << ",bits" << std::endl;
+
+    const int probes = 1000000;
+    int wrong = 0;
+    for(int i = 0; i < probes; i++){
+        wrong += f.Contains("absent" + std::to_string(i));
+    }
+    std::cout << "false_positive_rate," << n << "," << (double) wrong / probes << "," << std::endl;
+
+    CuckooFilter back = CuckooFilter::Deserialize(f.Serialize());
+    uint64_t missing = 0;
+    for(int v = 0; v < (int) c.Graph().size(); v++){
+        std::string uid = c.UID(v);
+        if(!uid.empty() && v % 2 == 0){
+            back.Remove(uid);
+        }
+    }
+    for(int v = 0; v < (int) c.Graph().size(); v++){
+        std::string uid = c.UID(v);
+        missing += !uid.empty() && v % 2 == 1 && !back.Contains(uid);
+    }
+    std::cout << "false_negatives," << n << "," << missing << "," << std::endl;
+    return missing == 0;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    uint32_t max_uids = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::cout << "metric,uids,value,unit" << std::endl;
+    bool ok = true;
+    for(uint32_t uids = 1000; uids <= max_uids; uids *= 10){
+        ok = bench(uids) && ok;
+        if(uids * 2.5 <= max_uids){
+            ok = bench(uids * 5 / 2) && ok;
+        }
+    }
+    return ok ? 0 : 1;
+}
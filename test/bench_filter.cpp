@@ -0,0 +1,91 @@
+// Binary fuse filters over published infected tokens.
+//
+//   bench_filter [keys] [probes]
+//
+// Builds 8 and 16 bit filters over random tokens (default 10M, about
+// 70k cases' worth of a day) and prints build time, size per key and
+// the false positive rate over tokens that were never published, then
+// the same for a day of 24 hourly batches, before and after Compact.
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <secovid/fuse.hpp>
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+template<class T>
+auto run(const std::string& name, const std::vector<rolling_token>& tokens, size_t probes) -> int{
+    std::vector<uint64_t> keys;
+    for(auto& t : tokens){
+        keys.push_back(token_key(t));
+    }
+    BinaryFuseFilter<T> filter;
+    double t = seconds([&]{ filter = BinaryFuseFilter<T>(keys); });
+    std::cout << name << "_build," << t << ",s" << std::endl;
+    std::cout << name << "_bits_per_key," << filter.Bytes() * 8.0 / tokens.size() << "," << std::endl;
+
+    int missing = 0;
+    for(auto& token : tokens){
+        missing += !filter.Contains(token);
+    }
+    std::mt19937_64 gen(7);
+    size_t hits = 0;
+    t = seconds([&]{
+        for(size_t i = 0; i < probes; i++){
+            hits += filter.Contains(rolling_token{gen(), gen()});
+        }
+    });
+    std::cout << name << "_lookup," << probes / t / 1e6 << ",Mlookups/s" << std::endl;
+    std::cout << name << "_fpr," << (double) hits / probes << "," << std::endl;
+    std::cout << name << "_missing," << missing << ",keys" << std::endl;
+    return missing;
+}
+
+template<class T>
+auto run_daily(const std::string& name, const std::vector<rolling_token>& tokens, size_t probes) -> int{
+    DailyFilter<T> day(18500);
+    size_t per = tokens.size() / 24 + 1;
+    for(size_t i = 0; i < tokens.size(); i += per){
+        std::vector<rolling_token> batch(tokens.begin() + i, tokens.begin() + std::min(tokens.size(), i + per));
+        day.Append(batch);
+    }
+    int missing = 0;
+    for(int compacted = 0; compacted < 2; compacted++){
+        std::string stage = name + (compacted ? "_compacted" : "_hourly");
+        std::mt19937_64 gen(11);
+        size_t hits = 0;
+        for(size_t i = 0; i < probes; i++){
+            hits += day.Contains(rolling_token{gen(), gen()});
+        }
+        for(auto& token : tokens){
+            missing += !day.Contains(token);
+        }
+        std::cout << stage << "_bits_per_key," << day.Bytes() * 8.0 / tokens.size() << "," << std::endl;
+        std::cout << stage << "_fpr," << (double) hits / probes << "," << std::endl;
+        std::cout << stage << "_fpr_bound," << day.FalsePositiveRate() << "," << std::endl;
+        day.Compact();
+    }
+    return missing;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    size_t n = argc > 1 ? std::stoull(argv[1]) : 10000000;
+    size_t probes = argc > 2 ? std::stoull(argv[2]) : 10000000;
+    std::mt19937_64 gen(5);
+    std::vector<rolling_token> tokens(n);
+    for(auto& t : tokens){
+        t = rolling_token{gen(), gen()};
+    }
+    std::cout << "metric,value,unit" << std::endl;
+    int missing = run<uint8_t>("fuse8", tokens, probes);
+    missing += run<uint16_t>("fuse16", tokens, probes);
+    missing += run_daily<uint8_t>("daily8", tokens, probes);
+    missing += run_daily<uint16_t>("daily16", tokens, probes);
+    return missing == 0 ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+// Contact graph benchmarks over synthetic graphs.
+//
+//   bench_graph [max edges] [results.csv]
+//
+// Runs every benchmark for 1k, 10k, ... edges up to max edges (default
+// 1M) and prints one CSV row per result. With a second argument the
+// rows are also appended to that file, prefixed with the time of the
+// run, so results can be tracked across commits. Every benchmark,
+// merging included, runs at every size; 100M edges takes about 16 GB
+// for the contact_data, the merged Contact and the CSR together.
+#include <ctime>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <secovid/chain.hpp>
+#include <secovid/compact.hpp>
+#include <secovid/csr.hpp>
+#include <secovid/graph_view.hpp>
+#include <secovid/risk.hpp>
+#include <secovid/temporal.hpp>
+#include "graph_gen.hpp"
+
+std::ofstream results;
+std::time_t run = std::time(nullptr);
+
+auto report(const std::string& name, uint64_t edges, uint32_t vertices, double value, const std::string& unit) -> void{
+    std::stringstream row;
+    row << name << "," << edges << "," << vertices << "," << value << "," << unit;
+    std::cout << row.str() << std::endl;
+    if(results.is_open()){
+        results << run << "," << row.str() << std::endl;
+    }
+}
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+// Heap held by a graph, counting a std::map node as its value plus
+// three pointers and a colour word
+auto memory_of(const contact_data& d) -> uint64_t{
+    const uint64_t node = 4 * sizeof(void*);
+    uint64_t bytes = 0;
+    for(auto& x : d.uv){
+        bytes += node + sizeof(x) + x.second.capacity();
+    }
+    for(auto& x : d.vu){
+        bytes += node + sizeof(x) + x.first.capacity();
+    }
+    bytes += d.graph.capacity() * sizeof(d.graph[0]) + d.times.capacity() * sizeof(d.times[0]);
+    for(size_t u = 0; u < d.graph.size(); u++){
+        bytes += d.graph[u].capacity() * sizeof(int);
+        bytes += d.times[u].capacity() * sizeof(contact_interval);
+    }
+    return bytes;
+}
+
+// A Contact holds what its contact_data snapshot does plus the version
+// logs; its cluster index is not counted
+auto memory_of(Contact& c) -> uint64_t{
+    return memory_of(c.Data()) + c.LogBytes();
+}
+
+auto memory_of(const csr_graph& g) -> uint64_t{
+    return g.offsets.capacity() * sizeof(uint64_t) + g.edges.capacity() * sizeof(uint32_t)
+        + g.times.capacity() * sizeof(contact_interval);
+}
+
+// Number of vertices within k hops of source
+auto khop(const csr_graph& g, uint32_t source, int k, std::vector<uint32_t>& seen, uint32_t stamp) -> uint64_t{
+    std::vector<uint32_t> frontier{source}, next;
+    seen[source] = stamp;
+    uint64_t reached = 1;
+    for(int hop = 0; hop < k && !frontier.empty(); hop++){
+        next.clear();
+        for(uint32_t u : frontier){
+            for(uint64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++){
+                uint32_t v = g.edges[e];
+                if(seen[v] != stamp){
+                    seen[v] = stamp;
+                    next.push_back(v);
+                }
+            }
+        }
+        reached += next.size();
+        frontier.swap(next);
+    }
+    return reached;
+}
+
+auto bench(uint64_t edges) -> void{
+    graph_gen_params p;
+    p.edges = edges;
+    p.vertices = static_cast<uint32_t>(std::max<uint64_t>(edges / 8, 100));
+    generated_graph gg;
+    report("generate", edges, p.vertices, seconds([&]{ gg = generate_contacts(p); }), "s");
+
+    contact_data d = to_contact_data(gg);
+    report("contact_data_memory", edges, p.vertices, (double) memory_of(d) / p.vertices, "bytes/vertex");
+    csr_graph g = to_csr(d);
+    report("csr_memory", edges, p.vertices, (double) memory_of(g) / p.vertices, "bytes/vertex");
+
+    // Every edge of the peer graph is merged, so this is merged edges/s
+    {
+        Contact c("BENCH");
+        double t = seconds([&]{ c.AddContact(d.uid, d); });
+        report("add_contact", edges, p.vertices, edges / t, "edges/s");
+        report("contact_memory", edges, p.vertices, (double) memory_of(c) / p.vertices, "bytes/vertex");
+    }
+
+    std::string buf;
+    double t = seconds([&]{
+        std::stringstream ss;
+        {
+            cereal::PortableBinaryOutputArchive oarchive(ss);
+            oarchive(d);
+        }
+        buf = ss.str();
+    });
+    report("cereal_serialize", edges, p.vertices, edges / t, "edges/s");
+    report("cereal_bytes", edges, p.vertices, (double) buf.size() / edges, "bytes/edge");
+    t = seconds([&]{
+        std::stringstream ss(buf);
+        contact_data rez;
+        cereal::PortableBinaryInputArchive iarchive(ss);
+        iarchive(rez);
+    });
+    report("cereal_deserialize", edges, p.vertices, edges / t, "edges/s");
+
+    t = seconds([&]{ buf = compact_encode(d); });
+    report("compact_serialize", edges, p.vertices, edges / t, "edges/s");
+    report("compact_bytes", edges, p.vertices, (double) buf.size() / edges, "bytes/edge");
+    t = seconds([&]{ compact_decode(buf); });
+    report("compact_deserialize", edges, p.vertices, edges / t, "edges/s");
+
+    const std::string snapshot = "bench_graph.kg";
+    t = seconds([&]{ write_graph_snapshot(d, snapshot); });
+    report("snapshot_write", edges, p.vertices, edges / t, "edges/s");
+    {
+        GraphView view;
+        t = seconds([&]{ view.Open(snapshot); });
+        report("snapshot_open", edges, p.vertices, t * 1e3, "ms");
+    }
+    std::remove(snapshot.c_str());
+
+    std::vector<uint32_t> seen(g.Vertices(), 0);
+    uint64_t reached = 0;
+    t = seconds([&]{ reached = khop(g, 0, g.Vertices(), seen, 1); });
+    report("bfs", edges, p.vertices, g.edges.size() / t, "edges/s");
+
+    std::mt19937 gen(7);
+    const int queries = 1000;
+    t = seconds([&]{
+        for(int q = 0; q < queries; q++){
+            reached += khop(g, gen() % p.vertices, 2, seen, q + 2);
+        }
+    });
+    report("two_hop_query", edges, p.vertices, t / queries * 1e6, "us");
+
+    t = seconds([&]{ earliest_arrival(d.graph, d.times, 0, p.start); });
+    report("earliest_arrival", edges, p.vertices, edges / t, "edges/s");
+
+    // Risk from a hundred seeds over four rounds, the target being
+    // 10M edges in under a second
+    risk_params rp;
+    std::vector<float> w;
+    t = seconds([&]{ w = exposure_weights(g, rp); });
+    report("risk_weights", edges, p.vertices, t * 1e3, "ms");
+    std::vector<float> seed(g.Vertices(), 0.0f);
+    for(int i = 0; i < 100; i++){
+        seed[gen() % g.Vertices()] = 1.0f;
+    }
+    t = seconds([&]{ exposure_risk(g, w, seed, rp.iterations); });
+    report("exposure_risk", edges, p.vertices, t * 1e3, "ms");
+
+    ChainSearch search(g);
+    const int chains = 100;
+    t = seconds([&]{
+        for(int q = 0; q < chains; q++){
+            reached += search.Find(gen() % p.vertices, gen() % p.vertices, p.start).size();
+        }
+    });
+    report("exposure_chain", edges, p.vertices, t / chains * 1e3, "ms");
+}
+
+auto main(int argc, char* argv[]) -> int{
+    uint64_t max_edges = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    if(argc > 2){
+        results.open(argv[2], std::ios::app);
+    }
+    std::cout << "benchmark,edges,vertices,value,unit" << std::endl;
+    for(uint64_t edges = 1000; edges <= max_edges; edges *= 10){
+        bench(edges);
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Ratchet tree group keys against sealing to every member.
+//
+//   bench_group [largest group]
+//
+// For groups of 10 members up to the largest (default 10,000) in steps
+// of ten, builds the group with one commit, fills the tree with a
+// commit under every pair of leaves (each from a member added back so
+// it holds the epoch's key), then times a member rotating its key,
+// another member following it, adding and removing a member, and
+// compares with sealing a key to every member separately. Every member
+// tracked checks that it reaches the same group key.
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <secovid/group.hpp>
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto same_key(const GroupTree& a, const GroupTree& b) -> bool{
+    return a.Key() == b.Key() && a.Open(b.Seal("report")) == "report";
+}
+
+auto run(uint32_t n) -> int{
+    std::vector<tree_key> leaves(n), pubs(n);
+    for(uint32_t i = 0; i < n; i++){
+        tree_random(leaves[i]);
+        pubs[i] = tree_public(leaves[i]);
+    }
+    GroupTree creator(leaves[0]);
+    group_commit c;
+    double t = seconds([&]{ c = creator.Commit(std::vector<tree_key>(pubs.begin() + 1, pubs.end())); });
+    std::cout << n << ",create," << t * 1e3 << ",ms" << std::endl;
+
+    // Two members followed from the start, far apart in the tree
+    GroupTree near(creator.State(), 1, leaves[1]);
+    GroupTree far(creator.State(), n - 1, leaves[n - 1]);
+    near.Join(c);
+    far.Join(c);
+    int wrong = !same_key(creator, near) + !same_key(creator, far);
+
+    // Pairs of leaves in bit reversed order, so the high nodes fill
+    // first and later commits seal to few keys
+    uint32_t bits = 0;
+    while((1u << bits) < n / 2){
+        bits++;
+    }
+    for(uint32_t pair = 1; pair < (1u << bits); pair++){
+        uint32_t leaf = 0;
+        for(uint32_t b = 0; b < bits; b++){
+            leaf |= ((pair >> b) & 1) << (bits - 1 - b);
+        }
+        leaf *= 2;
+        if(leaf + 1 >= n){
+            continue;
+        }
+        // Only members of the epoch can commit, so the member is
+        // removed and added back to learn the epoch's key
+        c = creator.Commit({pubs[leaf]}, {leaf});
+        near.Apply(c);
+        far.Apply(c);
+        GroupTree member(creator.State(), leaf, leaves[leaf]);
+        member.Join(c);
+        c = member.Commit();
+        creator.Apply(c);
+        near.Apply(c);
+        far.Apply(c);
+    }
+    wrong += !same_key(creator, near) + !same_key(creator, far);
+
+    t = seconds([&]{ c = near.Commit(); });
+    std::cout << n << ",update," << t * 1e3 << ",ms" << std::endl;
+    std::cout << n << ",update_seals," << [&]{ size_t s = 0; for(auto& p : c.path){ s += p.sealed.size(); } return s; }() << "," << std::endl;
+    t = seconds([&]{ far.Apply(c); });
+    std::cout << n << ",apply," << t * 1e3 << ",ms" << std::endl;
+    creator.Apply(c);
+    wrong += !same_key(creator, near) + !same_key(creator, far);
+
+    tree_key joiner;
+    tree_random(joiner);
+    t = seconds([&]{ c = far.Commit({tree_public(joiner)}, {n / 2}); });
+    std::cout << n << ",add_remove," << t * 1e3 << ",ms" << std::endl;
+    creator.Apply(c);
+    near.Apply(c);
+    GroupTree added(far.State(), far.Leaves(tree_public(joiner))[0], joiner);
+    added.Join(c);
+    wrong += !same_key(creator, near) + !same_key(creator, far) + !same_key(creator, added);
+
+    std::string report(1024, 'r');
+    std::string sealed;
+    t = seconds([&]{ sealed = creator.Seal(report); });
+    std::cout << n << ",seal_report," << t * 1e6 << ",us" << std::endl;
+
+    // One key exchange per member, as sealing every report to each
+    // member separately would need
+    t = seconds([&]{
+        tree_key eph;
+        tree_random(eph);
+        for(uint32_t i = 0; i < n; i++){
+            tree_dh(eph, pubs[i]);
+        }
+    });
+    std::cout << n << ",seal_each_member," << t * 1e3 << ",ms" << std::endl;
+    std::cout << n << ",wrong_keys," << wrong << "," << std::endl;
+    return wrong;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    uint32_t largest = argc > 1 ? std::stoul(argv[1]) : 10000;
+    std::cout << "members,metric,value,unit" << std::endl;
+    int wrong = 0;
+    for(uint32_t n = 10; n <= largest; n *= 10){
+        wrong += run(n);
+    }
+    return wrong == 0 ? 0 : 1;
+}
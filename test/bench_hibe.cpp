@@ -0,0 +1,106 @@
+// Extraction throughput per tier of hierarchical IBE.
+//
+//   bench_hibe [regions] [users per region]
+//
+// The root PKG extracts a domain key per region and passes it over a
+// pipe to a forked regional sub-PKG process, which extracts keys for
+// its users, checks that one of them opens a message encrypted to it
+// under the root public key, and reports its extraction rate.
+#include <chrono>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <secovid/hibe.hpp>
+
+G1 generator;
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto read_line(int fd) -> std::string{
+    std::string s;
+    char c;
+    while(read(fd, &c, 1) == 1 && c != '\n'){
+        s += c;
+    }
+    return s;
+}
+
+auto run_region(int fd, const std::string& domain, int users) -> int{
+    id_pri_key dk;
+    dk.d.deserializeHexStr(read_line(fd));
+    dk.q.deserializeHexStr(read_line(fd));
+    m_pub_k root;
+    root.g1.deserializeHexStr(read_line(fd));
+
+    SubPKG region(domain, dk, root);
+    std::vector<hibe_key> keys;
+    double t = seconds([&]{
+        for(int u = 0; u < users; u++){
+            keys.push_back(region.extract("user" + std::to_string(u)));
+        }
+    });
+    std::cout << domain << ",region_extract," << users / t << ",keys/s" << std::endl;
+
+    std::string msg;
+    auto c = hibe_encrypt(&root, domain, "user0", "exposure notice");
+    bool ok = hibe_decrypt(keys[0], c, msg) && msg == "exposure notice";
+    // Another user of the region can not open it
+    ok = ok && (users < 2 || !hibe_decrypt(keys[1], c, msg));
+    t = seconds([&]{ hibe_decrypt(keys[0], c, msg); });
+    std::cout << domain << ",decrypt," << t * 1e3 << ",ms" << std::endl;
+    return ok ? 0 : 1;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    int regions = argc > 1 ? std::stoi(argv[1]) : 4;
+    int users = argc > 2 ? std::stoi(argv[2]) : 1000;
+
+    PKG root;
+    std::cout << "tier,metric,value,unit" << std::endl;
+    std::vector<std::string> domains;
+    for(int r = 0; r < regions; r++){
+        domains.push_back("region" + std::to_string(r));
+    }
+    std::vector<id_pri_key> domain_keys;
+    double t = seconds([&]{
+        for(auto& d : domains){
+            domain_keys.push_back(root.extract_domain(d));
+        }
+    });
+    std::cout << "root,domain_extract," << regions / t << ",keys/s" << std::endl;
+
+    std::vector<pid_t> children;
+    for(int r = 0; r < regions; r++){
+        int fds[2];
+        if(pipe(fds) != 0){
+            return 1;
+        }
+        pid_t pid = fork();
+        if(pid == 0){
+            close(fds[1]);
+            _exit(run_region(fds[0], domains[r], users));
+        }
+        close(fds[0]);
+        std::string keys = domain_keys[r].d.serializeToHexStr() + "\n" + domain_keys[r].q.serializeToHexStr() + "\n"
+            + root.m_pub.g1.serializeToHexStr() + "\n";
+        if(write(fds[1], keys.data(), keys.size()) != static_cast<ssize_t>(keys.size())){
+            return 1;
+        }
+        close(fds[1]);
+        children.push_back(pid);
+    }
+    int failed = 0;
+    for(pid_t pid : children){
+        int status;
+        waitpid(pid, &status, 0);
+        failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    std::cout << "all,failed_regions," << failed << "," << std::endl;
+    return failed == 0 ? 0 : 1;
+}
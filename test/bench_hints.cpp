@@ -0,0 +1,55 @@
+// Scanning a shared mailbox for one user's messages by hint.
+//
+//   bench_hints [entries] [mine]
+//
+// Fills a mailbox (default 100k entries) with hints spread over two
+// weeks, a few of them (default 20) for the scanning user and the rest
+// for other users, then times HintKeys::Scan and checks it finds
+// exactly the user's entries.
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <secovid/hints.hpp>
+#include <secovid/tokens.hpp>
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto main(int argc, char* argv[]) -> int{
+    size_t entries = argc > 1 ? std::stoull(argv[1]) : 100000;
+    size_t mine = argc > 2 ? std::stoull(argv[2]) : 20;
+    uint32_t today = token_day(1589500000);
+    std::mt19937_64 gen(3);
+
+    HintKeys me, others;
+    for(uint32_t d = today - 13; d <= today; d++){
+        me.Key(d);
+        others.Key(d);
+    }
+    std::vector<hint> mailbox;
+    std::vector<size_t> expected;
+    // At least 1, as with more of mine than entries every entry is mine
+    size_t every = std::max<size_t>(entries / std::max<size_t>(mine, 1), 1);
+    for(size_t i = 0; i < entries; i++){
+        uint32_t day = today - gen() % 14;
+        if(i % every == 0 && expected.size() < mine){
+            expected.push_back(i);
+            mailbox.push_back(make_hint(me.Key(day)));
+        }else{
+            mailbox.push_back(make_hint(others.Key(day)));
+        }
+    }
+
+    std::vector<size_t> found;
+    double t = seconds([&]{ found = me.Scan(mailbox); });
+    std::cout << "metric,value,unit" << std::endl;
+    std::cout << "scan," << t * 1e3 << ",ms" << std::endl;
+    std::cout << "scan_rate," << entries / t / 1e6 << ",Mentries/s" << std::endl;
+    std::cout << "found," << found.size() << ",entries" << std::endl;
+    return found == expected ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+// Mailbox segment store under notification fan-out.
+//
+//   bench_mailbox [directory] [messages] [recipients] [bytes]
+//
+// Appends messages (default 1M of 256 bytes) for random recipients
+// (default 100k) in batches like a fan-out, then reads every
+// recipient's mailbox back through the mappings and through sendfile,
+// reopens the store and checks that every record survived.
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <fcntl.h>
+#include <secovid/mailbox.hpp>
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto main(int argc, char* argv[]) -> int{
+    std::string dir = argc > 1 ? argv[1] : "mailbox_bench";
+    size_t messages = argc > 2 ? std::stoull(argv[2]) : 1000000;
+    size_t recipients = argc > 3 ? std::stoull(argv[3]) : 100000;
+    size_t bytes = argc > 4 ? std::stoull(argv[4]) : 256;
+    std::mt19937_64 gen(9);
+    std::string mkdir = "mkdir -p " + dir + " && rm -f " + dir + "/*.seg";
+    if(system(mkdir.c_str()) != 0){
+        return 1;
+    }
+
+    std::vector<uint64_t> ids(recipients);
+    for(size_t i = 0; i < recipients; i++){
+        ids[i] = mailbox_id(std::to_string(i));
+    }
+    std::vector<std::string> batch(1, std::string(bytes, 'c'));
+    std::cout << "metric,value,unit" << std::endl;
+    {
+        Mailbox box(dir);
+        double t = seconds([&]{
+            for(size_t i = 0; i < messages; i++){
+                box.Append(ids[gen() % recipients], batch[0]);
+            }
+        });
+        std::cout << "append," << messages / t / 1e3 << ",kmsg/s" << std::endl;
+        std::cout << "append_bandwidth," << messages * (bytes + sizeof(mailbox_header)) / t / 1e6 << ",MB/s" << std::endl;
+        std::cout << "segments," << box.Segments() << "," << std::endl;
+
+        std::vector<std::string> fan(16, std::string(bytes, 'f'));
+        t = seconds([&]{
+            for(size_t i = 0; i < messages / fan.size(); i++){
+                box.Append(ids[gen() % recipients], fan);
+            }
+        });
+        std::cout << "append_batched," << messages / t / 1e3 << ",kmsg/s" << std::endl;
+    }
+
+    Mailbox box(dir);
+    size_t read = 0;
+    double t = seconds([&]{
+        std::vector<std::shared_ptr<MailboxSegment>> held;
+        for(uint64_t id : ids){
+            for(auto& item : box.Read(id, 0, held)){
+                read += item.length == bytes;
+            }
+            held.clear();
+        }
+    });
+    std::cout << "read_mapped," << read / t / 1e3 << ",kmsg/s" << std::endl;
+    int null = open("/dev/null", O_WRONLY);
+    t = seconds([&]{
+        for(size_t i = 0; i < recipients / 10; i++){
+            box.Send(null, ids[i], 0);
+        }
+    });
+    close(null);
+    std::cout << "read_sendfile," << recipients / 10 / t / 1e3 << ",kmailbox/s" << std::endl;
+    std::cout << "reopened_records," << read << "," << std::endl;
+    return read == messages + messages / 16 * 16 ? 0 : 1;
+}
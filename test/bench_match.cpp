@@ -0,0 +1,98 @@
+// Matching published day keys against a phone's token log.
+//
+//   bench_match [published keys] [sightings]
+//
+// Publishes keys for one day (default 100k, a national day's worth),
+// fills the log with sightings (default 1M) of which a few hundred are
+// tokens of published keys, and times expanding the keys, intersecting
+// on each kernel and the whole TokenLog::Match.
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <secovid/tokens.hpp>
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto main(int argc, char* argv[]) -> int{
+    size_t keys = argc > 1 ? std::stoull(argv[1]) : 100000;
+    size_t sightings = argc > 2 ? std::stoull(argv[2]) : 1000000;
+    uint32_t day = token_day(1589500000);
+    std::mt19937_64 gen(5);
+
+    std::vector<day_key> published;
+    for(size_t i = 0; i < keys; i++){
+        published.push_back(new_day_key(day));
+    }
+    std::vector<rolling_token> tokens(keys * TOKENS_PER_DAY);
+    double t = seconds([&]{
+        TokenPRF prf;
+        for(size_t i = 0; i < keys; i++){
+            prf.Expand(published[i], 0, TOKENS_PER_DAY, &tokens[i * TOKENS_PER_DAY]);
+        }
+    });
+    std::cout << "expand," << tokens.size() / t / 1e6 << ",Mtokens/s" << std::endl;
+
+    std::vector<sighting> seen;
+    for(size_t i = 0; i < sightings; i++){
+        uint32_t when = day * 86400 + gen() % 86400;
+        rolling_token token{gen(), gen()};
+        if(i % 4000 == 0){
+            // Heard from an infected phone
+            uint32_t interval = when / TOKEN_INTERVAL % TOKENS_PER_DAY;
+            token = tokens[(gen() % keys) * TOKENS_PER_DAY + interval];
+        }
+        seen.push_back(sighting{token, when, when + 60});
+    }
+    std::vector<rolling_token> heard;
+    for(auto& s : seen){
+        heard.push_back(s.token);
+    }
+
+    std::vector<uint64_t> pa(tokens.size()), pb(heard.size());
+    std::vector<uint32_t> ka(pa.size()), kb(pb.size());
+    for(uint32_t i = 0; i < tokens.size(); i++){
+        pa[i] = (tokens[i].hi & 0xffffffff00000000ULL) | i;
+    }
+    for(uint32_t i = 0; i < heard.size(); i++){
+        pb[i] = (heard[i].hi & 0xffffffff00000000ULL) | i;
+    }
+    t = seconds([&]{ radix_sort_pairs(pa); radix_sort_pairs(pb); });
+    std::cout << "radix_sort," << (pa.size() + pb.size()) / t / 1e6 << ",Mkeys/s" << std::endl;
+    for(size_t i = 0; i < pa.size(); i++){
+        ka[i] = static_cast<uint32_t>(pa[i] >> 32);
+    }
+    for(size_t i = 0; i < pb.size(); i++){
+        kb[i] = static_cast<uint32_t>(pb[i] >> 32);
+    }
+    std::vector<uint8_t> hit(ka.size());
+    t = seconds([&]{ intersect_mask_scalar(ka.data(), ka.size(), 0, kb.data(), kb.size(), 0, hit.data()); });
+    std::cout << "intersect_scalar," << t * 1e3 << ",ms" << std::endl;
+    if(__builtin_cpu_supports("avx2")){
+        t = seconds([&]{ intersect_mask_avx2(ka.data(), ka.size(), kb.data(), kb.size(), hit.data()); });
+        std::cout << "intersect_avx2," << t * 1e3 << ",ms" << std::endl;
+    }
+    if(__builtin_cpu_supports("avx512f")){
+        t = seconds([&]{ intersect_mask_avx512(ka.data(), ka.size(), kb.data(), kb.size(), hit.data()); });
+        std::cout << "intersect_avx512," << t * 1e3 << ",ms" << std::endl;
+    }
+
+    TokenLog log;
+    log.Record(seen);
+    std::vector<token_match> matches;
+    t = seconds([&]{ matches = log.Match(published); });
+    std::cout << "match," << t << ",s" << std::endl;
+    std::cout << "matches," << matches.size() << "," << std::endl;
+
+    std::vector<sighting> few(seen.begin(), seen.begin() + std::min<size_t>(seen.size(), tokens.size() / TOKEN_SKEW / 2));
+    TokenLog small;
+    small.Record(few);
+    t = seconds([&]{ matches = small.Match(published); });
+    std::cout << "match_skewed," << t << ",s" << std::endl;
+    return 0;
+}
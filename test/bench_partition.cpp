@@ -0,0 +1,124 @@
+// Partitioned contact graph over local shard processes.
+//
+//   bench_partition [shards] [edges] [queries] [hops] [port]
+//
+// Partitions a synthetic graph by vertex id and by label propagation,
+// prints the share of cut edges for both, then forks one process per
+// shard and runs k-hop BFS queries over the label propagation shards.
+// Shard 0 checks every answer against a single machine BFS and prints
+// the query latency.
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <secovid/bsp.hpp>
+#include "graph_gen.hpp"
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto khop(const csr_graph& g, uint32_t source, uint32_t k) -> uint64_t{
+    std::vector<bool> seen(g.Vertices(), false);
+    std::vector<uint32_t> frontier{source}, next;
+    seen[source] = true;
+    uint64_t reached = 1;
+    for(uint32_t hop = 0; hop < k && !frontier.empty(); hop++){
+        next.clear();
+        for(uint32_t u : frontier){
+            for(uint64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++){
+                if(!seen[g.edges[e]]){
+                    seen[g.edges[e]] = true;
+                    next.push_back(g.edges[e]);
+                }
+            }
+        }
+        reached += next.size();
+        frontier.swap(next);
+    }
+    return reached;
+}
+
+auto run_shard(shard_graph sg, const csr_graph& g, const partition& p, int queries, uint32_t k, uint16_t port) -> int{
+    BspShard shard(std::move(sg));
+    shard.Connect("127.0.0.1", port);
+    bool lead = shard.Graph().shard == 0;
+    std::mt19937 gen(11);
+    std::vector<double> latency;
+    int wrong = 0;
+    for(int q = 0; q < queries; q++){
+        uint32_t v = gen() % g.Vertices();
+        uint64_t reached = 0;
+        latency.push_back(seconds([&]{ reached = shard.KHop(p.owner[v], p.local[v], k); }) * 1e3);
+        if(lead && reached != khop(g, v, k)){
+            wrong++;
+        }
+    }
+    if(lead){
+        std::sort(latency.begin(), latency.end());
+        double mean = 0;
+        for(double l : latency){
+            mean += l;
+        }
+        std::cout << "khop_latency_mean," << mean / latency.size() << ",ms" << std::endl;
+        std::cout << "khop_latency_p50," << latency[latency.size() / 2] << ",ms" << std::endl;
+        std::cout << "khop_latency_p99," << latency[latency.size() * 99 / 100] << ",ms" << std::endl;
+        std::cout << "khop_wrong," << wrong << ",queries" << std::endl;
+    }
+    return wrong == 0 ? 0 : 1;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    uint32_t shards = argc > 1 ? std::stoul(argv[1]) : 4;
+    graph_gen_params gp;
+    gp.edges = argc > 2 ? std::stoull(argv[2]) : 1000000;
+    gp.vertices = static_cast<uint32_t>(std::max<uint64_t>(gp.edges / 8, 100));
+    int queries = argc > 3 ? std::stoi(argv[3]) : 100;
+    uint32_t k = argc > 4 ? std::stoul(argv[4]) : 2;
+    uint16_t port = argc > 5 ? std::stoul(argv[5]) : 9300;
+
+    generated_graph gg = generate_contacts(gp);
+    csr_graph g = to_csr(to_contact_data(gg));
+
+    partition p;
+    std::cout << "metric,value,unit" << std::endl;
+    p = hash_partition(g, shards);
+    std::cout << "hash_cut_ratio," << cut_ratio(g, p) << "," << std::endl;
+    double t = seconds([&]{ p = label_propagation(g, shards); });
+    std::cout << "label_propagation_time," << t << ",s" << std::endl;
+    std::cout << "label_propagation_cut_ratio," << cut_ratio(g, p) << "," << std::endl;
+
+    std::vector<shard_graph> parts = split_graph(g, p);
+    uint64_t ghosts = 0;
+    for(auto& sg : parts){
+        ghosts += sg.Ghosts();
+    }
+    std::cout << "ghosts_per_vertex," << (double) ghosts / g.Vertices() << "," << std::endl;
+
+    std::vector<pid_t> children;
+    for(uint32_t s = 0; s < shards; s++){
+        pid_t pid = fork();
+        if(pid == 0){
+            int rez = 1;
+            try{
+                rez = run_shard(std::move(parts[s]), g, p, queries, k, port);
+            }catch(const std::exception& e){
+                std::cerr << "shard " << s << ": " << e.what() << std::endl;
+            }
+            _exit(rez);
+        }
+        children.push_back(pid);
+    }
+    int failed = 0;
+    for(pid_t pid : children){
+        int status;
+        waitpid(pid, &status, 0);
+        failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    return failed == 0 ? 0 : 1;
+}
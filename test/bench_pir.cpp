@@ -0,0 +1,135 @@
+// Two server XOR PIR over mailbox buckets.
+//
+//   bench_pir [database MB] [bucket bytes] [queries] [port]
+//
+// Fills a database (default 1 GB of 4 KB buckets), times one pass of
+// each xor kernel over it against memcpy as the memory bandwidth
+// ceiling, then forks two server processes sharing the buckets and
+// fetches random buckets through them, checking every one.
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <secovid/pir.hpp>
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+template<class K>
+auto scan(const PirDatabase& db, K kernel) -> double{
+    std::vector<uint8_t> acc(db.BucketBytes(), 0);
+    double t = seconds([&]{
+        for(uint64_t b = 0; b < db.Buckets(); b++){
+            kernel(acc.data(), db.Bucket(b), db.BucketBytes());
+        }
+    });
+    return db.Buckets() * db.BucketBytes() / t / 1e9;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    uint64_t mb = argc > 1 ? std::stoull(argv[1]) : 1024;
+    uint64_t bytes = argc > 2 ? std::stoull(argv[2]) : 4096;
+    int queries = argc > 3 ? std::stoi(argv[3]) : 32;
+    uint16_t port = argc > 4 ? std::stoul(argv[4]) : 9500;
+
+    PirDatabase db((mb << 20) / bytes, bytes);
+    std::mt19937_64 gen(8);
+    for(uint64_t b = 0; b < db.Buckets(); b++){
+        uint64_t* p = reinterpret_cast<uint64_t*>(db.Bucket(b));
+        for(uint64_t i = 0; i < db.BucketBytes() / 8; i++){
+            p[i] = gen();
+        }
+    }
+
+    std::cout << "metric,value,unit" << std::endl;
+    std::vector<uint8_t> copy(db.BucketBytes() * 1024);
+    double t = seconds([&]{
+        for(uint64_t b = 0; b < db.Buckets(); b++){
+            memcpy(&copy[(b % 1024) * db.BucketBytes()], db.Bucket(b), db.BucketBytes());
+        }
+    });
+    std::cout << "memcpy," << db.Buckets() * db.BucketBytes() / t / 1e9 << ",GB/s" << std::endl;
+    std::cout << "xor_scalar," << scan(db, pir_xor_scalar) << ",GB/s" << std::endl;
+    if(__builtin_cpu_supports("avx2")){
+        std::cout << "xor_avx2," << scan(db, pir_xor_avx2) << ",GB/s" << std::endl;
+    }
+    if(__builtin_cpu_supports("avx512f")){
+        std::cout << "xor_avx512," << scan(db, pir_xor_avx512) << ",GB/s" << std::endl;
+    }
+
+    PirClient client(db.Buckets());
+    std::vector<std::string> batch;
+    for(uint32_t q = 0; q < PIR_BATCH; q++){
+        batch.push_back(client.Query(gen() % db.Buckets()).first);
+    }
+    t = seconds([&]{ db.Answer(batch); });
+    std::cout << "answer_batch," << t * 1e3 << ",ms" << std::endl;
+    std::cout << "answer_scan," << db.Buckets() * db.BucketBytes() / t / 1e9 << ",GB/s" << std::endl;
+    std::cout << "answer_per_query," << t * 1e3 / PIR_BATCH << ",ms" << std::endl;
+
+    // The children share the parent's buckets copy on write
+    std::vector<pid_t> children;
+    for(int s = 0; s < 2; s++){
+        pid_t pid = fork();
+        if(pid == 0){
+            int rez = 1;
+            try{
+                PirServer server(db, port + s);
+                server.ServeOne();
+                rez = 0;
+            }catch(const std::exception& e){
+                std::cerr << "server " << s << ": " << e.what() << std::endl;
+            }
+            _exit(rez);
+        }
+        children.push_back(pid);
+    }
+
+    int wrong = 0;
+    try{
+        std::unique_ptr<PirFetcher> fetcher;
+        for(int attempt = 0; !fetcher; attempt++){
+            try{
+                fetcher.reset(new PirFetcher(db.Buckets(), bytes, "127.0.0.1", port, port + 1));
+            }catch(const std::exception&){
+                if(attempt == 100){
+                    throw;
+                }
+                usleep(50000);
+            }
+        }
+        std::vector<uint64_t> want;
+        for(int q = 0; q < queries; q++){
+            want.push_back(gen() % db.Buckets());
+        }
+        std::vector<std::string> got;
+        t = seconds([&]{
+            for(size_t first = 0; first < want.size(); first += PIR_BATCH){
+                std::vector<uint64_t> part(want.begin() + first, want.begin() + std::min(want.size(), first + PIR_BATCH));
+                for(auto& g : fetcher->Fetch(part)){
+                    got.push_back(std::move(g));
+                }
+            }
+        });
+        std::cout << "fetch_latency," << t * 1e3 / ((want.size() + PIR_BATCH - 1) / PIR_BATCH) << ",ms/batch" << std::endl;
+        for(size_t i = 0; i < want.size(); i++){
+            wrong += memcmp(got[i].data(), db.Bucket(want[i]), db.BucketBytes()) != 0;
+        }
+    }catch(const std::exception& e){
+        std::cerr << "client: " << e.what() << std::endl;
+        wrong++;
+    }
+    for(pid_t pid : children){
+        int status;
+        waitpid(pid, &status, 0);
+        wrong += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    std::cout << "wrong," << wrong << ",buckets" << std::endl;
+    return wrong == 0 ? 0 : 1;
+}
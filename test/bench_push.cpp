@@ -0,0 +1,104 @@
+// Push notification of mailbox readers.
+//
+//   bench_push [subscribers] [messages] [prefix bits] [port]
+//
+// Opens stream subscriptions (default 200) on prefixes of random
+// identities and long-polls a few more, measures the CPU the server
+// burns over a second with nothing arriving, then delivers messages
+// (default 1000) to subscribed identities and times how long each takes
+// to reach its subscriber.
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include <sys/resource.h>
+#include <secovid/subscribe.hpp>
+
+using boost::asio::ip::tcp;
+
+template<class F>
+auto seconds(F f) -> double{
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - begin;
+    return d.count();
+}
+
+auto cpu_seconds() -> double{
+    struct rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return u.ru_utime.tv_sec + u.ru_stime.tv_sec + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) / 1e6;
+}
+
+auto subscribe(boost::asio::io_context& io, uint16_t port, uint64_t prefix, uint8_t bits, uint8_t mode, uint64_t after) -> std::unique_ptr<tcp::socket>{
+    std::unique_ptr<tcp::socket> s(new tcp::socket(io));
+    s->connect(tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), port));
+    std::vector<boost::asio::const_buffer> req{
+        boost::asio::buffer(&prefix, sizeof(prefix)),
+        boost::asio::buffer(&bits, 1),
+        boost::asio::buffer(&mode, 1),
+        boost::asio::buffer(&after, sizeof(after))};
+    boost::asio::write(*s, req);
+    return s;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    size_t subscribers = argc > 1 ? std::stoull(argv[1]) : 200;
+    size_t messages = argc > 2 ? std::stoull(argv[2]) : 1000;
+    int bits = argc > 3 ? std::stoi(argv[3]) : 16;
+    uint16_t port = argc > 4 ? std::stoul(argv[4]) : 9400;
+    std::mt19937_64 gen(4);
+    if(system("mkdir -p push_bench && rm -f push_bench/*.seg") != 0){
+        return 1;
+    }
+
+    Mailbox box("push_bench");
+    Subscriptions subs;
+    PushServer server(subs, port, std::chrono::milliseconds(500));
+    boost::asio::io_context io;
+
+    std::vector<uint64_t> ids(subscribers);
+    std::vector<std::unique_ptr<tcp::socket>> streams;
+    for(size_t i = 0; i < subscribers; i++){
+        // Distinct prefixes, so each message wakes one subscriber
+        ids[i] = (static_cast<uint64_t>(i) << (64 - bits)) | (gen() >> bits);
+        streams.push_back(subscribe(io, port, ids[i], bits, 1, 0));
+    }
+    auto poll = subscribe(io, port, ~0ULL, bits, 0, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    double cpu = cpu_seconds();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    std::cout << "metric,value,unit" << std::endl;
+    std::cout << "idle_cpu," << (cpu_seconds() - cpu) * 1e3 << ",ms/s" << std::endl;
+
+    // The long poll times out with nothing for it
+    uint64_t frame[2];
+    boost::asio::read(*poll, boost::asio::buffer(frame));
+    int wrong = frame[0] != 0 || frame[1] != 0;
+
+    std::vector<double> latency;
+    size_t i = 0;
+    for(size_t m = 0; m < messages; m++){
+        i = gen() % subscribers;
+        uint64_t sequence = 0;
+        latency.push_back(seconds([&]{
+            sequence = deliver(box, subs, ids[i], {std::string(256, 'm')});
+            boost::asio::read(*streams[i], boost::asio::buffer(frame));
+        }) * 1e6);
+        wrong += frame[0] != ids[i] || frame[1] != sequence;
+    }
+    std::sort(latency.begin(), latency.end());
+    std::cout << "notify_p50," << latency[latency.size() / 2] << ",us" << std::endl;
+    std::cout << "notify_p99," << latency[latency.size() * 99 / 100] << ",us" << std::endl;
+
+    // A long poll after mail landed answers at once
+    double t = seconds([&]{
+        poll = subscribe(io, port, ids[i], bits, 0, 0);
+        boost::asio::read(*poll, boost::asio::buffer(frame));
+    });
+    std::cout << "late_poll," << t * 1e3 << ",ms" << std::endl;
+    wrong += frame[1] == 0;
+    std::cout << "wrong," << wrong << ",notifications" << std::endl;
+    return wrong == 0 ? 0 : 1;
+}
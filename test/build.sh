@@ -1 +1,36 @@
-g++ test_homo.cpp -o homo -lhelib -lntl  -lpthread -lgmp
\ No newline at end of file
+g++ test_homo.cpp -o homo -lhelib -lntl  -lpthread -lgmp
+g++ -O2 bench_compact.cpp -o bench_compact
+g++ -O2 -fopenmp bench_graph.cpp -o bench_graph
+g++ -O2 bench_partition.cpp -o bench_partition -lpthread
+g++ -O2 -fopenmp bench_match.cpp -o bench_match -lcrypto
+g++ -O2 -fopenmp bench_filter.cpp -o bench_filter -lcrypto
+g++ -O2 bench_group.cpp -o bench_group -lcrypto
+g++ -O2 bench_hints.cpp -o bench_hints -lcrypto
+g++ -O2 bench_mailbox.cpp -o bench_mailbox -lcrypto -lpthread
+g++ -O2 bench_push.cpp -o bench_push -lcrypto -lpthread
+g++ -O2 -fopenmp bench_pir.cpp -o bench_pir -lcrypto -lpthread
+g++ -O2 bench_hibe.cpp ../pkg/pkg.cpp -I../pkg/include -o bench_hibe -lmcl -lsodium -lgmp -lcrypto
+g++ -O2 test_contact.cpp -o test_contact
+g++ -O2 test_graph_view.cpp -o test_graph_view
+g++ -O2 test_concurrent_contact.cpp -o test_concurrent_contact -lpthread
+g++ -O2 bench_concurrent.cpp -o bench_concurrent -lpthread
+g++ -O2 test_generations.cpp -o test_generations -lpthread
+g++ -O2 bench_cuckoo.cpp -o bench_cuckoo
+g++ -O2 test_tokens.cpp -o test_tokens -lcrypto
+g++ -O2 test_bls.cpp -o test_bls $(echo "#include <mcl/bls12_381.hpp>" | g++ -E -x c++ - > /dev/null 2>&1 && echo -lmcl -lgmp -lcrypto)
+g++ -O2 bench_bls.cpp -o bench_bls -lmcl -lgmp -lcrypto
+g++ -O2 test_group.cpp -o test_group -lcrypto
+g++ -O2 test_broadcast.cpp ../pkg/pkg.cpp -I../pkg/include -o test_broadcast -lmcl -lsodium -lgmp -lcrypto -lpthread
+g++ -O2 bench_broadcast.cpp ../pkg/pkg.cpp -I../pkg/include -o bench_broadcast -lmcl -lsodium -lgmp -lcrypto
+g++ -O2 test_ephemeral.cpp ../pkg/pkg.cpp -I../pkg/include -o test_ephemeral -lmcl -lsodium -lgmp -lcrypto -lpthread
+g++ -O2 test_mailbox.cpp -o test_mailbox -lcrypto
+g++ -O2 test_subscribe.cpp -o test_subscribe -lcrypto -lpthread
+g++ -O2 -fopenmp test_pir.cpp -o test_pir -lcrypto -lpthread
+g++ -O2 test_hibe.cpp ../pkg/pkg.cpp -I../pkg/include -o test_hibe -lmcl -lsodium -lgmp -lcrypto
+g++ -O2 test_compact.cpp -o test_compact
+g++ -O2 -fopenmp test_risk.cpp -o test_risk
+g++ -O2 test_cuckoo.cpp -o test_cuckoo
+g++ -O2 test_chain.cpp -o test_chain
+g++ -O2 -fopenmp test_intersect.cpp -o test_intersect -lcrypto
+g++ -O2 -fopenmp test_filter.cpp -o test_filter -lcrypto
+g++ -O2 test_hints.cpp -o test_hints -lcrypto
\ No newline at end of file
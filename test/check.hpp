@@ -0,0 +1,34 @@
+#pragma once
+
+// Checks shared by the test programs. A failed check prints a line, and
+// main returns finish() so that any failure exits non-zero.
+
+#include <atomic>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+#include <functional>
+
+static std::atomic<int> failed{0};
+
+inline void check(bool ok, const std::string& what){
+    if(!ok){
+        std::cout << "FAILED: " << what << std::endl;
+        failed++;
+    }
+}
+
+// True if f throws a runtime_error
+inline bool throws(std::function<void()> f){
+    try{
+        f();
+    }catch(const std::runtime_error&){
+        return true;
+    }
+    return false;
+}
+
+inline int finish(){
+    std::cout << (failed == 0 ? "ok" : "failed") << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+// Synthetic contact graphs for tests and benchmarks.
+//
+// Vertices are split into communities (households, workplaces) whose
+// sizes follow a power law, and every vertex gets a Pareto distributed
+// activity so degrees are power law as well (Chung-Lu). An edge picks
+// its first end by activity, then its second end by activity inside the
+// same community most of the time and across the whole population
+// otherwise. Contacts start during waking hours over the window and
+// last an exponentially distributed number of minutes.
+
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <secovid/contact.hpp>
+
+struct graph_gen_params{
+    uint32_t vertices = 1000;
+    uint64_t edges = 10000;
+    double degree_exponent = 2.5;    // Pareto shape of vertex activity
+    double community_exponent = 2.0; // Power law of community sizes
+    uint32_t max_community = 500;
+    double local = 0.8;              // Share of edges inside a community
+    uint32_t start = 1589500000;     // Window start, seconds
+    uint32_t days = 14;
+    double mean_minutes = 15;
+    uint64_t seed = 1;
+};
+typedef struct graph_gen_params graph_gen_params;
+
+struct generated_graph{
+    uint32_t vertices;
+    std::vector<contact_edge> edges;
+    std::vector<uint32_t> community;
+};
+typedef struct generated_graph generated_graph;
+
+// Picks an index with probability proportional to its weight
+class weighted_pick
+{
+private:
+    std::vector<double> cumulative;
+public:
+    template<class It>
+    weighted_pick(It first, It last){
+        double sum = 0;
+        for(; first != last; ++first){
+            sum += *first;
+            cumulative.push_back(sum);
+        }
+    }
+    template<class Gen>
+    size_t operator()(Gen& gen) const{
+        std::uniform_real_distribution<double> u(0, cumulative.back());
+        size_t i = std::upper_bound(cumulative.begin(), cumulative.end(), u(gen)) - cumulative.begin();
+        return std::min(i, cumulative.size() - 1);
+    }
+};
+
+inline generated_graph generate_contacts(const graph_gen_params& p){
+    std::mt19937_64 gen(p.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    generated_graph g;
+    g.vertices = std::max<uint32_t>(p.vertices, 2);
+
+    // Contiguous communities with power law sizes
+    std::vector<uint32_t> first;
+    for(uint32_t v = 0; v < g.vertices; ){
+        double x = std::pow(1 - unit(gen), -1.0 / (p.community_exponent - 1));
+        uint32_t size = std::min<uint32_t>(std::max<uint32_t>(2, static_cast<uint32_t>(2 * x)), p.max_community);
+        size = std::min(size, g.vertices - v);
+        first.push_back(v);
+        for(uint32_t i = 0; i < size; i++){
+            g.community.push_back(static_cast<uint32_t>(first.size() - 1));
+        }
+        v += size;
+    }
+    first.push_back(g.vertices);
+
+    std::vector<double> activity(g.vertices);
+    for(auto& a : activity){
+        a = std::pow(1 - unit(gen), -1.0 / (p.degree_exponent - 1));
+    }
+    weighted_pick global(activity.begin(), activity.end());
+    std::vector<weighted_pick> within;
+    for(size_t c = 0; c + 1 < first.size(); c++){
+        within.emplace_back(activity.begin() + first[c], activity.begin() + first[c + 1]);
+    }
+
+    std::uniform_int_distribution<uint32_t> day(0, p.days - 1);
+    std::normal_distribution<double> hour(14, 3.5);
+    std::exponential_distribution<double> minutes(1.0 / p.mean_minutes);
+    g.edges.reserve(p.edges);
+    while(g.edges.size() < p.edges){
+        uint32_t u = static_cast<uint32_t>(global(gen));
+        uint32_t c = g.community[u];
+        uint32_t v = unit(gen) < p.local && first[c + 1] - first[c] > 1
+            ? first[c] + static_cast<uint32_t>(within[c](gen))
+            : static_cast<uint32_t>(global(gen));
+        if(u == v){
+            continue;
+        }
+        double h = std::min(23.5, std::max(6.0, hour(gen)));
+        uint32_t begin = p.start + day(gen) * 86400 + static_cast<uint32_t>(h * 3600);
+        uint32_t end = begin + static_cast<uint32_t>(60 * minutes(gen));
+        g.edges.push_back(contact_edge{static_cast<int>(u), static_cast<int>(v), contact_interval{begin, end}});
+    }
+    return g;
+}
+
+inline std::string generated_uid(uint32_t v){
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v * 0x9e3779b97f4a7c15ULL));
+    return buf;
+}
+
+// The same graph as a peer would send it
+inline contact_data to_contact_data(const generated_graph& g, std::string uid = "ALICE"){
+    contact_data d;
+    d.uid = uid;
+    d.graph.resize(std::max<size_t>(g.vertices, SIZE));
+    d.times.resize(d.graph.size());
+    for(uint32_t v = 0; v < g.vertices; v++){
+        d.uv[v] = generated_uid(v);
+        d.vu[d.uv[v]] = v;
+    }
+    for(auto& e : g.edges){
+        d.graph[e.u].push_back(e.v);
+        d.graph[e.v].push_back(e.u);
+        d.times[e.u].push_back(e.t);
+        d.times[e.v].push_back(e.t);
+    }
+    return d;
+}
+
+// The graph as uploads of per edges each, every upload also repeating
+// the first overlap edges of the next, numbered like a peer would
+inline std::vector<contact_data> to_uploads(const generated_graph& g, uint64_t per, uint64_t overlap = 0){
+    std::vector<contact_data> uploads;
+    for(uint64_t first = 0; first < g.edges.size(); first += per){
+        uint64_t last = std::min<uint64_t>(g.edges.size(), first + per + overlap);
+        contact_data d;
+        d.uid = generated_uid(g.edges[first].u);
+        std::map<int, int> local;
+        auto vertex = [&](int v){
+            auto it = local.find(v);
+            if(it != local.end()){
+                return it->second;
+            }
+            int n = static_cast<int>(local.size());
+            local[v] = n;
+            d.uv[n] = generated_uid(v);
+            d.vu[d.uv[n]] = n;
+            d.graph.emplace_back();
+            d.times.emplace_back();
+            return n;
+        };
+        for(uint64_t i = first; i < last; i++){
+            int u = vertex(g.edges[i].u), v = vertex(g.edges[i].v);
+            d.graph[u].push_back(v);
+            d.graph[v].push_back(u);
+            d.times[u].push_back(g.edges[i].t);
+            d.times[v].push_back(g.edges[i].t);
+        }
+        uploads.push_back(std::move(d));
+    }
+    return uploads;
+}
@@ -0,0 +1,130 @@
+// Checks on BLS signing, aggregation, secure contracts and batch
+// verification.
+//
+//   test_bls
+//
+// Built only where mcl is installed; without it, prints "skipped".
+#include <iostream>
+
+#if __has_include(<mcl/bls12_381.hpp>)
+#include <secovid/bls.hpp>
+#include "check.hpp"
+
+auto test_sign() -> void{
+    bls_key alice = bls_keygen(), bob = bls_keygen();
+    G1 sig = bls_sign(alice, "report");
+    check(bls_verify(alice.pub, "report", sig), "signature verifies");
+    check(!bls_verify(alice.pub, "other report", sig), "signature is bound to its message");
+    check(!bls_verify(bob.pub, "report", sig), "signature is bound to its key");
+    check(bls_verify_pop(alice.pub, bls_prove(alice)), "proof of possession verifies");
+    check(!bls_verify_pop(bob.pub, bls_prove(alice)), "proof of possession is bound to its key");
+}
+
+auto test_aggregate() -> void{
+    std::vector<bls_key> keys;
+    std::vector<G2> pubs;
+    std::vector<std::string> msgs;
+    std::vector<G1> sigs;
+    for(int i = 0; i < 4; i++){
+        keys.push_back(bls_keygen());
+        pubs.push_back(keys[i].pub);
+        msgs.push_back("report " + std::to_string(i));
+        sigs.push_back(bls_sign(keys[i], msgs[i]));
+    }
+    G1 sum = bls_aggregate(sigs);
+    check(bls_aggregate_verify(pubs, msgs, sum), "aggregate of distinct messages verifies");
+    std::swap(msgs[0], msgs[1]);
+    check(!bls_aggregate_verify(pubs, msgs, sum), "aggregate is bound to who signed what");
+    std::swap(msgs[0], msgs[1]);
+
+    // Every signature is good, but two are on the same message
+    msgs[3] = msgs[0];
+    sigs[3] = bls_sign(keys[3], msgs[3]);
+    check(!bls_aggregate_verify(pubs, msgs, bls_aggregate(sigs)), "repeated message rejected");
+}
+
+auto test_contract() -> void{
+    std::vector<bls_key> keys;
+    std::vector<contract_member> members;
+    for(int i = 0; i < 3; i++){
+        keys.push_back(bls_keygen());
+        members.push_back(contract_member{"user" + std::to_string(i), keys[i].pub, bls_prove(keys[i])});
+    }
+    SecureContract c("share reports", members);
+    for(size_t i = 0; i < keys.size(); i++){
+        G1 sig = bls_sign(keys[i], c.Message());
+        check(c.VerifyShare(i, sig), "share verifies");
+        c.Add(i, sig);
+    }
+    check(c.Complete() && c.Verify(), "complete contract verifies");
+    check(throws([&]{ c.Add(0, bls_sign(keys[0], c.Message())); }), "second signature from a member rejected");
+
+    SecureContract copy("share reports", members);
+    copy.SetSignature(c.Signature(), std::vector<bool>(members.size(), true));
+    check(copy.Verify(), "published aggregate verifies");
+    check(throws([&]{ copy.SetSignature("not hex", std::vector<bool>(members.size(), true)); }), "malformed aggregate rejected");
+    copy.SetSignature(c.Signature(), {true, true, false});
+    check(!copy.Verify(), "aggregate is bound to its signers");
+
+    auto bad = members;
+    bad[1].pop = bls_prove(keys[2]);
+    check(throws([&]{ SecureContract("share reports", bad); }), "bad proof of possession rejected");
+}
+
+auto test_batch() -> void{
+    std::vector<bls_key> keys;
+    for(int i = 0; i < 5; i++){
+        keys.push_back(bls_keygen());
+    }
+    BatchVerifier batch;
+    std::vector<size_t> want;
+    for(size_t i = 0; i < 40; i++){
+        const bls_key& k = keys[i % keys.size()];
+        std::string msg = "report " + std::to_string(i);
+        G1 sig = bls_sign(k, msg);
+        if(i == 3 || i == 17){
+            // Signed by someone else
+            sig = bls_sign(keys[(i + 1) % keys.size()], msg);
+            want.push_back(i);
+        }else if(i == 18){
+            // Signed for another message
+            sig = bls_sign(k, "report 0");
+            want.push_back(i);
+        }else if(i == 30){
+            sig.clear();
+            want.push_back(i);
+        }
+        batch.Add(k.pub, msg, sig);
+    }
+    check(batch.Verify() == want, "bisecting finds exactly the bad signatures");
+
+    // Two bad signatures that cancel in an unweighted sum
+    BatchVerifier pair;
+    G1 a = bls_sign(keys[0], "a"), b = bls_sign(keys[0], "b"), shift = bls_sign(keys[1], "x");
+    G1::add(a, a, shift);
+    G1::sub(b, b, shift);
+    pair.Add(keys[0].pub, "a", a);
+    pair.Add(keys[0].pub, "b", b);
+    check(pair.Verify() == std::vector<size_t>({0, 1}), "errors can not cancel");
+
+    BatchVerifier good;
+    for(int i = 0; i < 8; i++){
+        good.Add(keys[i % 2].pub, std::to_string(i), bls_sign(keys[i % 2], std::to_string(i)));
+    }
+    check(good.Verify().empty(), "good batch verifies");
+}
+
+auto main() -> int{
+    initPairing(mcl::BLS12_381);
+    test_sign();
+    test_aggregate();
+    test_contract();
+    test_batch();
+    return finish();
+}
+#else
+auto main() -> int{
+    std::cout << "skipped" << std::endl;
+    return 0;
+}
+#endif
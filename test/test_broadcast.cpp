@@ -0,0 +1,76 @@
+// Checks on broadcast encryption to many identities.
+//
+//   test_broadcast
+#include <thread>
+#include <iostream>
+#include <secovid/pkg.hpp>
+#include "check.hpp"
+
+G1 generator;
+
+auto key_of(PKG& root, const std::string& id) -> id_pri_key{
+    return root.extract(const_cast<char*>(id.c_str()));
+}
+
+auto test_round_trip(PKG& root) -> void{
+    Broadcaster b(root.m_pub);
+    broadcast_ciphertext c = broadcast_deserialize(broadcast_serialize(b.Encrypt({"alice", "bob"}, "exposure notice")));
+
+    std::string msg;
+    check(broadcast_decrypt(key_of(root, "bob"), c, msg) && msg == "exposure notice", "recipient opens the broadcast");
+    check(!broadcast_decrypt(key_of(root, "carol"), c, msg), "non-recipient can not open it");
+
+    std::string cdata = broadcast_serialize(c);
+    bool threw = false;
+    try{
+        broadcast_deserialize(cdata.substr(0, cdata.size() / 2));
+    }catch(const std::exception&){
+        threw = true;
+    }
+    check(threw, "truncated broadcast rejected");
+}
+
+auto test_cache(PKG& root) -> void{
+    Broadcaster b(root.m_pub, nullptr, 2);
+    b.Encrypt({"alice", "bob", "carol"}, "a");
+    check(b.Cached() == 2, "cache holds at most max_cached identities");
+    broadcast_ciphertext c = b.Encrypt({"alice"}, "b");
+    std::string msg;
+    check(broadcast_decrypt(key_of(root, "alice"), c, msg) && msg == "b", "evicted identity is paired again");
+}
+
+auto test_threads(PKG& root) -> void{
+    Broadcaster b(root.m_pub, nullptr, 16);
+    std::vector<std::thread> senders;
+    std::vector<broadcast_ciphertext> sent(4);
+    for(int t = 0; t < 4; t++){
+        senders.emplace_back([&, t]{
+            for(int i = 0; i < 50; i++){
+                std::vector<std::string> ids;
+                for(int k = 0; k < 8; k++){
+                    ids.push_back("user" + std::to_string((t * 7 + i * 3 + k) % 40));
+                }
+                sent[t] = b.Encrypt(ids, "from " + std::to_string(t));
+            }
+        });
+    }
+    for(auto& t : senders){
+        t.join();
+    }
+    // The last broadcast of sender t went to users (t * 7 + 147 + k) % 40
+    bool ok = b.Cached() <= 16;
+    for(int t = 0; t < 4; t++){
+        std::string msg;
+        ok = ok && broadcast_decrypt(key_of(root, "user" + std::to_string((t * 7 + 147) % 40)), sent[t], msg)
+            && msg == "from " + std::to_string(t);
+    }
+    check(ok, "senders share a broadcaster");
+}
+
+auto main() -> int{
+    PKG root;
+    test_round_trip(root);
+    test_cache(root);
+    test_threads(root);
+    return finish();
+}
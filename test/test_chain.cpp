@@ -0,0 +1,57 @@
+// Checks on exposure chains through people met more than once.
+//
+//   test_chain
+#include <iostream>
+#include <secovid/chain.hpp>
+#include "graph_gen.hpp"
+#include "check.hpp"
+
+typedef std::vector<std::string> chain;
+
+// A meets B at 10, who met C at 5; then A meets C at 100, who met D at
+// 50. C sits on a vertex per meeting.
+auto repeat_contacts() -> Contact{
+    contact_data b;
+    b.uid = "B";
+    b.uv = {{0, "B"}, {1, "C"}};
+    b.vu = {{"B", 0}, {"C", 1}};
+    b.graph = {{1}, {0}};
+    b.times = {{{5, 5}}, {{5, 5}}};
+    contact_data c = b;
+    c.uid = "C";
+    c.uv = {{0, "C"}, {1, "D"}};
+    c.vu = {{"C", 0}, {"D", 1}};
+    c.times = {{{50, 50}}, {{50, 50}}};
+
+    Contact a("A");
+    a.AddContact("B", b, contact_interval{10, 10});
+    a.AddContact("C", c, contact_interval{100, 100});
+    return a;
+}
+
+auto main() -> int{
+    Contact a = repeat_contacts();
+    check(a.Vertices("C").size() == 2, "C has a vertex per meeting");
+    check(exposure_chain(a, "B", "D") == chain({"B", "C", "D"}), "chain carries on from C's other meeting");
+    check(exposure_chain(a, "D", "B", 0).empty(), "D met C after C met B");
+    check(exposure_chain(a, "A", "C") == chain({"A", "C"}), "fewest hops to any meeting");
+    check(exposure_chain(a, "B", "D", 6).empty(), "nothing after the contact is over");
+    check(exposure_chain(a, "B", "nobody").empty() && exposure_chain(a, "nobody", "B").empty(), "unknown users have no chain");
+
+    // Built once for many queries
+    graph_gen_params p;
+    p.vertices = 5000;
+    p.edges = 20000;
+    contact_data d = to_contact_data(generate_contacts(p));
+    Contact c("ME");
+    c.AddContact(d.uid, d);
+    csr_graph g = to_csr(c);
+    std::vector<int> copies = contact_copies(c);
+    bool same = true;
+    for(int v = 1; v < 50; v++){
+        std::string to = c.UID(v);
+        same = same && exposure_chain(c, g, copies, "ME", to) == exposure_chain(c, "ME", to);
+    }
+    check(same, "prebuilt graph gives the same chains");
+    return finish();
+}
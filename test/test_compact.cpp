@@ -0,0 +1,65 @@
+// Checks that compact contact_data decodes to the graph it was made from.
+//
+//   test_compact
+#include <set>
+#include <tuple>
+#include <iostream>
+#include <secovid/compact.hpp>
+#include "graph_gen.hpp"
+#include "check.hpp"
+
+// Rows as multisets of (neighbour, begin, end), as the format sorts them
+auto same_graph(const contact_data& a, const contact_data& b) -> bool{
+    if(a.graph.size() != b.graph.size() || a.uv != b.uv || a.vu != b.vu || a.uid != b.uid || a.version != b.version){
+        return false;
+    }
+    typedef std::tuple<int, uint32_t, uint32_t> entry;
+    for(int u = 0; u < (int) a.graph.size(); u++){
+        std::multiset<entry> x, y;
+        for(int i = 0; i < (int) a.graph[u].size(); i++){
+            x.insert(entry(a.graph[u][i], edge_time(a, u, i).begin, edge_time(a, u, i).end));
+        }
+        for(int i = 0; i < (int) b.graph[u].size(); i++){
+            y.insert(entry(b.graph[u][i], edge_time(b, u, i).begin, edge_time(b, u, i).end));
+        }
+        if(x != y){
+            return false;
+        }
+    }
+    return true;
+}
+
+auto round_trip(const contact_data& d, const std::string& what) -> void{
+    contact_data back;
+    bool ok = !throws([&]{ back = compact_decode(compact_encode(d)); });
+    check(ok && same_graph(d, back), what + " round trips");
+}
+
+auto main() -> int{
+    round_trip(contact_data(), "empty graph");
+
+    contact_data d;
+    d.uid = "ALICE";
+    d.version = 7;
+    d.uv = {{0, "ALICE"}, {1, std::string(64, 'a')}, {3, "not hex"}};
+    d.vu = {{"ALICE", 0}, {std::string(64, 'a'), 1}, {"not hex", 3}};
+    // 0 - 1 at [100, 160], 1 - 3 at [50, 50], a self-loop on 2 at [70, 80]
+    d.graph = {{1}, {0, 3}, {2, 2}, {1}};
+    d.times = {{{100, 160}}, {{100, 160}, {50, 50}}, {{70, 80}, {70, 80}}, {{50, 50}}};
+    round_trip(d, "timed graph with a self-loop");
+
+    // From a peer that predates edge times
+    contact_data untimed = d;
+    untimed.times.clear();
+    round_trip(untimed, "untimed graph");
+
+    graph_gen_params p;
+    p.vertices = 2000;
+    p.edges = 20000;
+    round_trip(to_contact_data(generate_contacts(p)), "generated graph");
+
+    std::string cdata = compact_encode(d);
+    check(throws([&]{ compact_decode(cdata.substr(0, cdata.size() - 1)); }), "truncated data rejected");
+    check(throws([&]{ compact_decode("X" + cdata.substr(1)); }), "wrong magic rejected");
+    return finish();
+}
@@ -0,0 +1,116 @@
+// Stress test of ConcurrentContact: writer threads merge overlapping
+// uploads of one graph while reader threads check every snapshot they
+// see, then the result is compared with the graph.
+//
+//   test_concurrent_contact [writers] [readers] [edges]
+#include <set>
+#include <tuple>
+#include <thread>
+#include <random>
+#include <iostream>
+#include <secovid/concurrent_contact.hpp>
+#include "graph_gen.hpp"
+#include "check.hpp"
+
+// A reader's view must hang together while writers run
+auto read_loop(const ConcurrentContact& c, std::atomic<bool>& done, uint64_t seed) -> uint64_t{
+    std::mt19937_64 gen(seed);
+    uint64_t reads = 0;
+    while(!done.load()){
+        ConcurrentContact::Reader r(c);
+        uint64_t n = r.Vertices();
+        for(int q = 0; q < 100 && n > 0; q++, reads++){
+            // Global ids interleave shards, so not every id below n exists
+            uint32_t v = static_cast<uint32_t>(gen() % (n * 2));
+            if(!r.Has(v)){
+                continue;
+            }
+            std::string uid = r.UID(v);
+            if(uid.empty() || r.Vertex(uid) != v){
+                check(false, "uid of a published vertex maps back to it");
+                return reads;
+            }
+            if(r.Neighbours(v).size() != r.Times(v).size()){
+                check(false, "rows have a time per neighbour");
+                return reads;
+            }
+        }
+    }
+    return reads;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    int writers = argc > 1 ? std::stoi(argv[1]) : 4;
+    int readers = argc > 2 ? std::stoi(argv[2]) : 2;
+    graph_gen_params p;
+    p.edges = argc > 3 ? std::stoull(argv[3]) : 50000;
+    p.vertices = static_cast<uint32_t>(p.edges / 8);
+    generated_graph g = generate_contacts(p);
+    // Half of every upload is repeated by the one before it
+    auto uploads = to_uploads(g, 500, 250);
+
+    ConcurrentContact c(8);
+    std::atomic<bool> done{false};
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> reads{0};
+    for(int i = 0; i < readers; i++){
+        threads.emplace_back([&, i]{ reads += read_loop(c, done, i); });
+    }
+    std::vector<std::thread> writing;
+    for(int i = 0; i < writers; i++){
+        writing.emplace_back([&]{
+            for(size_t k; (k = next++) < uploads.size(); ){
+                c.Merge(uploads[k]);
+            }
+        });
+    }
+    for(auto& t : writing){
+        t.join();
+    }
+    // Everything again, which must add nothing
+    next = 0;
+    writing.clear();
+    for(int i = 0; i < writers; i++){
+        writing.emplace_back([&]{
+            for(size_t k; (k = next++) < uploads.size(); ){
+                c.Merge(uploads[k]);
+            }
+        });
+    }
+    for(auto& t : writing){
+        t.join();
+    }
+    done = true;
+    for(auto& t : threads){
+        t.join();
+    }
+
+    // Every edge of the graph once in each direction, nothing else
+    typedef std::tuple<std::string, uint32_t, uint32_t> entry;
+    std::map<std::string, std::set<entry>> want;
+    for(auto& e : g.edges){
+        want[generated_uid(e.u)].insert(entry(generated_uid(e.v), e.t.begin, e.t.end));
+        want[generated_uid(e.v)].insert(entry(generated_uid(e.u), e.t.begin, e.t.end));
+    }
+    ConcurrentContact::Reader r(c);
+    check(r.Vertices() == want.size(), "one vertex per uid");
+    bool rows = true;
+    for(auto& x : want){
+        int64_t v = r.Vertex(x.first);
+        if(v < 0){
+            rows = false;
+            continue;
+        }
+        auto& adj = r.Neighbours(static_cast<uint32_t>(v));
+        auto& times = r.Times(static_cast<uint32_t>(v));
+        std::set<entry> got;
+        for(size_t i = 0; i < adj.size(); i++){
+            got.insert(entry(r.UID(adj[i]), times[i].begin, times[i].end));
+        }
+        rows = rows && got == x.second && adj.size() == x.second.size();
+    }
+    check(rows, "rows hold every edge once");
+    std::cout << "reads " << reads << std::endl;
+    return finish();
+}
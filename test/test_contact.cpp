@@ -0,0 +1,144 @@
+// Checks on Contact graphs merged from peers.
+//
+//   test_contact
+#include <iostream>
+#include <secovid/temporal.hpp>
+#include "graph_gen.hpp"
+#include "check.hpp"
+
+// Peer B met C at 5, D at 30, and C met D at 40
+auto peer() -> contact_data{
+    contact_data d;
+    d.uid = "B";
+    d.uv = {{0, "B"}, {1, "C"}, {2, "D"}};
+    d.vu = {{"B", 0}, {"C", 1}, {"D", 2}};
+    d.graph = {{1, 2}, {0, 2}, {1, 0}};
+    d.times = {{{5, 5}, {30, 30}}, {{5, 5}, {40, 40}}, {{40, 40}, {30, 30}}};
+    return d;
+}
+
+auto test_merged_exposure() -> void{
+    Contact a("A");
+    a.AddContact("B", peer(), contact_interval{10, 20});
+    auto exposed = exposed_contacts(a, "A", 0);
+    check(exposed.size() == 3, "A exposes B, C and D");
+    check(exposed["B"] == 10, "B exposed at 10");
+    // Through B - D at 30, which is not on a DFS tree of B's graph
+    check(exposed.count("D") && exposed["D"] == 30, "D exposed at 30");
+    check(exposed.count("C") && exposed["C"] == 40, "C exposed at 40 through D");
+}
+
+// A meets B at 10, who met C at 5; then A meets C at 100, who met D at
+// 50. C and D sit on a vertex per meeting.
+auto test_repeat_contacts() -> void{
+    contact_data b;
+    b.uid = "B";
+    b.uv = {{0, "B"}, {1, "C"}};
+    b.vu = {{"B", 0}, {"C", 1}};
+    b.graph = {{1}, {0}};
+    b.times = {{{5, 5}}, {{5, 5}}};
+    contact_data c = b;
+    c.uid = "C";
+    c.uv = {{0, "C"}, {1, "D"}};
+    c.vu = {{"C", 0}, {"D", 1}};
+    c.times = {{{50, 50}}, {{50, 50}}};
+
+    Contact a("A");
+    a.AddContact("B", b, contact_interval{10, 10});
+    a.AddContact("C", c, contact_interval{100, 100});
+    check(a.Vertices("C").size() == 2, "C has a vertex per meeting");
+    auto exposed = exposed_contacts(a, "B", 0);
+    check(exposed.count("C") && exposed["C"] == 5, "C exposed at the earliest meeting");
+    check(exposed.count("D") && exposed["D"] == 50, "D exposed through C's other meeting");
+    check(exposed.count("A") && exposed["A"] == 10, "A exposed at 10");
+    exposed = exposed_contacts(a, "C", 0);
+    check(exposed.count("B") && exposed["B"] == 5 && exposed.count("D") && exposed["D"] == 50, "every vertex of the source spreads");
+}
+
+auto test_components() -> void{
+    Contact a("A");
+    a.AddContact("B", peer(), contact_interval{10, 20});
+    const Clusters& k = a.Components();
+    int b = a.Vertex("B"), d = a.Vertex("D");
+    check(k.Connected(0, b) && k.Connected(b, d) && k.Size(0) == 4, "A, B, C and D form one cluster");
+    check(k.Count() == 1 && k.Largest(2).size() == 1 && k.Largest(1)[0].second == 4, "one cluster of four");
+
+    Clusters c;
+    c.Union(0, 1);
+    check(c.Find(1000) == Clusters::absent && c.Size(1000) == 0, "untouched vertex is not present");
+    check(!c.Connected(1000, 1000) && !c.Connected(0, 1000), "untouched vertex is connected to nothing");
+    check(c.Size(0) == 2 && c.Count() == 1, "queries do not grow the clusters");
+    c.Union(5, 1);
+    check(c.Size(5) == 3 && c.Connected(0, 5) && !c.Connected(0, 4), "union reaches past the old end");
+
+    // A user met twice sits on two vertices, both counted
+    Contact r("A");
+    contact_data e;
+    e.uid = "E";
+    e.uv = {{0, "E"}};
+    e.vu = {{"E", 0}};
+    e.graph = {{}};
+    r.AddContact("E", e);
+    r.AddContact("E", e);
+    check(r.Vertices("E").size() == 2 && r.Components().Size(0) == 3, "sizes count vertex copies");
+}
+
+auto test_merge_keeps_every_edge() -> void{
+    graph_gen_params p;
+    p.vertices = 1000;
+    p.edges = 10000;
+    contact_data d = to_contact_data(generate_contacts(p));
+    uint64_t in = 0;
+    for(auto& adj : d.graph){
+        in += adj.size();
+    }
+    Contact c("T");
+    c.AddContact(d.uid, d);
+    uint64_t out = 0;
+    for(auto& adj : c.Graph()){
+        out += adj.size();
+    }
+    // Each edge twice, plus the edge to the peer
+    check(out == in + 2, "every edge of a peer graph is merged");
+}
+
+auto test_payload_layouts() -> void{
+    Contact c("A");
+    c.AddContact("B", peer(), contact_interval{10, 20});
+    contact_data now = c.Deserialize(c.Serialize());
+    check(now.graph == c.Graph() && now.version == c.Version(), "versioned payload round trips");
+    check(now.times.size() == now.graph.size(), "versioned payload keeps edge times");
+
+    // As sent before edge times and versions
+    unversioned_contact_data old{peer()};
+    std::stringstream ss;
+    {
+        cereal::PortableBinaryOutputArchive oarchive(ss);
+        oarchive(old);
+    }
+    contact_data rez = c.Deserialize(ss.str());
+    check(rez.graph == old.d.graph && rez.uv == old.d.uv && rez.uid == "B", "unversioned payload loads");
+    check(rez.times.empty() && edge_time(rez, 0, 0).end == UINT32_MAX, "unversioned edges are always in contact");
+}
+
+auto test_delta_rename() -> void{
+    contact_data g = peer();
+    g.version = 1;
+    contact_delta d;
+    d.from = 1;
+    d.to = 2;
+    d.uid = "B";
+    d.uv[1] = "E";
+    check(apply_delta(g, d), "delta applies");
+    check(g.vu.count("C") == 0 && g.vu["E"] == 1 && g.uv[1] == "E", "renamed vertex loses its old name");
+}
+
+auto main() -> int{
+    test_merged_exposure();
+    test_repeat_contacts();
+    test_components();
+    test_merge_keeps_every_edge();
+    test_payload_layouts();
+    test_delta_rename();
+    return finish();
+}
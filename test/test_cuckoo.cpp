@@ -0,0 +1,53 @@
+// Checks on contact_filter sketches.
+//
+//   test_cuckoo
+#include <iostream>
+#include <secovid/cuckoo.hpp>
+#include "graph_gen.hpp"
+#include "check.hpp"
+
+// A user met many times sits on a vertex per meeting
+auto test_repeat_contacts() -> void{
+    contact_data e;
+    e.uid = "E";
+    e.uv = {{0, "E"}, {1, "F"}};
+    e.vu = {{"E", 0}, {"F", 1}};
+    e.graph = {{1}, {0}};
+    Contact a("A");
+    for(int i = 0; i < 40; i++){
+        a.AddContact("E", e);
+    }
+    check(a.Vertices("E").size() == 40, "E has a vertex per meeting");
+
+    CuckooFilter f;
+    bool built = !throws([&]{ f = contact_filter(a); });
+    check(built && f.Count() == 3, "each user is inserted once");
+    check(f.Contains("A") && f.Contains("E") && f.Contains("F"), "every user is found");
+}
+
+auto test_no_false_negatives() -> void{
+    graph_gen_params p;
+    p.vertices = 20000;
+    p.edges = 60000;
+    contact_data d = to_contact_data(generate_contacts(p));
+    Contact c("ME");
+    c.AddContact(d.uid, d);
+    CuckooFilter f = CuckooFilter::Deserialize(contact_filter(c).Serialize());
+    bool all = true;
+    for(int v = 0; v < (int) c.Graph().size(); v++){
+        all = all && (c.UID(v).empty() || f.Contains(c.UID(v)));
+    }
+    check(all && f.Contains("ME") && f.Contains(d.uid), "no false negatives after a round trip");
+
+    int wrong = 0;
+    for(int i = 0; i < 100000; i++){
+        wrong += f.Contains("stranger" + std::to_string(i));
+    }
+    check(wrong < 1000, "false positives stay under 1%");
+}
+
+auto main() -> int{
+    test_repeat_contacts();
+    test_no_false_negatives();
+    return finish();
+}
@@ -0,0 +1,39 @@
+// Checks that EphemeralPool refills between bursts, not during them.
+//
+//   test_ephemeral
+#include <iostream>
+#include <secovid/pkg.hpp>
+#include "check.hpp"
+
+G1 generator;
+
+auto main() -> int{
+    PKG root;
+    const size_t capacity = 1000;
+    EphemeralPool pool(capacity, std::chrono::milliseconds(100));
+    pool.Fill();
+    check(pool.Size() == capacity, "fill tops up the pool");
+    pool.Start();
+
+    // A burst slower than the pool could refill, with no gap as long as
+    // the quiet period
+    bool pairs = true;
+    for(int i = 0; i < 600; i++){
+        ephemeral e = pool.Take();
+        G1 rp;
+        G1::mul(rp, generator, e.r);
+        pairs = pairs && rp == e.rp;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    check(pairs, "pairs are (r, rP)");
+    check(pool.Size() == capacity - 600, "no refill during a burst");
+
+    auto begin = std::chrono::steady_clock::now();
+    while(pool.Size() < capacity && std::chrono::steady_clock::now() - begin < std::chrono::seconds(30)){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    check(pool.Size() == capacity, "refilled once the burst is over");
+    check(std::chrono::steady_clock::now() - begin >= std::chrono::milliseconds(50), "refill waits for the quiet period");
+
+    return finish();
+}
@@ -0,0 +1,139 @@
+// Checks on the published binary fuse filters.
+//
+//   test_filter
+#include <random>
+#include <iostream>
+#include <secovid/fuse.hpp>
+#include "check.hpp"
+
+// Fields of a BinaryFuseFilter as serialized, to forge bad ones
+struct raw_filter{
+    uint64_t seed;
+    uint32_t segment_length;
+    uint32_t segment_count_length;
+    std::vector<uint16_t> fingerprints;
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(seed, segment_length, segment_count_length, fingerprints);
+    }
+};
+
+auto random_tokens(std::mt19937_64& gen, size_t n) -> std::vector<rolling_token>{
+    std::vector<rolling_token> v(n);
+    for(auto& t : v){
+        t = rolling_token{gen(), gen()};
+    }
+    return v;
+}
+
+auto has_all(const DailyFilter<>& f, const std::vector<rolling_token>& tokens) -> bool{
+    for(auto& t : tokens){
+        if(!f.Contains(t)){
+            return false;
+        }
+    }
+    return true;
+}
+
+auto test_no_false_negatives() -> void{
+    std::mt19937_64 gen(1);
+    for(size_t n : {1, 2, 100, 100000}){
+        auto tokens = random_tokens(gen, n);
+        std::vector<uint64_t> keys;
+        for(auto& t : tokens){
+            keys.push_back(token_key(t));
+        }
+        keys.push_back(keys[0]); // Keys may repeat
+        BinaryFuse8 f8(keys);
+        BinaryFuse16 f16(keys);
+        bool all = true;
+        for(auto& t : tokens){
+            all = all && f8.Contains(t) && f16.Contains(t);
+        }
+        check(all, "no false negatives over " + std::to_string(n) + " keys");
+    }
+    check(!BinaryFuse16(std::vector<uint64_t>()).Contains(uint64_t(5)), "empty filter holds nothing");
+}
+
+auto test_round_trip() -> void{
+    std::mt19937_64 gen(2);
+    std::vector<std::vector<rolling_token>> hours;
+    DailyFilter<> coordinator(18500), client;
+    for(int h = 0; h < 3; h++){
+        hours.push_back(random_tokens(gen, 1000));
+        coordinator.Append(hours.back());
+    }
+    client.Apply(coordinator.Serialize(client.Cursor()));
+    hours.push_back(random_tokens(gen, 1000));
+    coordinator.Append(hours.back());
+    client.Apply(coordinator.Serialize(client.Cursor()));
+    bool all = client.Day() == 18500 && client.Batches() == 4;
+    for(auto& h : hours){
+        all = all && has_all(client, h);
+    }
+    check(all, "client follows the batches");
+    check(throws([&]{ client.Apply(coordinator.Serialize(2)); }), "batches that do not follow on are rejected");
+    check(throws([&]{ client.Compact(); }) && client.Batches() == 4, "client can not compact");
+
+    coordinator.Compact();
+    check(coordinator.Batches() == 1 && coordinator.Compacted(), "coordinator compacts");
+    check(throws([&]{ coordinator.Append(hours[0]); }), "compacted day takes no more batches");
+
+    client.Apply(coordinator.Serialize(client.Cursor()));
+    all = client.Batches() == 1 && client.Compacted();
+    for(auto& h : hours){
+        all = all && has_all(client, h);
+    }
+    check(all, "compacted day replaces the client's batches");
+    client.Apply(coordinator.Serialize(client.Cursor()));
+    check(client.Batches() == 1 && client.Cursor() == DailyFilter<>::COMPACTED, "nothing more once compacted");
+
+    DailyFilter<> late;
+    late.Apply(coordinator.Serialize(late.Cursor()));
+    check(late.Compacted() && late.Day() == 18500 && has_all(late, hours[2]), "new client gets the compacted day");
+    DailyFilter<> other(18501);
+    other.Append(hours[0]);
+    check(throws([&]{ other.Apply(coordinator.Serialize(0)); }), "another day is rejected");
+}
+
+// An update carrying a single forged batch
+auto forged(const raw_filter& f) -> std::string{
+    std::stringstream ss;
+    {
+        cereal::PortableBinaryOutputArchive oarchive(ss);
+        uint32_t day = 18500;
+        bool whole = false;
+        uint64_t from = 0;
+        std::vector<raw_filter> rest{f};
+        oarchive(day, whole, from, rest);
+    }
+    return ss.str();
+}
+
+auto test_malformed() -> void{
+    raw_filter good{1, 4, 4, std::vector<uint16_t>(12, 0)};
+    DailyFilter<> f;
+    f.Apply(forged(good));
+    check(f.Batches() == 1, "well formed batch applies");
+
+    raw_filter bad = good;
+    bad.segment_length = 3;
+    check(throws([&]{ DailyFilter<>().Apply(forged(bad)); }), "segment length not a power of two rejected");
+    bad = good;
+    bad.segment_length = 0;
+    check(throws([&]{ DailyFilter<>().Apply(forged(bad)); }), "zero segment length rejected");
+    bad = good;
+    bad.fingerprints.resize(11);
+    check(throws([&]{ DailyFilter<>().Apply(forged(bad)); }), "short fingerprints rejected");
+    bad = good;
+    bad.segment_count_length = 1u << 31;
+    check(throws([&]{ f.Apply(forged(bad)); }) && f.Batches() == 1, "bad batch leaves the filter unchanged");
+}
+
+auto main() -> int{
+    test_no_false_negatives();
+    test_round_trip();
+    test_malformed();
+    return finish();
+}
@@ -0,0 +1,69 @@
+// Checks on GenerationalContacts expiry, id reuse and compaction.
+//
+//   test_generations
+#include <iostream>
+#include <secovid/generations.hpp>
+#include "check.hpp"
+
+const uint32_t DAY = 86400;
+
+auto test_expiry() -> void{
+    GenerationalContacts g(DAY, 14);
+    uint32_t t0 = 100 * DAY;
+    g.Add("A", "B", contact_interval{t0, t0 + 60});
+    g.Add("B", "C", contact_interval{t0 + 5 * DAY, t0 + 5 * DAY + 60});
+    g.Compact();
+    {
+        GenerationalContacts::Reader r(g);
+        check(r.Graph().Vertices() == 3 && r.Graph().edges.size() == 4, "both edges readable");
+        check(r.Vertex("A") >= 0 && r.UID(r.Vertex("A")) == "A", "uids readable");
+    }
+
+    check(g.Expire(t0 + 15 * DAY) == 1, "first day expires after the window");
+    check(g.Vertices() == 2, "A freed with its last edge");
+    g.Compact();
+    {
+        GenerationalContacts::Reader r(g);
+        check(r.Vertex("A") == -1, "expired uid gone from the view");
+        check(r.Graph().edges.size() == 2, "expired edge gone from the view");
+    }
+
+    // D takes the freed id
+    g.Add("D", "E", contact_interval{t0 + 6 * DAY, t0 + 6 * DAY});
+    g.Compact();
+    {
+        GenerationalContacts::Reader r(g);
+        check(r.Graph().Vertices() == 4, "freed ids are reused first");
+        check(r.UID(r.Vertex("D")) == "D" && r.UID(r.Vertex("E")) == "E", "reused ids renamed in the view");
+    }
+}
+
+auto test_shrink() -> void{
+    GenerationalContacts g(DAY, 1);
+    uint32_t t0 = 100 * DAY;
+    g.Add("keep", "also", contact_interval{t0 + 10 * DAY, t0 + 10 * DAY});
+    for(int i = 0; i < 10000; i++){
+        g.Add("old" + std::to_string(i), "older" + std::to_string(i), contact_interval{t0, t0});
+    }
+    g.Expire(t0 + 5 * DAY);
+    g.Compact();
+    GenerationalContacts::Reader r(g);
+    check(g.Vertices() == 2, "expired vertices freed");
+    check(r.Graph().Vertices() == 2, "id space shrinks back");
+    check(r.Vertex("old5") == -1 && r.Vertex("keep") >= 0, "index follows the shrink");
+}
+
+auto test_untimed() -> void{
+    GenerationalContacts g(DAY, 2);
+    uint32_t now = now_interval().end;
+    g.Add("A", "B", contact_interval{0, UINT32_MAX});
+    check(g.Expire(now) == 0, "untimed edge kept within the window");
+    check(g.Expire(now + 4 * DAY) == 1, "untimed edge expires a window after it was added");
+}
+
+auto main() -> int{
+    test_expiry();
+    test_shrink();
+    test_untimed();
+    return finish();
+}
@@ -0,0 +1,73 @@
+// Round trips contact graphs through snapshot files and GraphView.
+//
+//   test_graph_view [dir]
+#include <cstdio>
+#include <iostream>
+#include <iterator>
+#include <secovid/graph_view.hpp>
+#include "graph_gen.hpp"
+#include "check.hpp"
+
+auto read_file(const std::string& path) -> std::string{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+auto test_round_trip(const std::string& path) -> void{
+    graph_gen_params p;
+    p.vertices = 2000;
+    p.edges = 20000;
+    contact_data d = to_contact_data(generate_contacts(p));
+    d.version = 42;
+    d.graph.resize(d.graph.size() + 3); // Unnamed vertices without edges
+    d.times.resize(d.graph.size());
+
+    check(write_graph_snapshot(d, path), "snapshot written");
+    check(read_file(path) == graph_snapshot(d), "file matches the in-memory snapshot");
+
+    GraphView view;
+    view.Open(path);
+    check(view.Version() == 42, "version kept");
+    check(view.Vertices() == d.graph.size(), "vertex count kept");
+    bool rows = true, times = true, uids = true;
+    for(uint32_t u = 0; u < view.Vertices(); u++){
+        auto n = view.Neighbours(u);
+        auto t = view.Times(u);
+        rows = rows && std::vector<int>(n.begin(), n.end()) == d.graph[u];
+        for(size_t i = 0; i < t.size(); i++){
+            auto want = edge_time(d, u, static_cast<int>(i));
+            times = times && t[i].begin == want.begin && t[i].end == want.end;
+        }
+        auto it = d.uv.find(static_cast<int>(u));
+        if(it != d.uv.end()){
+            uids = uids && view.UID(u) == it->second && view.Vertex(it->second) == u;
+        }
+    }
+    check(rows, "rows kept");
+    check(times, "edge times kept");
+    check(uids, "uids found both ways");
+    check(view.Vertex("") == -1, "empty uid matches no vertex");
+    check(view.Vertex("no such uid") == -1, "unknown uid matches no vertex");
+}
+
+auto test_truncated(const std::string& path) -> void{
+    contact_data d = to_contact_data(generate_contacts(graph_gen_params()));
+    std::string buf = graph_snapshot(d);
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(buf.data(), buf.size() / 2);
+    bool threw = false;
+    try{
+        GraphView view;
+        view.Open(path);
+    }catch(const std::runtime_error&){
+        threw = true;
+    }
+    check(threw, "truncated snapshot rejected");
+}
+
+auto main(int argc, char* argv[]) -> int{
+    std::string path = std::string(argc > 1 ? argv[1] : "/tmp") + "/test_graph_view.kg";
+    test_round_trip(path);
+    test_truncated(path);
+    std::remove(path.c_str());
+    return finish();
+}
@@ -0,0 +1,96 @@
+// Checks that a GroupTree member rejects bad commits without changing.
+//
+//   test_group
+#include <iostream>
+#include <secovid/group.hpp>
+#include "check.hpp"
+
+auto same_state(const group_state& a, const group_state& b) -> bool{
+    return a.epoch == b.epoch && a.width == b.width && a.filled == b.filled && a.pubs == b.pubs;
+}
+
+// Applies a bad commit to m, which must throw and leave m as it was
+auto rejected(GroupTree& m, const group_commit& bad, const std::string& what) -> void{
+    tree_key key = m.Key();
+    group_state state = m.State();
+    uint64_t epoch = m.Epoch();
+    bool threw = false;
+    try{
+        m.Apply(bad);
+    }catch(const std::runtime_error&){
+        threw = true;
+    }
+    check(threw, what + " is rejected");
+    check(m.Key() == key && m.Epoch() == epoch && same_state(m.State(), state), what + " leaves the member unchanged");
+}
+
+auto main() -> int{
+    const int n = 8;
+    std::vector<tree_key> leaves(n), pubs(n);
+    for(int i = 0; i < n; i++){
+        tree_random(leaves[i]);
+        pubs[i] = tree_public(leaves[i]);
+    }
+    GroupTree creator(leaves[0]);
+    group_commit c = creator.Commit(std::vector<tree_key>(pubs.begin() + 1, pubs.end()));
+    GroupTree member(creator.State(), 5, leaves[5]);
+    member.Join(c);
+    check(member.Key() == creator.Key(), "member joins");
+
+    // An outsider who sees the public state takes over leaf 2
+    group_state fake = member.State();
+    tree_key stolen;
+    tree_random(stolen);
+    fake.pubs[2 * 2] = tree_public(stolen);
+    GroupTree outsider(fake, 2, stolen);
+    rejected(member, outsider.Commit(), "outsider's commit");
+    rejected(member, outsider.Commit({}, {1}), "outsider's remove");
+
+    // A new member given a tree other than the sender's
+    tree_key late;
+    tree_random(late);
+    group_commit add = creator.Commit({tree_public(late)});
+    group_state wrong = creator.State();
+    wrong.pubs[2 * 1] = tree_public(stolen);
+    GroupTree misled(wrong, 8, late);
+    check(throws([&]{ misled.Join(add); }), "join into a different tree is rejected");
+    GroupTree newcomer(creator.State(), 8, late);
+    newcomer.Join(add);
+    member.Apply(add);
+    check(newcomer.Key() == creator.Key() && member.Key() == creator.Key(), "member added after the outsider's tries");
+
+    // A remove changes the tree before the path is checked
+    tree_key joiner;
+    tree_random(joiner);
+    c = creator.Commit({tree_public(joiner)}, {3});
+
+    group_commit bad = c;
+    for(auto& node : bad.path){
+        for(auto& s : node.sealed){
+            s.box[0] ^= 1;
+        }
+    }
+    rejected(member, bad, "commit with a broken seal");
+
+    bad = c;
+    bad.path.back().pub.bytes[0] ^= 1;
+    rejected(member, bad, "commit with a wrong path key");
+
+    bad = c;
+    bad.path.pop_back();
+    rejected(member, bad, "commit with a short path");
+
+    bad = c;
+    bad.removes.clear();
+    rejected(member, bad, "commit with its removes stripped");
+
+    bad = c;
+    bad.tag.bytes[0] ^= 1;
+    rejected(member, bad, "commit with a bad membership tag");
+
+    member.Apply(c);
+    check(member.Key() == creator.Key() && member.Epoch() == creator.Epoch(), "real commit applies after bad ones");
+    check(member.Open(creator.Seal("report")) == "report", "member opens the new epoch's messages");
+
+    return finish();
+}
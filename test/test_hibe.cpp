@@ -0,0 +1,43 @@
+// Checks on two level identity based encryption through a sub-PKG.
+//
+//   test_hibe
+#include <iostream>
+#include <secovid/hibe.hpp>
+#include "check.hpp"
+
+G1 generator;
+
+auto extract(PKG& pkg, const std::string& id) -> id_pri_key{
+    return pkg.extract(const_cast<char*>(id.c_str()));
+}
+
+auto main() -> int{
+    PKG root;
+    SubPKG region("region0", root.extract_domain("region0"), root.m_pub);
+    hibe_key alice = region.extract("alice"), bob = region.extract("bob");
+
+    std::string msg;
+    auto c = hibe_encrypt(&root.m_pub, "region0", "alice", "exposure notice");
+    check(hibe_decrypt(alice, c, msg) && msg == "exposure notice", "user opens a message to them");
+    check(!hibe_decrypt(bob, c, msg), "another user of the region can not");
+
+    // A user key for the bare domain name is not a domain key
+    check(throws([&]{ SubPKG("region0", extract(root, "region0"), root.m_pub); }), "plain identity key rejected as a domain key");
+    check(throws([&]{ SubPKG("region1", root.extract_domain("region0"), root.m_pub); }), "key for another domain rejected");
+
+    // Users can not be named into a domain key
+    check(throws([&]{ extract(root, hibe_domain_id("region0")); }), "root refuses user keys with the domain tag");
+    check(throws([&]{ extract(root, HIBE_DOMAIN_TAG); }) && !throws([&]{ extract(root, "hibe-domain"); }), "only the whole tag is refused");
+    check(throws([&]{ root.extract_domain("region0/x"); }), "domain keys for names with '/' refused");
+
+    // The right point, but not the root's scalar on it
+    PKG other;
+    id_pri_key forged = other.extract_domain("region0");
+    check(throws([&]{ SubPKG("region0", forged, root.m_pub); }), "domain key from another root rejected");
+
+    check(throws([&]{ hibe_path("a/b", "c"); }) && throws([&]{ hibe_path("a", "b/c"); }), "names with '/' rejected");
+    check(throws([&]{ region.extract("x/y"); }), "sub-PKG rejects users with '/'");
+    check(throws([&]{ hibe_encrypt(&root.m_pub, "region0/x", "y", "m"); }), "encryption rejects domains with '/'");
+
+    return finish();
+}
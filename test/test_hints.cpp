@@ -0,0 +1,48 @@
+// Checks that HintKeys::Scan picks out exactly one user's hints.
+//
+//   test_hints
+#include <iostream>
+#include <secovid/hints.hpp>
+#include "check.hpp"
+
+auto main() -> int{
+    const uint32_t today = 18500;
+    HintKeys me(7), other(7);
+    for(uint32_t d = today - 6; d <= today; d++){
+        me.Key(d);
+        other.Key(d);
+    }
+
+    // Mine on several days among other users' hints, plus hints on a
+    // day this user has no key for
+    std::vector<hint> mailbox;
+    std::vector<size_t> mine, recent;
+    for(size_t i = 0; i < 400; i++){
+        uint32_t day = today - i % 7;
+        if(i % 9 == 0){
+            mine.push_back(mailbox.size());
+            if(day > today - 3){
+                recent.push_back(mailbox.size());
+            }
+            mailbox.push_back(make_hint(me.Key(day)));
+        }else if(i % 13 == 0){
+            mailbox.push_back(make_hint(new_hint_key(today - 10)));
+        }else{
+            mailbox.push_back(make_hint(other.Key(day)));
+        }
+    }
+    check(mine.size() > 20 && recent.size() < mine.size(), "mailbox holds hints on several days");
+    check(me.Scan(mailbox) == mine, "scan finds exactly this user's hints");
+    check(me.Scan({}).empty(), "empty mailbox has nothing");
+
+    // A tag moved to another day's hint no longer matches
+    hint moved = mailbox[mine[0]];
+    moved.day = moved.day == today ? today - 1 : today;
+    check(me.Scan({moved}).empty(), "hint on the wrong day is not found");
+
+    // Four days on, the seven day window starts at today - 2
+    me.Expire(today + 4);
+    check(me.Scan(mailbox) == recent, "expired days are skipped");
+    check(HintKeys().Scan(mailbox).empty(), "user with no keys finds nothing");
+    return finish();
+}
@@ -0,0 +1,96 @@
+// Checks every intersection kernel against a naive intersection.
+//
+//   test_intersect
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include <secovid/intersect.hpp>
+#include <secovid/tokens.hpp>
+#include "check.hpp"
+
+typedef void (*kernel)(const uint32_t*, size_t, const uint32_t*, size_t, uint8_t*);
+
+auto scalar(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint8_t* hit) -> void{
+    intersect_mask_scalar(a, na, 0, b, nb, 0, hit);
+}
+
+// n sorted keys below range, so small ranges repeat keys
+auto sorted_keys(std::mt19937& gen, size_t n, uint32_t range) -> std::vector<uint32_t>{
+    std::vector<uint32_t> v(n);
+    for(auto& x : v){
+        x = gen() % range;
+    }
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+auto test_kernel(kernel f, const std::string& name) -> void{
+    std::mt19937 gen(7);
+    // Lengths either side of the 8 and 16 key blocks
+    const size_t sizes[] = {0, 1, 7, 8, 9, 15, 16, 17, 100, 1000, 4099};
+    bool ok = true;
+    for(size_t na : sizes){
+        for(size_t nb : sizes){
+            for(uint32_t range : {16u, 1000u, 1u << 30}){
+                auto a = sorted_keys(gen, na, range), b = sorted_keys(gen, nb, range);
+                std::vector<uint8_t> hit(na + 1, 0), want(na + 1, 0);
+                for(size_t i = 0; i < na; i++){
+                    want[i] = std::binary_search(b.begin(), b.end(), a[i]);
+                }
+                f(a.data(), na, b.data(), nb, hit.data());
+                ok = ok && hit == want;
+            }
+        }
+    }
+    check(ok, name + " kernel matches the naive intersection");
+}
+
+// Tokens drawn from a small pool, some sharing their top 32 bits
+auto tokens(std::mt19937_64& gen, size_t n, const std::vector<rolling_token>& pool) -> std::vector<rolling_token>{
+    std::vector<rolling_token> v(n);
+    for(auto& t : v){
+        t = gen() % 3 ? pool[gen() % pool.size()] : rolling_token{gen(), gen()};
+    }
+    return v;
+}
+
+auto test_tokens(size_t na, size_t nb, const std::string& name) -> void{
+    std::mt19937_64 gen(na * 31 + nb);
+    std::vector<rolling_token> pool(500);
+    for(size_t i = 0; i < pool.size(); i++){
+        pool[i] = rolling_token{i % 2 ? pool[i - 1].hi ^ 1 : gen(), gen()};
+    }
+    auto a = tokens(gen, na, pool), b = tokens(gen, nb, pool);
+    std::vector<std::pair<uint32_t, uint32_t>> want;
+    for(uint32_t i = 0; i < na; i++){
+        for(uint32_t j = 0; j < nb; j++){
+            if(a[i] == b[j]){
+                want.push_back(std::make_pair(i, j));
+            }
+        }
+    }
+    auto got = intersect_tokens(a, b);
+    std::sort(got.begin(), got.end());
+    check(!want.empty() && got == want, name + " matches the naive intersection");
+}
+
+auto main() -> int{
+    test_kernel(scalar, "scalar");
+    if(__builtin_cpu_supports("avx2")){
+        test_kernel(intersect_mask_avx2, "AVX2");
+    }else{
+        std::cout << "skipped: no AVX2" << std::endl;
+    }
+    if(__builtin_cpu_supports("avx512f")){
+        test_kernel(intersect_mask_avx512, "AVX-512");
+    }else{
+        std::cout << "skipped: no AVX-512" << std::endl;
+    }
+    test_kernel(intersect_mask, "dispatched");
+
+    test_tokens(3000, 2500, "sorted path");
+    test_tokens(300, 3000, "hashed path, a smaller");
+    test_tokens(3000, 300, "hashed path, b smaller");
+    check(intersect_tokens({}, {rolling_token{1, 2}}).empty(), "empty side has no matches");
+    return finish();
+}
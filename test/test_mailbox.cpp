@@ -0,0 +1,42 @@
+// Checks on reading records back from a Mailbox spread over segments.
+//
+//   test_mailbox [directory]
+#include <iostream>
+#include <secovid/mailbox.hpp>
+#include "check.hpp"
+
+auto text(const mailbox_item& item) -> std::string{
+    return std::string(item.data, item.length);
+}
+
+auto main(int argc, char* argv[]) -> int{
+    std::string dir = argc > 1 ? argv[1] : "mailbox_test";
+    std::string mkdir = "mkdir -p " + dir + " && rm -f " + dir + "/*.seg";
+    if(system(mkdir.c_str()) != 0){
+        return 1;
+    }
+    // Small segments, so alice's records are in the first and bob's in
+    // later ones
+    Mailbox box(dir, 4096);
+    uint64_t alice = mailbox_id("alice"), bob = mailbox_id("bob");
+    box.Append(alice, std::vector<std::string>{"a0", "a1"});
+    for(int i = 0; i < 20; i++){
+        box.Append(bob, std::string(500, 'b'));
+    }
+    check(box.Segments() > 1, "records span segments");
+
+    // One holder for every read, as a server does for a connection
+    std::vector<std::shared_ptr<MailboxSegment>> held;
+    auto items = box.Read(bob, 0, held);
+    check(items.size() == 20 && text(items.back()) == std::string(500, 'b'), "bob's records read back");
+    items = box.Read(alice, 0, held);
+    check(items.size() == 2 && text(items[0]) == "a0" && text(items[1]) == "a1", "alice's records read back through a reused holder");
+    items = box.Read(bob, 0, held);
+    bool same = items.size() == 20;
+    for(auto& item : items){
+        same = same && text(item) == std::string(500, 'b');
+    }
+    check(same, "bob's records read back again");
+
+    return finish();
+}
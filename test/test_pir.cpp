@@ -0,0 +1,89 @@
+// Checks that a PirServer outlives clients that misbehave.
+//
+//   test_pir [port]
+#include <thread>
+#include <iostream>
+#include <secovid/pir.hpp>
+#include "check.hpp"
+
+using boost::asio::ip::tcp;
+
+auto connect(boost::asio::io_context& io, uint16_t port) -> tcp::socket{
+    tcp::socket s(io);
+    s.connect(tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), port));
+    return s;
+}
+
+auto main(int argc, char* argv[]) -> int{
+    uint16_t port = argc > 1 ? std::stoul(argv[1]) : 9500;
+    PirDatabase db(100, 64);
+    for(uint64_t b = 0; b < db.Buckets(); b++){
+        memset(db.Bucket(b), static_cast<int>(b), db.BucketBytes());
+    }
+    // Two servers over the same buckets, each taking three clients
+    std::vector<std::thread> servers;
+    std::atomic<int> served{0};
+    for(int s = 0; s < 2; s++){
+        servers.emplace_back([&, s]{
+            try{
+                PirServer server(db, port + s);
+                for(int c = 0; c < 3; c++){
+                    server.ServeOne();
+                    served++;
+                }
+            }catch(const std::exception& e){
+                std::cout << "server " << s << ": " << e.what() << std::endl;
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    boost::asio::io_context io;
+    for(int s = 0; s < 2; s++){
+        // Asks for more queries than a server takes at once
+        tcp::socket greedy = connect(io, port + s);
+        uint32_t count = 1000000;
+        boost::asio::write(greedy, boost::asio::buffer(&count, sizeof(count)));
+        boost::system::error_code ec;
+        char c;
+        boost::asio::read(greedy, boost::asio::buffer(&c, 1), ec);
+        check(ec == boost::asio::error::eof || ec == boost::asio::error::connection_reset, "greedy client is hung up on");
+
+        // Hangs up half way through a query
+        tcp::socket gone = connect(io, port + s);
+        count = 2;
+        std::string half(db.QueryBytes() / 2, '\0');
+        boost::asio::write(gone, boost::asio::buffer(&count, sizeof(count)));
+        boost::asio::write(gone, boost::asio::buffer(half));
+        gone.close();
+    }
+
+    bool fetched = false;
+    try{
+        PirFetcher fetcher(db.Buckets(), db.BucketBytes(), "127.0.0.1", port, port + 1);
+        auto got = fetcher.Fetch({7, 42});
+        fetched = got.size() == 2 && memcmp(got[0].data(), db.Bucket(7), db.BucketBytes()) == 0
+            && memcmp(got[1].data(), db.Bucket(42), db.BucketBytes()) == 0;
+
+        // More than one request's worth
+        std::vector<uint64_t> many;
+        for(uint64_t i = 0; i < 2 * PIR_MAX_QUERIES + 5; i++){
+            many.push_back(i * 7 % db.Buckets());
+        }
+        got = fetcher.Fetch(many);
+        bool all = got.size() == many.size();
+        for(size_t i = 0; all && i < many.size(); i++){
+            all = memcmp(got[i].data(), db.Bucket(many[i]), db.BucketBytes()) == 0;
+        }
+        check(all, "large fetch is split into requests the servers take");
+    }catch(const std::exception& e){
+        std::cout << "client: " << e.what() << std::endl;
+    }
+    check(fetched, "servers still answer after bad clients");
+
+    for(auto& t : servers){
+        t.join();
+    }
+    check(served == 6, "every connection ends without an exception");
+    return finish();
+}
@@ -0,0 +1,67 @@
+// Checks the CSR risk propagation against a graph worked by hand.
+//
+//   test_risk
+#include <cmath>
+#include <iostream>
+#include <secovid/risk.hpp>
+#include "check.hpp"
+
+auto near(float a, float b) -> bool{
+    return std::fabs(a - b) <= 1e-6f + 1e-5f * std::fabs(b);
+}
+
+// 0 - 1 for 840 s, 1 - 2 instantly, 2 - 3 untimed as times run short
+auto path() -> contact_data{
+    contact_data d;
+    d.graph = {{1}, {0, 2}, {1, 3}, {2}};
+    d.times = {{{0, 840}}, {{0, 840}, {7, 7}}, {{7, 7}}, {}};
+    return d;
+}
+
+auto main() -> int{
+    risk_params params;
+    csr_graph g = to_csr(path());
+    check(g.Vertices() == 4 && g.offsets == std::vector<uint64_t>({0, 1, 3, 5, 6}), "rows of the CSR graph");
+    check(g.edges == std::vector<uint32_t>({1, 0, 2, 1, 3, 2}), "edges of the CSR graph");
+    check(g.times[4].begin == 0 && g.times[4].end == UINT32_MAX, "untimed edge is always in contact");
+
+    // Untimed edges count as instant ones
+    float far = params.beta * (840 + params.floor), brief = params.beta * params.floor;
+    std::vector<float> w = exposure_weights(g, params);
+    bool ok = w.size() == 6;
+    std::vector<float> want = {far, far, brief, brief, brief, brief};
+    for(size_t e = 0; ok && e < w.size(); e++){
+        ok = near(w[e], want[e]);
+    }
+    check(ok, "edge hazards");
+
+    std::vector<float> x = {1, 2, 3, 4}, y(4);
+    spmv(g, w, x.data(), y.data());
+    want = {far * 2, far * 1 + brief * 3, brief * 2 + brief * 4, brief * 3};
+    check(near(y[0], want[0]) && near(y[1], want[1]) && near(y[2], want[2]) && near(y[3], want[3]), "y = W x");
+
+    // Two rounds from 0: 1 is reached in the first, 2 in the second and
+    // 3 not at all
+    std::vector<float> p = exposure_risk(g, w, {1.0f}, 2);
+    float p1 = 1 - std::exp(-far);
+    float p2 = 1 - std::exp(-brief * p1);
+    check(p.size() == 4 && p[0] == 1.0f, "seed stays infected");
+    check(near(p[1], p1) && near(p[2], p2) && p[3] == 0.0f, "risk after two rounds");
+    p = exposure_risk(g, w, {1.0f}, 3);
+    float p3 = 1 - std::exp(-brief * p2);
+    check(near(p[1], 1 - std::exp(-(far + brief * p2))) && near(p[3], p3), "risk after three rounds");
+
+    // A met B, who met the case C
+    contact_data b;
+    b.uid = "B";
+    b.uv = {{0, "B"}, {1, "C"}};
+    b.vu = {{"B", 0}, {"C", 1}};
+    b.graph = {{1}, {0}};
+    b.times = {{{5, 905}}, {{5, 905}}};
+    Contact a("A");
+    a.AddContact("B", b, contact_interval{1000, 1900});
+    auto ranked = exposure_ranking(a, {"C"});
+    check(ranked.size() == 2 && ranked[0].first == "B" && ranked[1].first == "A", "B ranked above A");
+    check(ranked.size() == 2 && ranked[0].second > ranked[1].second && ranked[1].second > 0, "ranks are ordered risks");
+    return finish();
+}
@@ -0,0 +1,79 @@
+// Checks on the prefix index behind mailbox subscriptions and on
+// pushing to them.
+//
+//   test_subscribe
+#include <iostream>
+#include <secovid/subscribe.hpp>
+#include "check.hpp"
+
+using boost::asio::ip::tcp;
+
+// A stream client that does not read while far more mail arrives than
+// the server will queue for it
+auto test_slow_stream() -> void{
+    Subscriptions subs;
+    PushServer server(subs, 9502, std::chrono::seconds(30), 64);
+    boost::asio::io_context io;
+    tcp::socket s(io);
+    s.open(tcp::v4());
+    s.set_option(boost::asio::socket_base::receive_buffer_size(4096));
+    s.connect(tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 9502));
+    uint64_t prefix = 0xabcd000000000000ULL, after = 0;
+    uint8_t bits = 16, mode = 1;
+    std::vector<boost::asio::const_buffer> req{
+        boost::asio::buffer(&prefix, sizeof(prefix)),
+        boost::asio::buffer(&bits, 1),
+        boost::asio::buffer(&mode, 1),
+        boost::asio::buffer(&after, sizeof(after))};
+    boost::asio::write(s, req);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const uint64_t sent = 300000;
+    for(uint64_t q = 1; q <= sent; q++){
+        subs.Publish(prefix | q, q);
+    }
+    uint64_t frame[2] = {0, 0}, frames = 0;
+    bool collapsed = false;
+    while(frame[1] != sent){
+        boost::asio::read(s, boost::asio::buffer(frame));
+        frames++;
+        collapsed = collapsed || frame[0] == 0;
+    }
+    check(collapsed && frames < sent, "slow stream gets a collapsed frame, not every frame");
+}
+
+auto main() -> int{
+    test_slow_stream();
+
+    PrefixIndex index;
+    const uint64_t a = 0xabcd000000000000ULL, b = 0x1234000000000000ULL;
+    std::vector<uint64_t> woken;
+    auto wake = [&](uint64_t handle){ woken.push_back(handle); };
+
+    index.Insert(1, a, 16);
+    index.Publish(a | 7, 5, wake);
+    index.Publish(b | 7, 9, wake);
+    check(woken == std::vector<uint64_t>{1}, "only the matching prefix is woken");
+    check(index.Last(a, 16) == 5, "watched prefix keeps its own newest sequence");
+
+    // Nobody watches b, so it errs high with the root's
+    check(index.Last(b, 16) == 9, "unwatched prefix takes its ancestor's sequence");
+    check(index.Last(b, 64) == 9 && index.Last(a | 1, 64) == 5, "lookups below the tree stop at the deepest node");
+
+    index.Erase(1, a, 16);
+    check(index.Last(a, 16) == 9, "erased prefix is pruned back to the root");
+    index.Erase(2, b, 16);
+    index.Insert(3, a, 8);
+    index.Publish(a, 11, wake);
+    check(woken.back() == 3 && index.Last(a, 16) == 11, "a shorter prefix still works after pruning");
+
+    bool threw = false;
+    try{
+        index.Last(a, 65);
+    }catch(const std::runtime_error&){
+        threw = true;
+    }
+    check(threw, "overlong prefix rejected");
+
+    return finish();
+}
@@ -0,0 +1,33 @@
+// Checks on resolving published day keys into Contact edges.
+//
+//   test_tokens
+#include <iostream>
+#include <secovid/tokens.hpp>
+#include "check.hpp"
+
+auto test_resolve_again() -> void{
+    uint32_t t = 18500 * 86400 + 9 * 3600;
+    TokenEngine alice;
+    TokenLog log;
+    log.Record({sighting{alice.Broadcast(t), t, t + 300}});
+
+    Contact c("ME");
+    check(log.Resolve(alice.Keys(), c) == 1, "heard key resolves to a contact");
+    int v = c.Vertex(key_uid(alice.Key(18500)));
+    check(v > 0, "contact named after the key");
+    uint64_t version = c.Version();
+    size_t vertices = c.Graph().size();
+
+    check(log.Resolve(alice.Keys(), c) == 0, "resolving again adds nothing");
+    check(c.Version() == version && c.Graph().size() == vertices, "graph unchanged by a second resolve");
+
+    // Heard again later the same day: the span grows, so one more edge
+    log.Record({sighting{alice.Broadcast(t + 1800), t + 1800, t + 2000}});
+    check(log.Resolve(alice.Keys(), c) == 1, "a longer span is added");
+    check(log.Resolve(alice.Keys(), c) == 0, "and only once");
+}
+
+auto main() -> int{
+    test_resolve_again();
+    return finish();
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include "contact.hpp"
+#include "csr.hpp"
+#include "temporal.hpp"
+
+// Shortest time-respecting contact chain between two people, searched
+// from both ends at once.
+//
+// The forward side keeps, for every vertex, the earliest time the case
+// could have reached it within k hops; the backward side keeps the
+// latest time someone could be at a vertex and still reach the exposed
+// person within k hops. Each round grows the smaller frontier by one
+// hop and the chain is found as soon as some vertex can be reached
+// before it has to be left. Any chain can be split at any vertex, so
+// the first meeting gives the fewest hops. A vertex only re-enters a
+// frontier when its time improves, and edges without times are always
+// open, which makes this a plain bidirectional BFS on untimed graphs.
+//
+// A user met more than once has a vertex per meeting. Given the rings
+// of contact_copies, reaching one vertex of a person reaches the rest
+// in the same hop, so chains can carry on from any of their meetings.
+//
+// Frontiers are bitsets over the vertices.
+class ChainSearch
+{
+private:
+    const static int64_t UNREACHED_FORWARD = INT64_MAX;
+    const static int64_t UNREACHED_BACKWARD = -1;
+
+    struct side{
+        bool forward;
+        std::vector<int64_t> label;
+        std::vector<uint64_t> frontier;
+        uint64_t size = 0; // Vertices in the frontier
+        // (vertex, parent) of the vertices improved at each hop, by vertex
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> levels;
+    };
+
+    const csr_graph& g;
+    const std::vector<int>* copies;
+    side fwd;
+    side bwd;
+    std::vector<uint32_t> via;
+
+    void start(side& s, bool forward, const std::vector<uint32_t>& vs, int64_t t);
+    bool meet(uint32_t v) const;
+    void expand(side& s, const side& other, uint32_t& met);
+    void trace(const side& s, uint32_t v, size_t level, std::vector<uint32_t>& out) const;
+public:
+    // copies, if given, must outlive the search
+    explicit ChainSearch(const csr_graph& g, const std::vector<int>* copies = nullptr) : g(g), copies(copies) {}
+
+    // Fewest hop chain along which from, infectious since t0, could
+    // have exposed to. Empty if there is none.
+    std::vector<uint32_t> Find(uint32_t from, uint32_t to, uint32_t t0 = 0);
+    // As above from any vertex of from to any vertex of to
+    std::vector<uint32_t> Find(const std::vector<uint32_t>& from, const std::vector<uint32_t>& to, uint32_t t0 = 0);
+};
+
+inline void ChainSearch::start(side& s, bool forward, const std::vector<uint32_t>& vs, int64_t t){
+    uint32_t n = g.Vertices();
+    s.forward = forward;
+    int64_t unreached = forward ? UNREACHED_FORWARD : UNREACHED_BACKWARD;
+    s.label.assign(n, unreached);
+    s.frontier.assign((n + 63) / 64, 0);
+    s.levels.assign(1, std::vector<std::pair<uint32_t, uint32_t>>());
+    s.size = 0;
+    for(uint32_t v : vs){
+        if(s.label[v] == t){
+            continue;
+        }
+        s.label[v] = t;
+        s.frontier[v / 64] |= 1ULL << (v % 64);
+        s.levels[0].push_back(std::make_pair(v, v));
+        s.size++;
+    }
+    std::sort(s.levels[0].begin(), s.levels[0].end());
+}
+
+inline bool ChainSearch::meet(uint32_t v) const{
+    return fwd.label[v] != UNREACHED_FORWARD && bwd.label[v] != UNREACHED_BACKWARD
+        && fwd.label[v] <= bwd.label[v];
+}
+
+// Grows s by one hop, setting met to a vertex where the sides now meet
+inline void ChainSearch::expand(side& s, const side& other, uint32_t& met){
+    // Labels as of the previous hop, so this round adds exactly one hop
+    std::vector<std::pair<uint32_t, int64_t>> current;
+    current.reserve(s.size);
+    for(size_t w = 0; w < s.frontier.size(); w++){
+        for(uint64_t bits = s.frontier[w]; bits; bits &= bits - 1){
+            uint32_t u = static_cast<uint32_t>(w * 64 + __builtin_ctzll(bits));
+            current.push_back(std::make_pair(u, s.label[u]));
+        }
+    }
+    std::fill(s.frontier.begin(), s.frontier.end(), 0);
+    // Once the other side has stopped growing its labels are final and
+    // a vertex it can not meet is no use to any chain
+    bool final = other.size == 0;
+
+    for(auto& x : current){
+        uint32_t u = x.first;
+        int64_t t = x.second;
+        for(uint64_t e = g.offsets[u]; e < g.offsets[u + 1]; e++){
+            uint32_t v = g.edges[e];
+            const contact_interval& w = g.times[e];
+            int64_t next;
+            if(s.forward){
+                if(static_cast<int64_t>(w.end) < t){
+                    continue; // Contact over before u was exposed
+                }
+                next = std::max<int64_t>(t, w.begin);
+            }else{
+                if(static_cast<int64_t>(w.begin) > t){
+                    continue; // Contact began after u had to move on
+                }
+                next = std::min<int64_t>(t, w.end);
+            }
+            // v and the other vertices of the same person
+            uint32_t x = v;
+            do{
+                bool better = s.forward
+                    ? next < s.label[x] && !(final && next > other.label[x])
+                    : next > s.label[x] && !(final && next < other.label[x]);
+                if(better){
+                    s.label[x] = next;
+                    via[x] = u;
+                    s.frontier[x / 64] |= 1ULL << (x % 64);
+                }
+                x = copies ? static_cast<uint32_t>((*copies)[x]) : v;
+            }while(x != v);
+        }
+    }
+
+    s.levels.emplace_back();
+    s.size = 0;
+    met = UINT32_MAX;
+    for(size_t w = 0; w < s.frontier.size(); w++){
+        for(uint64_t bits = s.frontier[w]; bits; bits &= bits - 1){
+            uint32_t v = static_cast<uint32_t>(w * 64 + __builtin_ctzll(bits));
+            s.levels.back().push_back(std::make_pair(v, via[v]));
+            s.size++;
+            if(met == UINT32_MAX && meet(v)){
+                met = v;
+            }
+        }
+    }
+}
+
+// Appends the chain from the start of s to v, which was reached within
+// level hops
+inline void ChainSearch::trace(const side& s, uint32_t v, size_t level, std::vector<uint32_t>& out) const{
+    while(true){
+        // Latest hop count at or below level that set v's label
+        size_t j = level + 1;
+        const std::pair<uint32_t, uint32_t>* hit = nullptr;
+        while(j-- > 0){
+            auto& l = s.levels[j];
+            auto it = std::lower_bound(l.begin(), l.end(), std::make_pair(v, 0u));
+            if(it != l.end() && it->first == v){
+                hit = &*it;
+                break;
+            }
+        }
+        out.push_back(v);
+        if(!hit || j == 0){
+            return;
+        }
+        v = hit->second;
+        level = j - 1;
+    }
+}
+
+inline std::vector<uint32_t> ChainSearch::Find(uint32_t from, uint32_t to, uint32_t t0){
+    return Find(std::vector<uint32_t>{from}, std::vector<uint32_t>{to}, t0);
+}
+
+inline std::vector<uint32_t> ChainSearch::Find(const std::vector<uint32_t>& from, const std::vector<uint32_t>& to, uint32_t t0){
+    std::vector<uint32_t> chain;
+    uint32_t n = g.Vertices();
+    auto outside = [n](uint32_t v){ return v >= n; };
+    if(from.empty() || to.empty() || std::any_of(from.begin(), from.end(), outside)
+        || std::any_of(to.begin(), to.end(), outside)){
+        return chain;
+    }
+    start(fwd, true, from, t0);
+    start(bwd, false, to, UINT32_MAX);
+    via.assign(n, 0);
+
+    uint32_t met = UINT32_MAX;
+    for(uint32_t v : from){
+        if(met == UINT32_MAX && meet(v)){
+            met = v;
+        }
+    }
+    while(met == UINT32_MAX && (fwd.size != 0 || bwd.size != 0)){
+        // Grow the cheaper side; once a side is stuck the other may still reach it
+        if(fwd.size != 0 && (bwd.size == 0 || fwd.size <= bwd.size)){
+            expand(fwd, bwd, met);
+        }else{
+            expand(bwd, fwd, met);
+        }
+    }
+    if(met == UINT32_MAX){
+        return chain;
+    }
+
+    trace(fwd, met, fwd.levels.size() - 1, chain);
+    std::reverse(chain.begin(), chain.end());
+    std::vector<uint32_t> rest;
+    trace(bwd, met, bwd.levels.size() - 1, rest);
+    chain.insert(chain.end(), rest.begin() + 1, rest.end());
+    return chain;
+}
+
+// UIDs along the shortest chain from the confirmed case to the exposed
+// person in c's merged graph, empty if there is none. g = to_csr(c) and
+// copies = contact_copies(c) are built once for many queries.
+inline std::vector<std::string> exposure_chain(const Contact& c, const csr_graph& g, const std::vector<int>& copies,
+    const std::string& case_uid, const std::string& exposed_uid, uint32_t t0 = 0){
+    std::vector<std::string> rez;
+    std::vector<int> from = c.Vertices(case_uid);
+    std::vector<int> to = c.Vertices(exposed_uid);
+    ChainSearch search(g, &copies);
+    for(uint32_t v : search.Find(std::vector<uint32_t>(from.begin(), from.end()), std::vector<uint32_t>(to.begin(), to.end()), t0)){
+        rez.push_back(c.UID(v));
+    }
+    return rez;
+}
+
+inline std::vector<std::string> exposure_chain(const Contact& c, const std::string& case_uid,
+    const std::string& exposed_uid, uint32_t t0 = 0){
+    csr_graph g = to_csr(c);
+    std::vector<int> copies = contact_copies(c);
+    return exposure_chain(c, g, copies, case_uid, exposed_uid, t0);
+}
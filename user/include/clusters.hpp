@@ -0,0 +1,103 @@
+#pragma once
+
+#include <set>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+
+// Connected clusters of a contact graph kept up to date as edges are
+// added. Union by size with path halving, so Find and Union cost
+// O(α(n)) plus O(log n) to keep the clusters ordered by size.
+//
+// A cluster is named by its root vertex, which stays the same until
+// the cluster is merged into a larger one. Sizes count vertices, so in
+// a contact graph a user met more than once counts once per meeting.
+//
+// Queries are const and never grow the arrays: a vertex no edge has
+// touched yet is not present, Find gives absent and Size gives 0.
+class Clusters
+{
+private:
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> size;
+    // (size, root) of every cluster with more than one vertex
+    std::set<std::pair<uint32_t, uint32_t>, std::greater<std::pair<uint32_t, uint32_t>>> by_size;
+
+    void grow(uint32_t v){
+        while(parent.size() <= v){
+            parent.push_back(static_cast<uint32_t>(parent.size()));
+            size.push_back(1);
+        }
+    }
+
+    // Root of v, halving the path on the way
+    uint32_t root(uint32_t v){
+        grow(v);
+        while(parent[v] != v){
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    }
+public:
+    static const uint32_t absent = UINT32_MAX;
+
+    // Root of v without path halving, union by size keeps the walk
+    // O(log n)
+    uint32_t Find(uint32_t v) const{
+        if(v >= parent.size()){
+            return absent;
+        }
+        while(parent[v] != v){
+            v = parent[v];
+        }
+        return v;
+    }
+
+    // Joins the clusters of u and v, returns false if they were one already
+    bool Union(uint32_t u, uint32_t v){
+        u = root(u);
+        v = root(v);
+        if(u == v){
+            return false;
+        }
+        if(size[u] < size[v]){
+            std::swap(u, v);
+        }
+        if(size[u] > 1){
+            by_size.erase(std::make_pair(size[u], u));
+        }
+        if(size[v] > 1){
+            by_size.erase(std::make_pair(size[v], v));
+        }
+        parent[v] = u;
+        size[u] += size[v];
+        by_size.insert(std::make_pair(size[u], u));
+        return true;
+    }
+
+    uint32_t Size(uint32_t v) const{
+        uint32_t r = Find(v);
+        return r == absent ? 0 : size[r];
+    }
+
+    bool Connected(uint32_t u, uint32_t v) const{
+        uint32_t r = Find(u);
+        return r != absent && r == Find(v);
+    }
+
+    // Number of clusters with at least one contact
+    size_t Count() const{
+        return by_size.size();
+    }
+
+    // (root, size) of the k largest clusters, largest first
+    std::vector<std::pair<uint32_t, uint32_t>> Largest(size_t k) const{
+        std::vector<std::pair<uint32_t, uint32_t>> rez;
+        for(auto it = by_size.begin(); it != by_size.end() && rez.size() < k; ++it){
+            rez.push_back(std::make_pair(it->second, it->first));
+        }
+        return rez;
+    }
+};
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include "contact.hpp"
+
+// Compact binary format for contact_data
+//
+//   'K' FORMAT
+//   version, uid
+//   UID table:  count, then (vertex gap, uid) sorted by vertex, with
+//               hex digest UIDs packed to raw bytes
+//   rows:       graph.size(), count of non empty rows, then for each
+//               (row gap, degree, neighbour gaps, times)
+//
+// Integers are LEB128 varints. Each undirected edge u - v is kept once,
+// in the row of min(u, v), with neighbours sorted and stored as gaps.
+// An edge time is the zigzag difference of its begin from the previous
+// edge begin plus end - begin. The vu map is rebuilt from uv.
+const static uint8_t COMPACT_MAGIC = 'K';
+const static uint8_t COMPACT_FORMAT = 1;
+
+inline void put_varint(std::string& out, uint64_t x){
+    while(x >= 0x80){
+        out.push_back(static_cast<char>((x & 0x7f) | 0x80));
+        x >>= 7;
+    }
+    out.push_back(static_cast<char>(x));
+}
+
+inline uint64_t get_varint(const std::string& in, size_t& pos){
+    uint64_t x = 0;
+    for(int shift = 0; shift < 64; shift += 7){
+        if(pos >= in.size()){
+            throw std::runtime_error("Truncated compact contact data");
+        }
+        uint8_t b = static_cast<uint8_t>(in[pos++]);
+        x |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if(!(b & 0x80)){
+            return x;
+        }
+    }
+    throw std::runtime_error("Malformed varint in compact contact data");
+}
+
+inline uint64_t zigzag(int64_t x){
+    return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63);
+}
+
+inline int64_t unzigzag(uint64_t x){
+    return static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1);
+}
+
+inline void put_string(std::string& out, const std::string& s){
+    put_varint(out, s.size());
+    out += s;
+}
+
+inline std::string get_string(const std::string& in, size_t& pos){
+    uint64_t len = get_varint(in, pos);
+    if(len > in.size() - pos){
+        throw std::runtime_error("Truncated compact contact data");
+    }
+    std::string s = in.substr(pos, len);
+    pos += len;
+    return s;
+}
+
+inline bool is_hex(const std::string& s){
+    if(s.empty() || s.size() % 2){
+        return false;
+    }
+    for(char c : s){
+        if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Length is shifted left one with the low bit set for packed hex
+inline void put_uid(std::string& out, const std::string& uid){
+    if(!is_hex(uid)){
+        put_varint(out, static_cast<uint64_t>(uid.size()) << 1);
+        out += uid;
+        return;
+    }
+    put_varint(out, (static_cast<uint64_t>(uid.size() / 2) << 1) | 1);
+    for(size_t i = 0; i < uid.size(); i += 2){
+        auto nibble = [](char c){ return c <= '9' ? c - '0' : c - 'a' + 10; };
+        out.push_back(static_cast<char>(nibble(uid[i]) << 4 | nibble(uid[i + 1])));
+    }
+}
+
+inline std::string get_uid(const std::string& in, size_t& pos){
+    uint64_t tag = get_varint(in, pos);
+    uint64_t len = tag >> 1;
+    if(len > in.size() - pos){
+        throw std::runtime_error("Truncated compact contact data");
+    }
+    if(!(tag & 1)){
+        std::string s = in.substr(pos, len);
+        pos += len;
+        return s;
+    }
+    const char* digits = "0123456789abcdef";
+    std::string s;
+    s.reserve(len * 2);
+    for(uint64_t i = 0; i < len; i++){
+        uint8_t b = static_cast<uint8_t>(in[pos++]);
+        s.push_back(digits[b >> 4]);
+        s.push_back(digits[b & 0xf]);
+    }
+    return s;
+}
+
+inline std::string compact_encode(const contact_data& d){
+    std::string out;
+    out.push_back(static_cast<char>(COMPACT_MAGIC));
+    out.push_back(static_cast<char>(COMPACT_FORMAT));
+    put_varint(out, d.version);
+    put_string(out, d.uid);
+
+    // std::map iterates in vertex order
+    put_varint(out, d.uv.size());
+    int64_t prev = 0;
+    for(auto& x : d.uv){
+        put_varint(out, zigzag(x.first - prev));
+        put_uid(out, x.second);
+        prev = x.first;
+    }
+
+    // Upper half of each row, sorted by neighbour
+    std::vector<std::vector<std::pair<int, contact_interval>>> half(d.graph.size());
+    int rows = 0;
+    for(int u = 0; u < (int) d.graph.size(); u++){
+        for(int i = 0; i < (int) d.graph[u].size(); i++){
+            int v = d.graph[u][i];
+            if(v >= u){
+                half[u].push_back(std::make_pair(v, edge_time(d, u, i)));
+            }
+        }
+        std::sort(half[u].begin(), half[u].end(),
+            [](const std::pair<int, contact_interval>& a, const std::pair<int, contact_interval>& b){
+                return a.first < b.first;
+            });
+        rows += !half[u].empty();
+    }
+
+    put_varint(out, d.graph.size());
+    put_varint(out, rows);
+    int prev_row = 0;
+    int64_t prev_begin = 0;
+    for(int u = 0; u < (int) half.size(); u++){
+        if(half[u].empty()){
+            continue;
+        }
+        put_varint(out, u - prev_row);
+        put_varint(out, half[u].size());
+        int prev_v = u;
+        for(auto& e : half[u]){
+            put_varint(out, e.first - prev_v);
+            prev_v = e.first;
+        }
+        for(auto& e : half[u]){
+            put_varint(out, zigzag(static_cast<int64_t>(e.second.begin) - prev_begin));
+            put_varint(out, e.second.end - e.second.begin);
+            prev_begin = e.second.begin;
+        }
+        prev_row = u;
+    }
+    return out;
+}
+
+inline contact_data compact_decode(const std::string& in){
+    if(in.size() < 2 || static_cast<uint8_t>(in[0]) != COMPACT_MAGIC
+        || static_cast<uint8_t>(in[1]) != COMPACT_FORMAT){
+        throw std::runtime_error("Not compact contact data");
+    }
+    size_t pos = 2;
+    contact_data d;
+    d.version = get_varint(in, pos);
+    d.uid = get_string(in, pos);
+
+    uint64_t names = get_varint(in, pos);
+    int64_t prev = 0;
+    for(uint64_t i = 0; i < names; i++){
+        prev += unzigzag(get_varint(in, pos));
+        int v = static_cast<int>(prev);
+        std::string uid = get_uid(in, pos);
+        d.uv[v] = uid;
+        d.vu[uid] = v;
+    }
+
+    uint64_t size = get_varint(in, pos);
+    uint64_t rows = get_varint(in, pos);
+    if(size > INT32_MAX){
+        throw std::runtime_error("Malformed compact contact data");
+    }
+    d.graph.resize(size);
+    d.times.resize(size);
+    uint64_t u = 0;
+    int64_t prev_begin = 0;
+    std::vector<int> neighbours;
+    for(uint64_t r = 0; r < rows; r++){
+        u += get_varint(in, pos);
+        uint64_t degree = get_varint(in, pos);
+        if(u >= size || degree > in.size() - pos){
+            throw std::runtime_error("Malformed compact contact data");
+        }
+        neighbours.clear();
+        uint64_t v = u;
+        for(uint64_t i = 0; i < degree; i++){
+            v += get_varint(in, pos);
+            if(v >= size){
+                throw std::runtime_error("Malformed compact contact data");
+            }
+            neighbours.push_back(static_cast<int>(v));
+        }
+        for(int x : neighbours){
+            prev_begin += unzigzag(get_varint(in, pos));
+            uint32_t begin = static_cast<uint32_t>(prev_begin);
+            contact_interval t{begin, static_cast<uint32_t>(begin + get_varint(in, pos))};
+            d.graph[u].push_back(x);
+            d.times[u].push_back(t);
+            if(x != (int) u){
+                d.graph[x].push_back(static_cast<int>(u));
+                d.times[x].push_back(t);
+            }
+        }
+    }
+    return d;
+}
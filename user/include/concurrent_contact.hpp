@@ -0,0 +1,360 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <tuple>
+#include <functional>
+#include <unordered_map>
+#include "contact.hpp"
+#include "rcu.hpp"
+
+// Contact graph that many threads can merge contact_data into while
+// others query it. Vertices are identified by UID and owned by the
+// shard their UID hashes to; a writer only locks the shards it touches.
+// Each shard publishes an immutable snapshot that readers pick up
+// without locking. Rows and UID buckets hang off small copy-on-write
+// tables (pages of chunks of rows, groups of buckets), so a publish
+// copies the rows and buckets a merge modified plus the path of tables
+// above them, never a whole shard's index or row table.
+class ConcurrentContact
+{
+private:
+    const static int CHUNK = 64;     // Rows per chunk
+    const static int PAGE = 1024;    // Chunks per page
+    const static int BUCKETS = 4096; // UID index buckets per shard
+    const static int GROUP = 64;     // Buckets per group
+
+    // Every piece carries the publish it was made in; only pieces of
+    // the shard's current, unpublished round may be written in place
+    template<class T>
+    struct piece : T{
+        uint64_t round = 0;
+    };
+    struct row_data{
+        std::string uid;
+        std::vector<uint32_t> adj;
+        std::vector<contact_interval> times;
+    };
+    typedef piece<row_data> row;
+    typedef piece<std::vector<std::shared_ptr<const row>>> chunk;
+    typedef piece<std::vector<std::shared_ptr<const chunk>>> page;
+    typedef piece<std::unordered_map<std::string, uint32_t>> bucket;
+    typedef piece<std::vector<std::shared_ptr<const bucket>>> group;
+
+    // What readers see of a shard, never modified once published
+    struct snapshot{
+        std::vector<std::shared_ptr<const page>> pages;
+        std::vector<std::shared_ptr<const group>> index;
+        uint32_t vertices = 0;
+    };
+
+    // Writer side of a shard, guarded by lock. Tables, rows and buckets
+    // are shared with the published snapshot until first written.
+    struct shard{
+        std::mutex lock;
+        std::vector<std::shared_ptr<const page>> pages;
+        std::vector<std::shared_ptr<const group>> index;
+        uint64_t round = 1;
+        uint32_t vertices = 0;
+        std::atomic<const snapshot*> current{nullptr};
+    };
+
+    struct pending{
+        uint32_t local;
+        uint32_t to;
+        contact_interval t;
+    };
+
+    uint32_t shards;
+    std::vector<std::unique_ptr<shard>> shard_list;
+
+    uint32_t bucketOf(size_t h) const { return (h / shards) % BUCKETS; }
+    template<class T>
+    T& writable(shard& s, std::shared_ptr<const T>& p);
+    row& writableRow(shard& s, uint32_t local);
+    bucket& writableBucket(shard& s, uint32_t b);
+    static const row* findRow(const std::vector<std::shared_ptr<const page>>& pages, uint32_t local);
+    static const bucket* findBucket(const std::vector<std::shared_ptr<const group>>& index, uint32_t b);
+    uint32_t intern(uint32_t si, const std::string& uid, size_t h);
+    void addEdges(shard& s, std::vector<pending>& edges);
+    void publish(shard& s);
+
+public:
+    ConcurrentContact(uint32_t shards = 16);
+    ~ConcurrentContact();
+    ConcurrentContact(const ConcurrentContact&) = delete;
+    ConcurrentContact& operator=(const ConcurrentContact&) = delete;
+
+    // Adds every named vertex and edge of d, joining vertices by UID.
+    // Edges to vertices without a UID are dropped, as are edges already
+    // in the graph with the same interval, so overlapping uploads can
+    // be merged in any order.
+    void Merge(const contact_data& d);
+
+    // A view of the graph as of its construction, per shard. Holding
+    // one never blocks writers, but delays freeing old snapshots.
+    class Reader{
+    private:
+        Epoch::Guard guard;
+        const ConcurrentContact& c;
+        std::vector<const snapshot*> snaps;
+        const row& at(uint32_t v) const;
+    public:
+        explicit Reader(const ConcurrentContact& c);
+        uint64_t Vertices() const;
+        bool Has(uint32_t v) const;
+        // Vertex of uid, or -1 if it is not in the graph
+        int64_t Vertex(const std::string& uid) const;
+        std::string UID(uint32_t v) const;
+        const std::vector<uint32_t>& Neighbours(uint32_t v) const;
+        const std::vector<contact_interval>& Times(uint32_t v) const;
+    };
+};
+
+inline ConcurrentContact::ConcurrentContact(uint32_t shards){
+    this->shards = shards == 0 ? 1 : shards;
+    for(uint32_t i = 0; i < this->shards; i++){
+        shard_list.emplace_back(new shard());
+        shard_list.back()->index.resize(BUCKETS / GROUP);
+        publish(*shard_list.back());
+    }
+}
+
+inline ConcurrentContact::~ConcurrentContact(){
+    for(auto& s : shard_list){
+        delete s->current.load();
+    }
+}
+
+// p, made or copied the first time it is written after a publish.
+// Pieces made here are not const and no reader can see them before the
+// next publish, so handing them out mutable is safe.
+template<class T>
+T& ConcurrentContact::writable(shard& s, std::shared_ptr<const T>& p){
+    if(!p || p->round != s.round){
+        auto copy = p ? std::make_shared<T>(*p) : std::make_shared<T>();
+        copy->round = s.round;
+        p = copy;
+    }
+    return const_cast<T&>(*p);
+}
+
+inline ConcurrentContact::row& ConcurrentContact::writableRow(shard& s, uint32_t local){
+    uint32_t c = local / CHUNK;
+    if(c / PAGE >= s.pages.size()){
+        s.pages.resize(c / PAGE + 1);
+    }
+    page& pg = writable(s, s.pages[c / PAGE]);
+    pg.resize(PAGE);
+    chunk& ch = writable(s, pg[c % PAGE]);
+    ch.resize(CHUNK);
+    return writable(s, ch[local % CHUNK]);
+}
+
+inline ConcurrentContact::bucket& ConcurrentContact::writableBucket(shard& s, uint32_t b){
+    group& g = writable(s, s.index[b / GROUP]);
+    g.resize(GROUP);
+    return writable(s, g[b % GROUP]);
+}
+
+inline const ConcurrentContact::row* ConcurrentContact::findRow(const std::vector<std::shared_ptr<const page>>& pages, uint32_t local){
+    uint32_t c = local / CHUNK;
+    if(c / PAGE >= pages.size() || !pages[c / PAGE]){
+        return nullptr;
+    }
+    auto& ch = (*pages[c / PAGE])[c % PAGE];
+    return ch ? (*ch)[local % CHUNK].get() : nullptr;
+}
+
+inline const ConcurrentContact::bucket* ConcurrentContact::findBucket(const std::vector<std::shared_ptr<const group>>& index, uint32_t b){
+    auto& g = index[b / GROUP];
+    return g ? (*g)[b % GROUP].get() : nullptr;
+}
+
+// Global vertex of uid, adding it if needed. Lock of shard si is held.
+inline uint32_t ConcurrentContact::intern(uint32_t si, const std::string& uid, size_t h){
+    shard& s = *shard_list[si];
+    uint32_t b = bucketOf(h);
+    const bucket* found = findBucket(s.index, b);
+    if(found){
+        auto it = found->find(uid);
+        if(it != found->end()){
+            return it->second;
+        }
+    }
+    uint32_t local = s.vertices++;
+    uint32_t v = local * shards + si;
+    writableRow(s, local).uid = uid;
+    writableBucket(s, b)[uid] = v;
+    return v;
+}
+
+// Appends the edges a row does not have yet. Lock of s is held.
+inline void ConcurrentContact::addEdges(shard& s, std::vector<pending>& edges){
+    typedef std::tuple<uint32_t, uint32_t, uint32_t> key;
+    auto less = [](const pending& a, const pending& b){
+        return std::tie(a.local, a.to, a.t.begin, a.t.end) < std::tie(b.local, b.to, b.t.begin, b.t.end);
+    };
+    std::sort(edges.begin(), edges.end(), less);
+    std::vector<key> have;
+    for(size_t first = 0, last; first < edges.size(); first = last){
+        uint32_t local = edges[first].local;
+        for(last = first; last < edges.size() && edges[last].local == local; last++);
+
+        // A few new edges are looked up by scanning the row, more by
+        // sorting a copy of it
+        const row* r = findRow(s.pages, local);
+        bool sorted = r && last - first > 4;
+        have.clear();
+        if(sorted){
+            for(size_t i = 0; i < r->adj.size(); i++){
+                have.push_back(key(r->adj[i], r->times[i].begin, r->times[i].end));
+            }
+            std::sort(have.begin(), have.end());
+        }
+        auto known = [&](const pending& e){
+            if(sorted){
+                return std::binary_search(have.begin(), have.end(), key(e.to, e.t.begin, e.t.end));
+            }
+            for(size_t i = 0; r && i < r->adj.size(); i++){
+                if(r->adj[i] == e.to && r->times[i].begin == e.t.begin && r->times[i].end == e.t.end){
+                    return true;
+                }
+            }
+            return false;
+        };
+        row* w = nullptr;
+        for(size_t i = first; i < last; i++){
+            const pending& e = edges[i];
+            if((i > first && !less(edges[i - 1], e)) || known(e)){
+                continue;
+            }
+            if(!w){
+                w = &writableRow(s, local);
+            }
+            w->adj.push_back(e.to);
+            w->times.push_back(e.t);
+        }
+    }
+}
+
+// Lock of s is held
+inline void ConcurrentContact::publish(shard& s){
+    snapshot* snap = new snapshot();
+    snap->pages = s.pages;
+    snap->index = s.index;
+    snap->vertices = s.vertices;
+    s.round++;
+
+    const snapshot* old = s.current.exchange(snap);
+    if(old){
+        Epoch::Global().Retire([old](){ delete old; });
+    }
+}
+
+inline void ConcurrentContact::Merge(const contact_data& d){
+    std::hash<std::string> hash;
+
+    // Resolve every named vertex, taking each shard lock once
+    std::vector<int64_t> id(d.graph.size(), -1);
+    std::vector<std::vector<std::pair<int, size_t>>> named(shards);
+    for(auto& x : d.uv){
+        if(x.first >= 0 && x.first < (int) d.graph.size()){
+            size_t h = hash(x.second);
+            named[h % shards].push_back(std::make_pair(x.first, h));
+        }
+    }
+    std::vector<bool> touched(shards, false);
+    for(uint32_t si = 0; si < shards; si++){
+        if(named[si].empty()){
+            continue;
+        }
+        std::lock_guard<std::mutex> l(shard_list[si]->lock);
+        for(auto& x : named[si]){
+            id[x.first] = intern(si, d.uv.at(x.first), x.second);
+        }
+        touched[si] = true;
+    }
+
+    // Each direction of an edge lives in the row of its source
+    std::vector<std::vector<pending>> edges(shards);
+    for(int u = 0; u < (int) d.graph.size(); u++){
+        if(id[u] < 0){
+            continue;
+        }
+        for(int i = 0; i < (int) d.graph[u].size(); i++){
+            int v = d.graph[u][i];
+            if(v < 0 || v >= (int) d.graph.size() || id[v] < 0){
+                continue;
+            }
+            uint32_t src = static_cast<uint32_t>(id[u]);
+            edges[src % shards].push_back(pending{src / shards, static_cast<uint32_t>(id[v]), edge_time(d, u, i)});
+        }
+    }
+
+    for(uint32_t si = 0; si < shards; si++){
+        if(!touched[si]){
+            continue;
+        }
+        shard& s = *shard_list[si];
+        std::lock_guard<std::mutex> l(s.lock);
+        addEdges(s, edges[si]);
+        publish(s);
+    }
+}
+
+inline ConcurrentContact::Reader::Reader(const ConcurrentContact& c) : c(c){
+    snaps.reserve(c.shards);
+    for(auto& s : c.shard_list){
+        snaps.push_back(s->current.load());
+    }
+}
+
+inline uint64_t ConcurrentContact::Reader::Vertices() const{
+    uint64_t n = 0;
+    for(auto s : snaps){
+        n += s->vertices;
+    }
+    return n;
+}
+
+inline bool ConcurrentContact::Reader::Has(uint32_t v) const{
+    return v / c.shards < snaps[v % c.shards]->vertices;
+}
+
+// A neighbour can be in a shard whose snapshot this reader took
+// before the vertex was published; it reads as empty
+inline const ConcurrentContact::row& ConcurrentContact::Reader::at(uint32_t v) const{
+    static const row empty;
+    if(!Has(v)){
+        return empty;
+    }
+    return *findRow(snaps[v % c.shards]->pages, v / c.shards);
+}
+
+inline int64_t ConcurrentContact::Reader::Vertex(const std::string& uid) const{
+    size_t h = std::hash<std::string>()(uid);
+    const bucket* b = findBucket(snaps[h % c.shards]->index, c.bucketOf(h));
+    if(!b){
+        return -1;
+    }
+    auto it = b->find(uid);
+    return it == b->end() ? -1 : static_cast<int64_t>(it->second);
+}
+
+inline std::string ConcurrentContact::Reader::UID(uint32_t v) const{
+    return at(v).uid;
+}
+
+inline const std::vector<uint32_t>& ConcurrentContact::Reader::Neighbours(uint32_t v) const{
+    return at(v).adj;
+}
+
+inline const std::vector<contact_interval>& ConcurrentContact::Reader::Times(uint32_t v) const{
+    return at(v).times;
+}
@@ -1,14 +1,21 @@
 #pragma once
 
 #include <map>
+#include <set>
+#include <tuple>
+#include <algorithm>
+#include <ctime>
+#include <cstdint>
 #include <cstring>
 #include <vector>
 #include <sstream>
+#include <stdexcept>
 #include <iostream>
 #include <cereal/archives/portable_binary.hpp>
 #include <cereal/types/vector.hpp>
 #include <cereal/types/string.hpp>
 #include <cereal/types/map.hpp>
+#include "clusters.hpp"
 
 // #include <boost/graph/adjacency_list.hpp>
 // #include <boost/graph/topological_sort.hpp>
@@ -17,18 +24,84 @@
 // typedef boost::adjacency_list<boost::listS, boost::vecS, boost::directedS> digraph;
 const static int SIZE = 100;
 
+// The window [begin, end] (seconds since the epoch) during which
+// two users were in contact
+struct contact_interval{
+    uint32_t begin;
+    uint32_t end;
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(begin, end);
+    }
+};
+typedef struct contact_interval contact_interval;
+
+// Interval for a contact happening right now
+inline contact_interval now_interval(){
+    uint32_t t = static_cast<uint32_t>(std::time(nullptr));
+    return contact_interval{t, t};
+}
+
 struct contact_data{
     std::map<int, std::string> uv;
     std::map<std::string, int> vu;
     std::vector<std::vector<int>> graph;
+    // times[u][i] is the interval of the edge graph[u][i]
+    std::vector<std::vector<contact_interval>> times;
 	std::string uid;
+    uint64_t version = 0; // Version of the sender's graph this reflects
 
+    // Layout 0 predates edge times and graph versions
     template<class Archive>
-    void serialize(Archive & archive){
-        archive(uv, vu, graph, uid);
+    void serialize(Archive & archive, std::uint32_t const layout){
+        if(layout == 0){
+            archive(uv, vu, graph, uid);
+        }else{
+            archive(uv, vu, graph, times, uid, version);
+        }
     }
 };
 typedef struct contact_data contact_data;
+CEREAL_CLASS_VERSION(contact_data, 1);
+
+// contact_data as peers sent it before it was versioned
+struct unversioned_contact_data{
+    contact_data d;
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(d.uv, d.vu, d.graph, d.uid);
+    }
+};
+
+// An undirected edge u - v
+struct contact_edge{
+    int u;
+    int v;
+    contact_interval t;
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(u, v, t);
+    }
+};
+typedef struct contact_edge contact_edge;
+
+// Everything added to a graph between versions from and to
+struct contact_delta{
+    uint64_t from;
+    uint64_t to;
+    std::string uid;
+    std::map<int, std::string> uv; // Vertices named or renamed
+    std::vector<contact_edge> edges;
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(from, to, uid, uv, edges);
+    }
+};
+typedef struct contact_delta contact_delta;
 class Contact
 {
 private:
@@ -37,21 +110,50 @@ private:
     std::map<int, std::string> uid_from_vertex;
     std::map<std::string, int> vertex_from_uid;
     std::vector<std::vector<int>> graph;
+    std::vector<std::vector<contact_interval>> times;
+    contact_interval when; // Time of the contact being merged
+
+    // Every mutation bumps the version and is logged with it so peers
+    // can be sent only what changed since the version they have
+    uint64_t version = 0;
+    std::vector<std::pair<uint64_t, int>> vertex_log;
+    std::vector<std::pair<uint64_t, contact_edge>> edge_log;
+
+    Clusters clusters; // Updated on every edge
     void addToMap(int n, std::string uid);
     void addGraph(contact_data d, int v);
-    void addEdge(int u, int v);
-    void DFSUtil(int u, std::vector<bool> &visited, contact_data g);
+    void addEdge(int u, int v, contact_interval t);
     bool find(std::string uid);
     
 public:
 	std::string uid;
     Contact(std::string uid_hash);
-    void AddContact(std::string uid, contact_data data);
+    void AddContact(std::string uid, contact_data data, contact_interval when = now_interval());
     void PrintGraph();
 	void PrintAllUIDS();
 	void DFS(contact_data data);
     std::string Serialize();
+    contact_data Data();
     contact_data Deserialize(std::string cdata);
+    uint64_t Version() const { return version; }
+    // Heap held by the version logs behind SerializeSince
+    uint64_t LogBytes() const{
+        return vertex_log.capacity() * sizeof(vertex_log[0]) + edge_log.capacity() * sizeof(edge_log[0]);
+    }
+    // Vertices and edges added after version, to be applied with apply_delta
+    std::string SerializeSince(uint64_t version);
+    contact_delta DeserializeDelta(std::string cdata);
+
+    const std::vector<std::vector<int>>& Graph() const { return graph; }
+    const std::vector<std::vector<contact_interval>>& Times() const { return times; }
+    // Vertex of uid, or -1 if it is not in the graph. A user met more
+    // than once sits on a vertex per meeting; this is the latest.
+    int Vertex(const std::string& uid) const;
+    // Every vertex of uid, in order
+    std::vector<int> Vertices(const std::string& uid) const;
+    std::string UID(int v) const;
+    // Connected clusters, cluster ids are vertices
+    const Clusters& Components() const { return clusters; }
 };
 
 // Set up the user's contact list
@@ -66,6 +168,7 @@ Contact::Contact(std::string uid_hash){
         }
     }*/
 	graph.resize(SIZE);
+	times.resize(SIZE);
     addToMap(0, uid_hash);
 	this->uid = uid_hash;
 }
@@ -90,12 +193,21 @@ void Contact::PrintAllUIDS(){
 
 
 void Contact::addToMap(int n, std::string uid){
+    auto old = this->uid_from_vertex.find(n);
+    if(old != this->uid_from_vertex.end() && old->second != uid){
+        auto it = this->vertex_from_uid.find(old->second);
+        if(it != this->vertex_from_uid.end() && it->second == n){
+            this->vertex_from_uid.erase(it);
+        }
+    }
     this->uid_from_vertex[n] = uid;
     this->vertex_from_uid[uid] = n;
+    this->vertex_log.push_back(std::make_pair(++this->version, n));
 }
 
 // Adds new contact 
-void Contact::AddContact(std::string uid, contact_data data){
+void Contact::AddContact(std::string uid, contact_data data, contact_interval when){
+    this->when = when;
     if(!find(uid)){
         addGraph(data, 0);
     }else{
@@ -108,21 +220,26 @@ void Contact::addGraph(contact_data d, int v){
     this->n = 1;
     for(int i = 0; i < this->graph.size(); i++){
 		if(this->graph[i].size() > 0){
-			std::cout << this->graph[i].size() << std::endl;
 			this->n = i + 1;
 		}	
 	}
-	
-	std::cout << "N IS: " << this->n << std::endl;
 	this->DFS(d);
 }
 
-std::string Contact::Serialize(){
+// Snapshot of the graph as sent to peers
+contact_data Contact::Data(){
 	contact_data d;
    	d.uv = uid_from_vertex;
 	d.vu = vertex_from_uid;
 	d.graph = this->graph;
+	d.times = this->times;
 	d.uid = this->uid;
+	d.version = this->version;
+	return d;
+}
+
+std::string Contact::Serialize(){
+	contact_data d = Data();
 	//mcpy(d.graph, this->graph, sizeof(this->graph));
 	/*for(int i = 0; i < this->graph->size(); i++){
 		for(int j = 0; i < this->graph[i].size(); j++){
@@ -142,54 +259,190 @@ contact_data Contact::Deserialize(std::string cdata){
     std::stringstream ss;
     ss.write(cdata.c_str(), cdata.length());
     contact_data rez;
-    {
+    try{
         cereal::PortableBinaryInputArchive iarchive(ss); 
         iarchive(rez);
+        if(ss.peek() == EOF && (rez.times.empty() || rez.times.size() == rez.graph.size())){
+            return rez;
+        }
+    }catch(const std::exception&){
+    }
+
+    // Payloads from before versioning carry no layout number
+    std::stringstream old;
+    old.write(cdata.c_str(), cdata.length());
+    unversioned_contact_data u;
+    {
+        cereal::PortableBinaryInputArchive iarchive(old);
+        iarchive(u);
+    }
+    if(old.peek() != EOF){
+        throw std::runtime_error("Malformed contact graph");
+    }
+    return u.d;
+}
+
+std::string Contact::SerializeSince(uint64_t version){
+    contact_delta d;
+    d.from = version;
+    d.to = this->version;
+    d.uid = this->uid;
+
+    // Logs are in version order
+    auto after = [](const std::pair<uint64_t, int>& e, uint64_t v){ return e.first <= v; };
+    for(auto it = std::lower_bound(vertex_log.begin(), vertex_log.end(), version, after);
+        it != vertex_log.end(); ++it){
+        d.uv[it->second] = uid_from_vertex[it->second];
+    }
+    auto eafter = [](const std::pair<uint64_t, contact_edge>& e, uint64_t v){ return e.first <= v; };
+    for(auto it = std::lower_bound(edge_log.begin(), edge_log.end(), version, eafter);
+        it != edge_log.end(); ++it){
+        d.edges.push_back(it->second);
+    }
+
+    std::stringstream ss;
+    {
+        cereal::PortableBinaryOutputArchive oarchive(ss);
+        oarchive(d);
+    }
+    return ss.str();
+}
+
+contact_delta Contact::DeserializeDelta(std::string cdata){
+    std::stringstream ss;
+    ss.write(cdata.c_str(), cdata.length());
+    contact_delta rez;
+    {
+        cereal::PortableBinaryInputArchive iarchive(ss);
+        iarchive(rez);
     }
     return rez;
 }
 
+// Bring a copy of a peer's graph up to date. Returns false if the
+// delta was not made from the copy's version, in which case the
+// whole graph has to be requested again.
+inline bool apply_delta(contact_data& g, const contact_delta& d){
+    if(d.to <= g.version){
+        return true; // Nothing new
+    }
+    if(d.from != g.version){
+        return false;
+    }
+
+    for(auto& x : d.uv){
+        // A renamed vertex loses its old name
+        auto old = g.uv.find(x.first);
+        if(old != g.uv.end() && old->second != x.second){
+            auto it = g.vu.find(old->second);
+            if(it != g.vu.end() && it->second == x.first){
+                g.vu.erase(it);
+            }
+        }
+        g.uv[x.first] = x.second;
+        g.vu[x.second] = x.first;
+    }
+    for(auto& e : d.edges){
+        int m = std::max(e.u, e.v);
+        if(m >= (int) g.graph.size()){
+            g.graph.resize(m + 1);
+        }
+        g.times.resize(g.graph.size());
+        g.graph[e.u].push_back(e.v);
+        g.graph[e.v].push_back(e.u);
+        g.times[e.u].push_back(e.t);
+        g.times[e.v].push_back(e.t);
+    }
+    g.uid = d.uid;
+    g.version = d.to;
+    return true;
+}
+
 // Find the node n that is attached 
 // to the current uid
 bool Contact::find(std::string uid){
     return (vertex_from_uid.find(uid) != vertex_from_uid.end());
 }
 
+int Contact::Vertex(const std::string& uid) const{
+    auto it = vertex_from_uid.find(uid);
+    return it == vertex_from_uid.end() ? -1 : it->second;
+}
+
+std::vector<int> Contact::Vertices(const std::string& uid) const{
+    std::vector<int> rez;
+    for(auto& x : uid_from_vertex){
+        if(x.second == uid){
+            rez.push_back(x.first);
+        }
+    }
+    return rez;
+}
+
+std::string Contact::UID(int v) const{
+    auto it = uid_from_vertex.find(v);
+    return it == uid_from_vertex.end() ? "" : it->second;
+}
+
 // A utility function to add an edge in an 
 // undirected graph. 
-void Contact::addEdge(int u, int v) { 
+void Contact::addEdge(int u, int v, contact_interval t) { 
+    if(std::max(u, v) >= (int) this->graph.size()){
+        this->graph.resize(std::max(u, v) + 1);
+    }
+    this->times.resize(this->graph.size());
     this->graph[u].push_back(v); 
     this->graph[v].push_back(u); 
+    this->times[u].push_back(t);
+    this->times[v].push_back(t);
+    this->edge_log.push_back(std::make_pair(++this->version, contact_edge{u, v, t}));
+    this->clusters.Union(u, v);
 } 
+
+// Interval of the edge g.graph[u][i]. Graphs from peers that
+// predate edge times are treated as always in contact.
+inline contact_interval edge_time(const contact_data& g, int u, int i){
+    if(u < (int) g.times.size() && i < (int) g.times[u].size()){
+        return g.times[u][i];
+    }
+    return contact_interval{0, UINT32_MAX};
+}
   
-// A utility function to do DFS of graph 
-// recursively from a given vertex u. 
-void Contact::DFSUtil(int u, std::vector<bool> &visited, contact_data g){
-    visited[u] = true; 	
-    // std::cout << u << " "; 
-    for (int i=0; i< g.graph[u].size(); i++){ 
-        if (visited[g.graph[u][i]] == false){
-			std::cout << "N = " << this->n << std::endl;
-			std::cout << "ADDING " << (u + this->n) << "," << (g.graph[u][i] + this->n) << std::endl;
-            std::cout << g.uv[u] << std::endl;	
-		    addEdge(u + this->n, g.graph[u][i]  + this->n);
-			addToMap(u + this->n, g.uv[u]);
-		   // n++;	
-            DFSUtil(g.graph[u][i], visited, g); 
-		}
-	}
-} 
-  
-// This function does DFSUtil() for all  
-// unvisited vertices. 
+// Copies every edge of a peer's graph with its interval, vertex u of
+// the peer becoming u + n here. Each undirected edge is listed at both
+// ends, so an edge is added once per distinct (u, v, interval).
 void Contact::DFS(contact_data data){ 
-    std::vector<bool> visited(SIZE, false); 
-    for (int u = 0; u < SIZE; u++) 
-        if (visited[u] == false) 
-            DFSUtil(u, visited, data);
-	//if(this->n == 1){
-	addEdge(this->n,0);
-	std::cout << "ADDING " << data.uid << std::endl;
+    typedef std::tuple<int, int, uint32_t, uint32_t> edge_key;
+    std::set<edge_key> seen;
+    std::vector<bool> named(data.graph.size(), false);
+    auto name = [&](int u){
+        if(!named[u]){
+            named[u] = true;
+            auto it = data.uv.find(u);
+            if(it != data.uv.end()){
+                addToMap(u + this->n, it->second);
+            }
+        }
+    };
+    for (auto& adj : data.graph){
+        for (int v : adj){
+            if(v < 0 || v >= (int) data.graph.size()){
+                throw std::runtime_error("Contact graph has an edge to a missing vertex");
+            }
+        }
+    }
+    for (int u = 0; u < (int) data.graph.size(); u++){
+        for (int i = 0; i < (int) data.graph[u].size(); i++){
+            int v = data.graph[u][i];
+            contact_interval t = edge_time(data, u, i);
+            if(!seen.insert(edge_key(std::min(u, v), std::max(u, v), t.begin, t.end)).second){
+                continue;
+            }
+            addEdge(u + this->n, v + this->n, t);
+            name(u);
+            name(v);
+        }
+    }
+	addEdge(this->n, 0, this->when);
 	addToMap(this->n, data.uid);
-	//}      
-} 
+}
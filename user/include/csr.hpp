@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "contact.hpp"
+
+// Compressed sparse row copy of a contact graph: the neighbours of u
+// are edges[offsets[u] .. offsets[u + 1]), with times in step.
+struct csr_graph{
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> edges;
+    std::vector<contact_interval> times;
+
+    uint32_t Vertices() const { return offsets.empty() ? 0 : static_cast<uint32_t>(offsets.size() - 1); }
+    uint64_t Degree(uint32_t u) const { return offsets[u + 1] - offsets[u]; }
+};
+typedef struct csr_graph csr_graph;
+
+inline csr_graph to_csr(const std::vector<std::vector<int>>& graph,
+    const std::vector<std::vector<contact_interval>>& times){
+    csr_graph g;
+    g.offsets.resize(graph.size() + 1, 0);
+    for(size_t u = 0; u < graph.size(); u++){
+        g.offsets[u + 1] = g.offsets[u] + graph[u].size();
+    }
+    g.edges.reserve(g.offsets.back());
+    g.times.reserve(g.offsets.back());
+    for(size_t u = 0; u < graph.size(); u++){
+        for(size_t i = 0; i < graph[u].size(); i++){
+            g.edges.push_back(static_cast<uint32_t>(graph[u][i]));
+            bool timed = u < times.size() && i < times[u].size();
+            g.times.push_back(timed ? times[u][i] : contact_interval{0, UINT32_MAX});
+        }
+    }
+    return g;
+}
+
+inline csr_graph to_csr(const Contact& c){
+    return to_csr(c.Graph(), c.Times());
+}
+
+inline csr_graph to_csr(const contact_data& d){
+    return to_csr(d.graph, d.times);
+}
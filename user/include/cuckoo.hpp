@@ -0,0 +1,267 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <random>
+#include <sstream>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/types/vector.hpp>
+#include "contact.hpp"
+
+// 64 bit FNV-1a finished with the splitmix64 mixer. Filters are queried
+// on other machines, so unlike std::hash this must never change.
+inline uint64_t hash64(const std::string& s, uint64_t seed = 0){
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for(unsigned char c : s){
+        h = (h ^ c) * 0x100000001b3ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+// Cuckoo filter over UIDs. Buckets hold four 12 bit fingerprints packed
+// into 6 bytes, so at the usual 95% load an entry costs about 12.6 bits
+// and a lookup for a UID that is not there is wrong about 0.2% of the
+// time. Entries can be removed, which a Bloom filter can not do.
+//
+// The bucket count is not rounded to a power of two, which would leave
+// filters anywhere from half to fully loaded. A fingerprint's other
+// bucket is H(fp) - i mod buckets, which maps each of its two buckets
+// to the other for any bucket count.
+class CuckooFilter
+{
+private:
+    const static int SLOTS = 4;          // Fingerprints per bucket
+    const static int BUCKET_BYTES = 6;   // SLOTS * 12 bits
+    const static int MAX_KICKS = 500;
+
+    uint64_t buckets = 0; // At most 2^32
+    uint64_t count = 0;
+    std::vector<uint8_t> table;
+    // A fingerprint left homeless by a failed insert, kept so nothing
+    // that was inserted is ever reported missing
+    uint16_t victim = 0;
+    uint64_t victim_index = 0;
+
+    uint16_t get(uint64_t b, int s) const;
+    void set(uint64_t b, int s, uint16_t fp);
+    uint64_t alt(uint64_t i, uint16_t fp) const;
+    bool insertAt(uint64_t i, uint16_t fp);
+    bool removeAt(uint64_t i, uint16_t fp);
+    bool has(uint64_t i, uint16_t fp) const;
+    void locate(const std::string& uid, uint64_t& i, uint16_t& fp) const;
+public:
+    CuckooFilter(uint64_t capacity = SIZE);
+
+    // False once the filter is full. The insert that fills it is still
+    // remembered, later ones are not.
+    bool Insert(const std::string& uid);
+    bool Contains(const std::string& uid) const;
+    // Only remove what was inserted, or other entries may go with it
+    bool Remove(const std::string& uid);
+    uint64_t Count() const { return count; }
+    uint64_t Bytes() const { return table.size(); }
+
+    std::string Serialize();
+    static CuckooFilter Deserialize(std::string cdata);
+
+    // Layout 0 placed fingerprints in a power of two of buckets and
+    // can not be read back with this placement
+    template<class Archive>
+    void serialize(Archive & archive, std::uint32_t const layout){
+        if(layout != 1){
+            throw std::runtime_error("Unsupported cuckoo filter layout");
+        }
+        archive(buckets, count, table, victim, victim_index);
+    }
+};
+CEREAL_CLASS_VERSION(CuckooFilter, 1);
+
+inline CuckooFilter::CuckooFilter(uint64_t capacity){
+    buckets = std::min<uint64_t>((capacity * 100 + SLOTS * 95 - 1) / (SLOTS * 95), 1ULL << 32);
+    buckets = std::max<uint64_t>(buckets, 1);
+    table.assign(buckets * BUCKET_BYTES, 0);
+}
+
+inline uint16_t CuckooFilter::get(uint64_t b, int s) const{
+    const uint8_t* p = &table[b * BUCKET_BYTES + (s >> 1) * 3];
+    return (s & 1) ? (p[1] >> 4 | p[2] << 4) : (p[0] | (p[1] & 0x0f) << 8);
+}
+
+inline void CuckooFilter::set(uint64_t b, int s, uint16_t fp){
+    uint8_t* p = &table[b * BUCKET_BYTES + (s >> 1) * 3];
+    if(s & 1){
+        p[1] = (p[1] & 0x0f) | (fp & 0x0f) << 4;
+        p[2] = fp >> 4;
+    }else{
+        p[0] = fp & 0xff;
+        p[1] = (p[1] & 0xf0) | fp >> 8;
+    }
+}
+
+// The other bucket of a fingerprint, from either of its two buckets
+inline uint64_t CuckooFilter::alt(uint64_t i, uint16_t fp) const{
+    uint64_t h = (fp * 0x5bd1e995ULL) % buckets;
+    return h >= i ? h - i : h + buckets - i;
+}
+
+inline void CuckooFilter::locate(const std::string& uid, uint64_t& i, uint16_t& fp) const{
+    uint64_t h = hash64(uid);
+    i = ((h & 0xffffffffULL) * buckets) >> 32;
+    fp = static_cast<uint16_t>((h >> 32) % 4095 + 1); // 0 marks an empty slot
+}
+
+inline bool CuckooFilter::insertAt(uint64_t i, uint16_t fp){
+    for(int s = 0; s < SLOTS; s++){
+        if(get(i, s) == 0){
+            set(i, s, fp);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool CuckooFilter::removeAt(uint64_t i, uint16_t fp){
+    for(int s = 0; s < SLOTS; s++){
+        if(get(i, s) == fp){
+            set(i, s, 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool CuckooFilter::has(uint64_t i, uint16_t fp) const{
+    for(int s = 0; s < SLOTS; s++){
+        if(get(i, s) == fp){
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool CuckooFilter::Insert(const std::string& uid){
+    if(victim){
+        return false;
+    }
+    uint64_t i;
+    uint16_t fp;
+    locate(uid, i, fp);
+    count++;
+    if(insertAt(i, fp) || insertAt(alt(i, fp), fp)){
+        return true;
+    }
+
+    // Evict a random fingerprint to its other bucket until one fits
+    std::minstd_rand gen(static_cast<uint32_t>(hash64(uid, count)));
+    if(gen() & 1){
+        i = alt(i, fp);
+    }
+    for(int k = 0; k < MAX_KICKS; k++){
+        int s = gen() % SLOTS;
+        uint16_t old = get(i, s);
+        set(i, s, fp);
+        fp = old;
+        i = alt(i, fp);
+        if(insertAt(i, fp)){
+            return true;
+        }
+    }
+    victim = fp;
+    victim_index = i;
+    return false;
+}
+
+inline bool CuckooFilter::Contains(const std::string& uid) const{
+    uint64_t i;
+    uint16_t fp;
+    locate(uid, i, fp);
+    uint64_t j = alt(i, fp);
+    if(victim == fp && (victim_index == i || victim_index == j)){
+        return true;
+    }
+    return has(i, fp) || has(j, fp);
+}
+
+inline bool CuckooFilter::Remove(const std::string& uid){
+    uint64_t i;
+    uint16_t fp;
+    locate(uid, i, fp);
+    uint64_t j = alt(i, fp);
+    if(removeAt(i, fp) || removeAt(j, fp)){
+        count--;
+        // Give the homeless fingerprint the room just made
+        if(victim && insertAt(victim_index, victim)){
+            victim = 0;
+        }else if(victim && insertAt(alt(victim_index, victim), victim)){
+            victim = 0;
+        }
+        return true;
+    }
+    if(victim == fp && (victim_index == i || victim_index == j)){
+        victim = 0;
+        count--;
+        return true;
+    }
+    return false;
+}
+
+inline std::string CuckooFilter::Serialize(){
+    std::stringstream ss;
+    {
+        cereal::PortableBinaryOutputArchive oarchive(ss);
+        oarchive(*this);
+    }
+    return ss.str();
+}
+
+inline CuckooFilter CuckooFilter::Deserialize(std::string cdata){
+    std::stringstream ss;
+    ss.write(cdata.c_str(), cdata.length());
+    CuckooFilter rez(0);
+    {
+        cereal::PortableBinaryInputArchive iarchive(ss);
+        iarchive(rez);
+    }
+    if(rez.buckets == 0 || rez.buckets > (1ULL << 32)
+        || rez.table.size() != rez.buckets * BUCKET_BYTES || rez.victim_index >= rez.buckets){
+        throw std::runtime_error("Malformed cuckoo filter");
+    }
+    return rez;
+}
+
+// Sketch of every UID in a user's contact graph. A user met more than
+// once sits on a vertex per meeting but is inserted once: more than
+// 2 * SLOTS copies of one fingerprint can never all be placed.
+inline CuckooFilter contact_filter(const Contact& c){
+    std::vector<std::string> uids;
+    for(int v = 0; v < (int) c.Graph().size(); v++){
+        std::string uid = c.UID(v);
+        if(!uid.empty()){
+            uids.push_back(uid);
+        }
+    }
+    std::sort(uids.begin(), uids.end());
+    uids.erase(std::unique(uids.begin(), uids.end()), uids.end());
+
+    // Inserts can fail near 95% load; retry a little larger
+    uint64_t capacity = uids.size();
+    for(int attempt = 0; attempt < 16; attempt++, capacity += capacity / 32 + 4){
+        CuckooFilter f(capacity);
+        bool ok = true;
+        for(auto& uid : uids){
+            ok = ok && f.Insert(uid);
+        }
+        if(ok){
+            return f;
+        }
+    }
+    throw std::runtime_error("Could not build the contact filter");
+}
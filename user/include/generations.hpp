@@ -0,0 +1,325 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include <unordered_map>
+#include "contact.hpp"
+#include "csr.hpp"
+#include "rcu.hpp"
+
+// Contact store that only keeps the exposure window. Edges are filed
+// into generations by the time their contact ended, untimed ones by the
+// time they were added, and a generation is dropped whole once it falls
+// out of the window; vertices are freed when their last edge goes and
+// the lowest free ids are reused first, so the id space shrinks back.
+//
+// Readers query a compacted CSR of the live edges that is rebuilt in
+// the background and swapped in with RCU, so they never wait for
+// writers or for compaction. A reader sees the graph as of the last
+// compaction. The compactor keeps its own copy of the UID index, kept
+// up to date from a log of the ids writers named or freed.
+class GenerationalContacts
+{
+private:
+    struct edge{
+        uint32_t u;
+        uint32_t v;
+        contact_interval t;
+    };
+
+    // What readers see, never modified once published
+    struct view{
+        csr_graph csr;
+        std::vector<std::string> uids;
+        std::unordered_map<std::string, uint32_t> ids;
+    };
+
+    uint32_t span;   // Seconds per generation
+    uint32_t window; // Generations kept
+
+    std::mutex lock; // Guards everything below but current
+    std::map<uint32_t, std::vector<edge>> generations;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> uids;
+    std::vector<uint32_t> refs; // Live edges per vertex
+    std::vector<uint32_t> free_ids; // Min heap
+    std::vector<std::pair<uint32_t, std::string>> renamed; // Since the last compaction, "" if freed
+    bool dirty = false;
+
+    std::atomic<const view*> current{nullptr};
+    std::mutex compacting; // Keeps views published in order, guards the two below
+    std::vector<std::string> index_uids;
+    std::unordered_map<std::string, uint32_t> index_ids;
+
+    std::thread compactor;
+    std::condition_variable wake;
+    bool stop = false;
+
+    uint32_t intern(const std::string& uid);
+    void release(uint32_t v);
+    void trim();
+    void publish(const view* v);
+public:
+    GenerationalContacts(uint32_t span = 86400, uint32_t window = 14);
+    ~GenerationalContacts();
+    GenerationalContacts(const GenerationalContacts&) = delete;
+    GenerationalContacts& operator=(const GenerationalContacts&) = delete;
+
+    void Add(const std::string& a, const std::string& b, contact_interval t);
+    // Adds every edge of d between named vertices, joining them by UID
+    void Merge(const contact_data& d);
+    // Drops generations that ended before the window ending at now,
+    // returns the number of edges dropped
+    size_t Expire(uint32_t now);
+    // Rebuilds the CSR readers see. Writers are only held up while the
+    // live edges and the ids renamed since the last compaction are
+    // copied out.
+    void Compact();
+    // Compacts every period from a background thread while anything changed
+    void StartCompactor(std::chrono::milliseconds period);
+
+    size_t Generations();
+    size_t Vertices(); // Live vertices
+
+    class Reader{
+    private:
+        Epoch::Guard guard;
+        const view* v;
+    public:
+        explicit Reader(const GenerationalContacts& g) : v(g.current.load()) {}
+        const csr_graph& Graph() const { return v->csr; }
+        std::string UID(uint32_t vertex) const { return vertex < v->uids.size() ? v->uids[vertex] : ""; }
+        // Vertex of uid, or -1 if it is not in the graph
+        int64_t Vertex(const std::string& uid) const{
+            auto it = v->ids.find(uid);
+            return it == v->ids.end() ? -1 : static_cast<int64_t>(it->second);
+        }
+    };
+};
+
+inline GenerationalContacts::GenerationalContacts(uint32_t span, uint32_t window){
+    this->span = span == 0 ? 1 : span;
+    this->window = window;
+    view* v = new view();
+    v->csr.offsets.push_back(0);
+    current.store(v);
+}
+
+inline GenerationalContacts::~GenerationalContacts(){
+    {
+        std::lock_guard<std::mutex> l(lock);
+        stop = true;
+    }
+    wake.notify_all();
+    if(compactor.joinable()){
+        compactor.join();
+    }
+    delete current.load();
+}
+
+// Lock is held
+inline uint32_t GenerationalContacts::intern(const std::string& uid){
+    auto it = ids.find(uid);
+    if(it != ids.end()){
+        return it->second;
+    }
+    uint32_t v;
+    if(!free_ids.empty()){
+        std::pop_heap(free_ids.begin(), free_ids.end(), std::greater<uint32_t>());
+        v = free_ids.back();
+        free_ids.pop_back();
+        uids[v] = uid;
+    }else{
+        v = static_cast<uint32_t>(uids.size());
+        uids.push_back(uid);
+        refs.push_back(0);
+    }
+    ids[uid] = v;
+    renamed.push_back(std::make_pair(v, uid));
+    return v;
+}
+
+// Lock is held
+inline void GenerationalContacts::release(uint32_t v){
+    if(--refs[v] == 0){
+        ids.erase(uids[v]);
+        std::string().swap(uids[v]);
+        free_ids.push_back(v);
+        std::push_heap(free_ids.begin(), free_ids.end(), std::greater<uint32_t>());
+        renamed.push_back(std::make_pair(v, std::string()));
+    }
+}
+
+// Drops free ids off the end of the id space. Lock is held.
+inline void GenerationalContacts::trim(){
+    size_t n = uids.size();
+    while(n > 0 && refs[n - 1] == 0){
+        n--;
+    }
+    if(n == uids.size()){
+        return;
+    }
+    uids.resize(n);
+    refs.resize(n);
+    free_ids.erase(std::remove_if(free_ids.begin(), free_ids.end(), [n](uint32_t v){ return v >= n; }), free_ids.end());
+    std::make_heap(free_ids.begin(), free_ids.end(), std::greater<uint32_t>());
+    if(uids.capacity() > 2 * n + 1024){
+        uids.shrink_to_fit();
+        refs.shrink_to_fit();
+    }
+}
+
+inline void GenerationalContacts::Add(const std::string& a, const std::string& b, contact_interval t){
+    std::lock_guard<std::mutex> l(lock);
+    uint32_t u = intern(a);
+    uint32_t v = intern(b);
+    refs[u]++;
+    refs[v]++;
+    // An untimed contact expires a window after it was added
+    uint32_t end = t.end == UINT32_MAX ? now_interval().end : t.end;
+    generations[end / span].push_back(edge{u, v, t});
+    dirty = true;
+}
+
+inline void GenerationalContacts::Merge(const contact_data& d){
+    for(int u = 0; u < (int) d.graph.size(); u++){
+        auto a = d.uv.find(u);
+        if(a == d.uv.end()){
+            continue;
+        }
+        for(int i = 0; i < (int) d.graph[u].size(); i++){
+            int v = d.graph[u][i];
+            auto b = d.uv.find(v);
+            // Each undirected edge is listed from both ends
+            if(v >= u && b != d.uv.end()){
+                Add(a->second, b->second, edge_time(d, u, i));
+            }
+        }
+    }
+}
+
+inline size_t GenerationalContacts::Expire(uint32_t now){
+    std::lock_guard<std::mutex> l(lock);
+    uint32_t newest = now / span;
+    uint32_t oldest = newest >= window ? newest - window : 0;
+    size_t dropped = 0;
+    while(!generations.empty() && generations.begin()->first < oldest){
+        for(auto& e : generations.begin()->second){
+            release(e.u);
+            release(e.v);
+        }
+        dropped += generations.begin()->second.size();
+        generations.erase(generations.begin());
+    }
+    if(dropped){
+        trim();
+        dirty = true;
+    }
+    return dropped;
+}
+
+inline void GenerationalContacts::Compact(){
+    std::lock_guard<std::mutex> c(compacting);
+    std::vector<edge> edges;
+    std::vector<std::pair<uint32_t, std::string>> log;
+    size_t vertices;
+    {
+        std::lock_guard<std::mutex> l(lock);
+        size_t m = 0;
+        for(auto& g : generations){
+            m += g.second.size();
+        }
+        edges.reserve(m);
+        for(auto& g : generations){
+            edges.insert(edges.end(), g.second.begin(), g.second.end());
+        }
+        log.swap(renamed);
+        vertices = uids.size();
+        dirty = false;
+    }
+
+    for(auto& x : log){
+        if(x.first >= index_uids.size()){
+            index_uids.resize(x.first + 1);
+        }
+        std::string& old = index_uids[x.first];
+        auto it = index_ids.find(old);
+        if(!old.empty() && it != index_ids.end() && it->second == x.first){
+            index_ids.erase(it);
+        }
+        old = x.second;
+        if(!x.second.empty()){
+            index_ids[x.second] = x.first;
+        }
+    }
+    index_uids.resize(vertices);
+    view* v = new view();
+    v->uids = index_uids;
+    v->ids = index_ids;
+
+    // Counting sort of both directions of every edge by source
+    csr_graph& g = v->csr;
+    g.offsets.assign(v->uids.size() + 1, 0);
+    for(auto& e : edges){
+        g.offsets[e.u + 1]++;
+        g.offsets[e.v + 1]++;
+    }
+    for(size_t u = 0; u < v->uids.size(); u++){
+        g.offsets[u + 1] += g.offsets[u];
+    }
+    g.edges.resize(g.offsets.back());
+    g.times.resize(g.offsets.back());
+    std::vector<uint64_t> fill(g.offsets.begin(), g.offsets.end() - 1);
+    for(auto& e : edges){
+        g.edges[fill[e.u]] = e.v;
+        g.times[fill[e.u]++] = e.t;
+        g.edges[fill[e.v]] = e.u;
+        g.times[fill[e.v]++] = e.t;
+    }
+    publish(v);
+}
+
+inline void GenerationalContacts::publish(const view* v){
+    const view* old = current.exchange(v);
+    Epoch::Global().Retire([old](){ delete old; });
+}
+
+inline void GenerationalContacts::StartCompactor(std::chrono::milliseconds period){
+    if(compactor.joinable()){
+        return;
+    }
+    compactor = std::thread([this, period](){
+        std::unique_lock<std::mutex> l(lock);
+        while(!stop){
+            wake.wait_for(l, period, [this](){ return stop; });
+            if(stop){
+                break;
+            }
+            if(dirty){
+                l.unlock();
+                Compact();
+                l.lock();
+            }
+        }
+    });
+}
+
+inline size_t GenerationalContacts::Generations(){
+    std::lock_guard<std::mutex> l(lock);
+    return generations.size();
+}
+
+inline size_t GenerationalContacts::Vertices(){
+    std::lock_guard<std::mutex> l(lock);
+    return ids.size();
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "contact.hpp"
+
+// Flat on disk layout of a contact graph that is queried in place
+//
+//   graph_header
+//   uint64_t uid_offsets[vertices + 1]   into the uid blob
+//   uint32_t uid_order[vertices]         vertices sorted by uid
+//   uint64_t offsets[vertices + 1]       CSR row starts
+//   uint32_t edges[edges]
+//   contact_interval times[edges]
+//   char uid_blob[]
+//
+// Every section starts on an 8 byte boundary. Integers are stored in
+// host byte order; snapshots are meant for the machine that wrote them.
+const static char GRAPH_MAGIC[8] = {'K', 'G', 'R', 'A', 'P', 'H', '1', '\0'};
+
+struct graph_header{
+    char magic[8];
+    uint64_t version;
+    uint64_t vertices;
+    uint64_t edges;
+    uint64_t uid_offsets;
+    uint64_t uid_order;
+    uint64_t offsets;
+    uint64_t edge_list;
+    uint64_t times;
+    uint64_t uid_blob;
+    uint64_t uid_bytes;
+};
+typedef struct graph_header graph_header;
+
+inline uint64_t align8(uint64_t x){
+    return (x + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Lays out d as a snapshot, handing it to sink(const char*, size_t)
+// section by section so the image is never whole in memory. Vertices
+// without a uid get an empty one.
+template<class Sink>
+void graph_snapshot_to(const contact_data& d, Sink sink){
+    uint64_t vertices = d.graph.size();
+    uint64_t edges = 0;
+    for(auto& row : d.graph){
+        edges += row.size();
+    }
+
+    std::vector<uint64_t> uid_offsets(vertices + 1, 0);
+    std::string blob;
+    for(uint64_t v = 0; v < vertices; v++){
+        auto it = d.uv.find(static_cast<int>(v));
+        if(it != d.uv.end()){
+            blob += it->second;
+        }
+        uid_offsets[v + 1] = blob.size();
+    }
+    std::vector<uint32_t> uid_order(vertices);
+    std::iota(uid_order.begin(), uid_order.end(), 0);
+    std::sort(uid_order.begin(), uid_order.end(), [&](uint32_t a, uint32_t b){
+        return blob.compare(uid_offsets[a], uid_offsets[a + 1] - uid_offsets[a],
+            blob, uid_offsets[b], uid_offsets[b + 1] - uid_offsets[b]) < 0;
+    });
+
+    graph_header h;
+    memcpy(h.magic, GRAPH_MAGIC, sizeof(h.magic));
+    h.version = d.version;
+    h.vertices = vertices;
+    h.edges = edges;
+    h.uid_offsets = align8(sizeof(graph_header));
+    h.uid_order = align8(h.uid_offsets + (vertices + 1) * sizeof(uint64_t));
+    h.offsets = align8(h.uid_order + vertices * sizeof(uint32_t));
+    h.edge_list = align8(h.offsets + (vertices + 1) * sizeof(uint64_t));
+    h.times = align8(h.edge_list + edges * sizeof(uint32_t));
+    h.uid_blob = align8(h.times + edges * sizeof(contact_interval));
+    h.uid_bytes = blob.size();
+
+    uint64_t at = 0;
+    auto put = [&](const void* p, uint64_t bytes){
+        sink(static_cast<const char*>(p), bytes);
+        at += bytes;
+    };
+    const char zeros[8] = {};
+    auto pad = [&](uint64_t to){
+        put(zeros, to - at);
+    };
+
+    put(&h, sizeof(h));
+    pad(h.uid_offsets);
+    put(uid_offsets.data(), uid_offsets.size() * sizeof(uint64_t));
+    pad(h.uid_order);
+    put(uid_order.data(), uid_order.size() * sizeof(uint32_t));
+    pad(h.offsets);
+    uint64_t e = 0;
+    for(uint64_t u = 0; u < vertices; u++){
+        put(&e, sizeof(e));
+        e += d.graph[u].size();
+    }
+    put(&e, sizeof(e));
+    pad(h.edge_list);
+    std::vector<uint32_t> row;
+    for(uint64_t u = 0; u < vertices; u++){
+        row.assign(d.graph[u].begin(), d.graph[u].end());
+        put(row.data(), row.size() * sizeof(uint32_t));
+    }
+    pad(h.times);
+    std::vector<contact_interval> when;
+    for(uint64_t u = 0; u < vertices; u++){
+        when.clear();
+        for(int i = 0; i < (int) d.graph[u].size(); i++){
+            when.push_back(edge_time(d, static_cast<int>(u), i));
+        }
+        put(when.data(), when.size() * sizeof(contact_interval));
+    }
+    pad(h.uid_blob);
+    put(blob.data(), blob.size());
+    pad(align8(at));
+}
+
+// The whole snapshot in memory, e.g. to send it
+inline std::string graph_snapshot(const contact_data& d){
+    std::string out;
+    graph_snapshot_to(d, [&](const char* p, size_t bytes){ out.append(p, bytes); });
+    return out;
+}
+
+inline bool write_graph_snapshot(const contact_data& d, const std::string& path){
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    graph_snapshot_to(d, [&](const char* p, size_t bytes){ out.write(p, bytes); });
+    return static_cast<bool>(out);
+}
+
+// Read only view of a graph snapshot. Nothing is copied; the lists
+// returned point straight into the mapping.
+class GraphView
+{
+private:
+    const char* base = nullptr;
+    uint64_t length = 0;
+    bool mapped = false;
+    graph_header h = {};
+
+    const uint64_t* uid_offsets = nullptr;
+    const uint32_t* uid_order = nullptr;
+    const uint64_t* offsets = nullptr;
+    const uint32_t* edge_list = nullptr;
+    const contact_interval* times = nullptr;
+    const char* uid_blob = nullptr;
+
+    void check();
+    void unmap();
+public:
+    template<class T>
+    struct range{
+        const T* first;
+        const T* last;
+        const T* begin() const { return first; }
+        const T* end() const { return last; }
+        size_t size() const { return last - first; }
+        const T& operator[](size_t i) const { return first[i]; }
+    };
+
+    GraphView() = default;
+    // View over a snapshot already in memory, which must stay alive
+    // and be 8 byte aligned
+    GraphView(const char* data, uint64_t length);
+    ~GraphView();
+    GraphView(const GraphView&) = delete;
+    GraphView& operator=(const GraphView&) = delete;
+
+    // Maps a snapshot file, throws std::runtime_error if it is not one
+    void Open(const std::string& path);
+
+    uint64_t Version() const { return h.version; }
+    uint64_t Vertices() const { return h.vertices; }
+    uint64_t Edges() const { return h.edges; }
+    uint64_t Degree(uint32_t v) const { return offsets[v + 1] - offsets[v]; }
+    range<uint32_t> Neighbours(uint32_t v) const { return {edge_list + offsets[v], edge_list + offsets[v + 1]}; }
+    range<contact_interval> Times(uint32_t v) const { return {times + offsets[v], times + offsets[v + 1]}; }
+    range<uint64_t> Offsets() const { return {offsets, offsets + h.vertices + 1}; }
+    range<uint32_t> EdgeList() const { return {edge_list, edge_list + h.edges}; }
+    std::string UID(uint32_t v) const;
+    // Vertex of uid, or -1 if it is not in the graph or empty
+    int64_t Vertex(const std::string& uid) const;
+};
+
+inline GraphView::GraphView(const char* data, uint64_t length){
+    this->base = data;
+    this->length = length;
+    check();
+}
+
+inline GraphView::~GraphView(){
+    unmap();
+}
+
+inline void GraphView::unmap(){
+    if(mapped){
+        munmap(const_cast<char*>(base), length);
+    }
+    base = nullptr;
+    mapped = false;
+}
+
+inline void GraphView::Open(const std::string& path){
+    unmap();
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::runtime_error("Can not open graph snapshot " + path);
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        close(fd);
+        throw std::runtime_error("Can not stat graph snapshot " + path);
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){
+        throw std::runtime_error("Can not map graph snapshot " + path);
+    }
+    this->base = static_cast<const char*>(p);
+    this->length = st.st_size;
+    this->mapped = true;
+    check();
+}
+
+// Validates the header so the sections lie inside the mapping. Row
+// contents are trusted, checking them would mean touching every page.
+inline void GraphView::check(){
+    auto fail = [this](){
+        unmap();
+        throw std::runtime_error("Malformed graph snapshot");
+    };
+    if(length < sizeof(graph_header) || reinterpret_cast<uintptr_t>(base) % 8){
+        fail();
+    }
+    memcpy(&h, base, sizeof(h));
+    if(memcmp(h.magic, GRAPH_MAGIC, sizeof(h.magic)) != 0 || h.vertices >= UINT32_MAX){
+        fail();
+    }
+    auto fits = [this](uint64_t at, uint64_t count, uint64_t size){
+        return at % 8 == 0 && at <= length && count <= (length - at) / size;
+    };
+    if(!fits(h.uid_offsets, h.vertices + 1, sizeof(uint64_t))
+        || !fits(h.uid_order, h.vertices, sizeof(uint32_t))
+        || !fits(h.offsets, h.vertices + 1, sizeof(uint64_t))
+        || !fits(h.edge_list, h.edges, sizeof(uint32_t))
+        || !fits(h.times, h.edges, sizeof(contact_interval))
+        || !fits(h.uid_blob, h.uid_bytes, 1)){
+        fail();
+    }
+    uid_offsets = reinterpret_cast<const uint64_t*>(base + h.uid_offsets);
+    uid_order = reinterpret_cast<const uint32_t*>(base + h.uid_order);
+    offsets = reinterpret_cast<const uint64_t*>(base + h.offsets);
+    edge_list = reinterpret_cast<const uint32_t*>(base + h.edge_list);
+    times = reinterpret_cast<const contact_interval*>(base + h.times);
+    uid_blob = base + h.uid_blob;
+    if(offsets[h.vertices] != h.edges || uid_offsets[h.vertices] != h.uid_bytes){
+        fail();
+    }
+}
+
+inline std::string GraphView::UID(uint32_t v) const{
+    return std::string(uid_blob + uid_offsets[v], uid_offsets[v + 1] - uid_offsets[v]);
+}
+
+inline int64_t GraphView::Vertex(const std::string& uid) const{
+    if(uid.empty()){
+        return -1; // Unnamed vertices all have the empty uid
+    }
+    auto cmp = [this](uint32_t v, const std::string& key){
+        return key.compare(0, key.size(), uid_blob + uid_offsets[v],
+            uid_offsets[v + 1] - uid_offsets[v]) > 0;
+    };
+    auto it = std::lower_bound(uid_order, uid_order + h.vertices, uid, cmp);
+    if(it == uid_order + h.vertices || UID(*it) != uid){
+        return -1;
+    }
+    return *it;
+}
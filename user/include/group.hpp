@@ -0,0 +1,620 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+
+// Group keys for the members of a signed contract, kept in a ratchet
+// tree (TreeKEM, as in MLS). Members sit at the leaves of a binary tree
+// and every node on a member's path to the root holds an X25519 key
+// pair that only the members below it know. A commit refreshes the
+// sender's path: each node's secret is hashed from the one below, and
+// is sealed once to every key covering the other side of the node, so
+// adding, removing or rotating a member costs O(log n) public key
+// operations. The root secret gives the group key, and reports are
+// encrypted once under it instead of once per member.
+//
+// Nodes are numbered as in MLS: leaf i is node 2i, and a node at level
+// k has its k low bits set. The tree only ever doubles, keeping its old
+// numbering as the left half.
+//
+// As in MLS, a commit carries a membership tag, an HMAC keyed from the
+// current epoch's secret, which members check before changing anything:
+// only a member of the epoch can commit. Path secrets are sealed under
+// keys bound to the new epoch and tree, and a confirmation tag keyed
+// from the new secret lets members, and members joining, check that
+// they built the same tree as the sender.
+
+const static size_t TREE_KEY_BYTES = 32;
+const static size_t TREE_TAG_BYTES = 16;
+const static size_t TREE_NONCE_BYTES = 12;
+
+struct tree_key{
+    uint8_t bytes[TREE_KEY_BYTES];
+
+    bool operator==(const tree_key& o) const { return std::memcmp(bytes, o.bytes, TREE_KEY_BYTES) == 0; }
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(bytes);
+    }
+};
+typedef struct tree_key tree_key;
+
+// A secret sealed to one node's public key
+struct tree_sealed{
+    uint32_t node;
+    uint8_t box[TREE_KEY_BYTES + TREE_TAG_BYTES];
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(node, box);
+    }
+};
+typedef struct tree_sealed tree_sealed;
+
+// A node on the sender's path, with its secret sealed under one
+// ephemeral key to every node covering the copath side
+struct tree_path_node{
+    tree_key pub;
+    tree_key ephemeral;
+    std::vector<tree_sealed> sealed;
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(pub, ephemeral, sealed);
+    }
+};
+typedef struct tree_path_node tree_path_node;
+
+struct group_commit{
+    uint32_t sender;
+    uint64_t epoch; // Epoch the commit starts
+    std::vector<tree_key> adds;
+    std::vector<uint32_t> removes;
+    tree_key leaf;
+    std::vector<tree_path_node> path;
+    tree_key confirm; // Under the new epoch's secret, over the commit and the new tree
+    tree_key tag;     // Under the old epoch's secret, over the rest
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(sender, epoch, adds, removes, leaf, path, confirm, tag);
+    }
+};
+typedef struct group_commit group_commit;
+
+// Public keys of the tree, all a new member needs besides its own leaf
+struct group_state{
+    uint64_t epoch;
+    uint32_t width; // Leaves the tree has room for, a power of two
+    std::vector<uint8_t> filled;
+    std::vector<tree_key> pubs;
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(epoch, width, filled, pubs);
+    }
+};
+typedef struct group_state group_state;
+
+inline void tree_random(tree_key& k){
+    if(RAND_bytes(k.bytes, TREE_KEY_BYTES) != 1){
+        throw std::runtime_error("Could not draw a tree secret");
+    }
+}
+
+// HMAC-SHA256 of the label under the secret
+inline tree_key tree_kdf(const uint8_t* secret, size_t len, const std::string& label){
+    tree_key out;
+    unsigned int n = TREE_KEY_BYTES;
+    HMAC(EVP_sha256(), secret, static_cast<int>(len),
+        reinterpret_cast<const unsigned char*>(label.data()), label.size(), out.bytes, &n);
+    return out;
+}
+
+inline tree_key tree_kdf(const tree_key& secret, const std::string& label){
+    return tree_kdf(secret.bytes, TREE_KEY_BYTES, label);
+}
+
+// X25519 public key of a private key
+inline tree_key tree_public(const tree_key& pri){
+    EVP_PKEY* k = EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, nullptr, pri.bytes, TREE_KEY_BYTES);
+    tree_key pub;
+    size_t n = TREE_KEY_BYTES;
+    bool ok = k != nullptr && EVP_PKEY_get_raw_public_key(k, pub.bytes, &n) == 1;
+    EVP_PKEY_free(k);
+    if(!ok){
+        throw std::runtime_error("Could not make a tree key");
+    }
+    return pub;
+}
+
+inline tree_key tree_dh(const tree_key& pri, const tree_key& pub){
+    EVP_PKEY* a = EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, nullptr, pri.bytes, TREE_KEY_BYTES);
+    EVP_PKEY* b = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, nullptr, pub.bytes, TREE_KEY_BYTES);
+    EVP_PKEY_CTX* ctx = a != nullptr ? EVP_PKEY_CTX_new(a, nullptr) : nullptr;
+    tree_key shared;
+    size_t n = TREE_KEY_BYTES;
+    bool ok = ctx != nullptr && b != nullptr && EVP_PKEY_derive_init(ctx) == 1
+        && EVP_PKEY_derive_set_peer(ctx, b) == 1 && EVP_PKEY_derive(ctx, shared.bytes, &n) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(a);
+    EVP_PKEY_free(b);
+    if(!ok){
+        throw std::runtime_error("Bad tree key exchange");
+    }
+    return shared;
+}
+
+// AES-256-GCM of len bytes at in into out, tag after; false on a bad tag
+inline bool tree_aead(bool seal, const tree_key& key, const uint8_t* nonce, const uint8_t* in, size_t len, uint8_t* out){
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int n = 0;
+    bool ok = ctx != nullptr;
+    if(seal){
+        ok = ok && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key.bytes, nonce) == 1
+            && EVP_EncryptUpdate(ctx, out, &n, in, static_cast<int>(len)) == 1
+            && EVP_EncryptFinal_ex(ctx, out + n, &n) == 1
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TREE_TAG_BYTES, out + len) == 1;
+    }else{
+        ok = ok && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key.bytes, nonce) == 1
+            && EVP_DecryptUpdate(ctx, out, &n, in, static_cast<int>(len)) == 1
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TREE_TAG_BYTES, const_cast<uint8_t*>(in + len)) == 1
+            && EVP_DecryptFinal_ex(ctx, out + n, &n) == 1;
+    }
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+// Key for a secret sealed from one ephemeral key to one node of the
+// tree hashed into context; each is used once, so the nonce can be fixed
+inline tree_key tree_seal_key(const tree_key& shared, const tree_key& ephemeral, const tree_key& pub, const tree_key& context){
+    uint8_t ikm[4 * TREE_KEY_BYTES];
+    std::memcpy(ikm, shared.bytes, TREE_KEY_BYTES);
+    std::memcpy(ikm + TREE_KEY_BYTES, ephemeral.bytes, TREE_KEY_BYTES);
+    std::memcpy(ikm + 2 * TREE_KEY_BYTES, pub.bytes, TREE_KEY_BYTES);
+    std::memcpy(ikm + 3 * TREE_KEY_BYTES, context.bytes, TREE_KEY_BYTES);
+    return tree_kdf(ikm, sizeof(ikm), "SCV-TREE-SEAL");
+}
+
+inline void tree_put(std::string& out, uint64_t v, int bytes){
+    for(int i = 0; i < bytes; i++){
+        out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+}
+
+inline void tree_put(std::string& out, const uint8_t* p, size_t len){
+    out.append(reinterpret_cast<const char*>(p), len);
+}
+
+// Every field of c but its tags, as the tags cover them
+inline std::string tree_transcript(const group_commit& c){
+    std::string out;
+    tree_put(out, c.sender, 4);
+    tree_put(out, c.epoch, 8);
+    tree_put(out, c.adds.size(), 4);
+    for(auto& k : c.adds){
+        tree_put(out, k.bytes, TREE_KEY_BYTES);
+    }
+    tree_put(out, c.removes.size(), 4);
+    for(uint32_t r : c.removes){
+        tree_put(out, r, 4);
+    }
+    tree_put(out, c.leaf.bytes, TREE_KEY_BYTES);
+    tree_put(out, c.path.size(), 4);
+    for(auto& node : c.path){
+        tree_put(out, node.pub.bytes, TREE_KEY_BYTES);
+        tree_put(out, node.ephemeral.bytes, TREE_KEY_BYTES);
+        tree_put(out, node.sealed.size(), 4);
+        for(auto& x : node.sealed){
+            tree_put(out, x.node, 4);
+            tree_put(out, x.box, sizeof(x.box));
+        }
+    }
+    return out;
+}
+
+inline bool tree_tag_equal(const tree_key& a, const tree_key& b){
+    return CRYPTO_memcmp(a.bytes, b.bytes, TREE_KEY_BYTES) == 0;
+}
+
+inline uint32_t tree_level(uint32_t x){
+    uint32_t k = 0;
+    while((x >> k) & 1){
+        k++;
+    }
+    return k;
+}
+
+inline uint32_t tree_left(uint32_t x){ return x ^ (1u << (tree_level(x) - 1)); }
+inline uint32_t tree_right(uint32_t x){ return x ^ (3u << (tree_level(x) - 1)); }
+
+inline uint32_t tree_parent(uint32_t x){
+    uint32_t k = tree_level(x);
+    uint32_t b = (x >> (k + 1)) & 1;
+    return (x | (1u << k)) ^ (b << (k + 1));
+}
+
+inline uint32_t tree_sibling(uint32_t x){
+    uint32_t p = tree_parent(x);
+    return x < p ? tree_right(p) : tree_left(p);
+}
+
+// True if node x is in the subtree under node a
+inline bool tree_covers(uint32_t a, uint32_t x){
+    uint32_t k = tree_level(a);
+    return (x >> (k + 1)) == (a >> (k + 1));
+}
+
+class GroupTree
+{
+private:
+    uint64_t epoch = 0;
+    uint32_t width = 1;
+    uint32_t self = 0;
+    std::vector<uint8_t> filled; // Per node, blank nodes have no key
+    std::vector<tree_key> pubs;
+    std::map<uint32_t, tree_key> privates; // Secrets of the nodes this member knows
+    tree_key group_key;
+    bool keyed = false; // Whether group_key is this epoch's, not yet for a new member
+
+    uint32_t root() const { return width - 1; }
+    // SHA-256 of the epoch and the public keys of the filled nodes
+    tree_key context(uint64_t epoch) const;
+    tree_key memberTag(const group_commit& c) const;
+    tree_key confirmTag(const group_commit& c, const tree_key& context) const;
+    void blank(uint32_t node);
+    void blankPath(uint32_t leaf);
+    std::vector<uint32_t> directPath(uint32_t leaf) const;
+    void resolve(uint32_t node, std::vector<uint32_t>& out) const;
+    void applyProposals(const std::vector<tree_key>& adds, const std::vector<uint32_t>& removes, std::vector<uint32_t>* added = nullptr);
+    // Sets the keys of the path from its node up, given its secret
+    void derivePath(const std::vector<uint32_t>& path, size_t from, tree_key secret);
+    // Applies c to this tree, leaving it half updated if c is bad
+    void update(const group_commit& c, bool joining);
+    void process(const group_commit& c, bool joining);
+public:
+    // A group of one, with the given leaf secret
+    explicit GroupTree(const tree_key& leaf);
+    // A member of the tree in state at leaf self, with the key it
+    // published when it was added, before it knows any path secret
+    GroupTree(const group_state& state, uint32_t self, const tree_key& leaf);
+
+    uint64_t Epoch() const { return epoch; }
+    uint32_t Self() const { return self; }
+    uint32_t Members() const;
+    const tree_key& Key() const { return group_key; }
+    group_state State() const;
+
+    // Adds and removes members, then rotates this member's path. Leaves
+    // are filled from the left, so added members learn their index from
+    // Leaves of the new state.
+    group_commit Commit(const std::vector<tree_key>& adds = {}, const std::vector<uint32_t>& removes = {});
+    // Follows another member's commit, which must be tagged under this
+    // epoch's secret
+    void Apply(const group_commit& c) { process(c, false); }
+    // Takes the group key for a member built from the state after c.
+    // The state must come from someone the new member trusts; the
+    // confirmation tag only shows the sender built the same tree.
+    void Join(const group_commit& c) { process(c, true); }
+    // Leaf of every member holding pub
+    std::vector<uint32_t> Leaves(const tree_key& pub) const;
+
+    // Encrypts a report once for the whole group
+    std::string Seal(const std::string& msg) const;
+    // Throws if cdata was not sealed under this epoch's key
+    std::string Open(const std::string& cdata) const;
+};
+
+inline GroupTree::GroupTree(const tree_key& leaf){
+    filled.assign(1, 1);
+    pubs.assign(1, tree_public(leaf));
+    privates[0] = leaf;
+    group_key = tree_kdf(leaf, "SCV-TREE-GROUP");
+    keyed = true;
+}
+
+inline GroupTree::GroupTree(const group_state& state, uint32_t self, const tree_key& leaf)
+    : epoch(state.epoch), width(state.width), self(self), filled(state.filled), pubs(state.pubs){
+    if(width == 0 || (width & (width - 1)) || filled.size() != 2 * width - 1 || pubs.size() != filled.size()
+        || self >= width || !filled[2 * self] || !(pubs[2 * self] == tree_public(leaf))){
+        throw std::runtime_error("Leaf does not match the group state");
+    }
+    privates[2 * self] = leaf;
+    std::memset(group_key.bytes, 0, TREE_KEY_BYTES);
+}
+
+inline uint32_t GroupTree::Members() const{
+    uint32_t n = 0;
+    for(uint32_t i = 0; i < width; i++){
+        n += filled[2 * i];
+    }
+    return n;
+}
+
+inline group_state GroupTree::State() const{
+    return group_state{epoch, width, filled, pubs};
+}
+
+inline tree_key GroupTree::context(uint64_t epoch) const{
+    std::string in;
+    tree_put(in, epoch, 8);
+    tree_put(in, width, 4);
+    for(size_t x = 0; x < filled.size(); x++){
+        tree_put(in, filled[x], 1);
+        if(filled[x]){
+            tree_put(in, pubs[x].bytes, TREE_KEY_BYTES);
+        }
+    }
+    tree_key out;
+    unsigned int n = TREE_KEY_BYTES;
+    if(EVP_Digest(in.data(), in.size(), out.bytes, &n, EVP_sha256(), nullptr) != 1){
+        throw std::runtime_error("Could not hash the group state");
+    }
+    return out;
+}
+
+inline tree_key GroupTree::memberTag(const group_commit& c) const{
+    std::string transcript = tree_transcript(c);
+    transcript.append(reinterpret_cast<const char*>(c.confirm.bytes), TREE_KEY_BYTES);
+    return tree_kdf(tree_kdf(group_key, "SCV-TREE-MEMBER"), transcript);
+}
+
+inline tree_key GroupTree::confirmTag(const group_commit& c, const tree_key& context) const{
+    std::string transcript = tree_transcript(c);
+    transcript.append(reinterpret_cast<const char*>(context.bytes), TREE_KEY_BYTES);
+    return tree_kdf(tree_kdf(group_key, "SCV-TREE-CONFIRM"), transcript);
+}
+
+inline std::vector<uint32_t> GroupTree::Leaves(const tree_key& pub) const{
+    std::vector<uint32_t> leaves;
+    for(uint32_t i = 0; i < width; i++){
+        if(filled[2 * i] && pubs[2 * i] == pub){
+            leaves.push_back(i);
+        }
+    }
+    return leaves;
+}
+
+inline void GroupTree::blank(uint32_t node){
+    filled[node] = 0;
+    privates.erase(node);
+}
+
+inline void GroupTree::blankPath(uint32_t leaf){
+    for(uint32_t x : directPath(leaf)){
+        blank(x);
+    }
+}
+
+inline std::vector<uint32_t> GroupTree::directPath(uint32_t leaf) const{
+    std::vector<uint32_t> path;
+    for(uint32_t x = 2 * leaf; x != root(); ){
+        x = tree_parent(x);
+        path.push_back(x);
+    }
+    return path;
+}
+
+// The fewest filled nodes covering every member under node
+inline void GroupTree::resolve(uint32_t node, std::vector<uint32_t>& out) const{
+    if(filled[node]){
+        out.push_back(node);
+    }else if(tree_level(node) > 0){
+        resolve(tree_left(node), out);
+        resolve(tree_right(node), out);
+    }
+}
+
+inline void GroupTree::applyProposals(const std::vector<tree_key>& adds, const std::vector<uint32_t>& removes, std::vector<uint32_t>* added){
+    for(uint32_t leaf : removes){
+        if(leaf >= width || !filled[2 * leaf]){
+            throw std::runtime_error("Removing a member who is not in the group");
+        }
+        blank(2 * leaf);
+        blankPath(leaf);
+    }
+    uint32_t leaf = 0;
+    for(auto& pub : adds){
+        while(leaf < width && filled[2 * leaf]){
+            leaf++;
+        }
+        if(leaf == width){
+            // Double the tree; the old one becomes the left half
+            width *= 2;
+            filled.resize(2 * width - 1, 0);
+            pubs.resize(2 * width - 1);
+        }
+        filled[2 * leaf] = 1;
+        pubs[2 * leaf] = pub;
+        blankPath(leaf);
+        if(added != nullptr){
+            added->push_back(leaf);
+        }
+    }
+}
+
+inline void GroupTree::derivePath(const std::vector<uint32_t>& path, size_t from, tree_key secret){
+    for(size_t i = from; i < path.size(); i++){
+        if(i > from){
+            secret = tree_kdf(secret, "SCV-TREE-PATH");
+        }
+        tree_key pri = tree_kdf(secret, "SCV-TREE-NODE");
+        filled[path[i]] = 1;
+        pubs[path[i]] = tree_public(pri);
+        privates[path[i]] = pri;
+    }
+    group_key = tree_kdf(secret, "SCV-TREE-GROUP");
+}
+
+inline group_commit GroupTree::Commit(const std::vector<tree_key>& adds, const std::vector<uint32_t>& removes){
+    if(std::find(removes.begin(), removes.end(), self) != removes.end()){
+        throw std::runtime_error("A member can not remove itself");
+    }
+    group_commit c;
+    c.sender = self;
+    c.epoch = epoch + 1;
+    c.adds = adds;
+    c.removes = removes;
+    tree_key old_key = group_key;
+    applyProposals(adds, removes);
+
+    tree_key leaf;
+    tree_random(leaf);
+    privates[2 * self] = leaf;
+    pubs[2 * self] = tree_public(leaf);
+    c.leaf = pubs[2 * self];
+
+    // The whole new tree is known before anything is sealed to it
+    std::vector<uint32_t> path = directPath(self);
+    std::vector<tree_key> secrets(path.size());
+    for(size_t i = 0; i < path.size(); i++){
+        if(i == 0){
+            tree_random(secrets[i]);
+        }else{
+            secrets[i] = tree_kdf(secrets[i - 1], "SCV-TREE-PATH");
+        }
+        tree_key pri = tree_kdf(secrets[i], "SCV-TREE-NODE");
+        tree_path_node node;
+        node.pub = tree_public(pri);
+        filled[path[i]] = 1;
+        pubs[path[i]] = node.pub;
+        privates[path[i]] = pri;
+        c.path.push_back(std::move(node));
+    }
+    tree_key ctx = context(c.epoch);
+
+    uint32_t below = 2 * self;
+    for(size_t i = 0; i < path.size(); i++){
+        tree_path_node& node = c.path[i];
+        std::vector<uint32_t> res;
+        resolve(tree_sibling(below), res);
+        tree_key eph;
+        tree_random(eph);
+        node.ephemeral = tree_public(eph);
+        uint8_t nonce[TREE_NONCE_BYTES] = {0};
+        for(uint32_t r : res){
+            tree_sealed s;
+            s.node = r;
+            tree_key key = tree_seal_key(tree_dh(eph, pubs[r]), node.ephemeral, pubs[r], ctx);
+            tree_aead(true, key, nonce, secrets[i].bytes, TREE_KEY_BYTES, s.box);
+            node.sealed.push_back(s);
+        }
+        below = path[i];
+    }
+    group_key = path.empty() ? tree_kdf(leaf, "SCV-TREE-GROUP") : tree_kdf(secrets.back(), "SCV-TREE-GROUP");
+    c.confirm = confirmTag(c, ctx);
+    std::swap(group_key, old_key);
+    c.tag = memberTag(c);
+    group_key = old_key;
+    epoch = c.epoch;
+    return c;
+}
+
+// A bad commit is only found out once the tree has been changed, so it
+// is applied to a copy that replaces this one when it checks out
+inline void GroupTree::process(const group_commit& c, bool joining){
+    GroupTree next(*this);
+    next.update(c, joining);
+    *this = std::move(next);
+}
+
+inline void GroupTree::update(const group_commit& c, bool joining){
+    if(c.sender == self){
+        throw std::runtime_error("A member can not apply its own commit");
+    }
+    if(joining ? c.epoch != epoch : c.epoch != epoch + 1){
+        throw std::runtime_error("Commit is not for the next epoch");
+    }
+    if(!joining){
+        if(!keyed){
+            throw std::runtime_error("This member has not joined the group");
+        }
+        if(!tree_tag_equal(c.tag, memberTag(c))){
+            throw std::runtime_error("Commit is not from a member of this epoch");
+        }
+        applyProposals(c.adds, c.removes);
+        if(std::find(c.removes.begin(), c.removes.end(), self) != c.removes.end()){
+            throw std::runtime_error("This member was removed from the group");
+        }
+    }
+    if(c.sender >= width || !filled[2 * c.sender]){
+        throw std::runtime_error("Commit from a member who is not in the group");
+    }
+    std::vector<uint32_t> path = directPath(c.sender);
+    if(path.size() != c.path.size()){
+        throw std::runtime_error("Commit path does not fit the tree");
+    }
+    filled[2 * c.sender] = 1;
+    pubs[2 * c.sender] = c.leaf;
+    for(size_t i = 0; i < path.size(); i++){
+        filled[path[i]] = 1;
+        pubs[path[i]] = c.path[i].pub;
+        privates.erase(path[i]);
+    }
+    tree_key ctx = context(c.epoch);
+
+    // The lowest node on the sender's path above this member was sealed
+    // to a node this member knows
+    size_t i = 0;
+    while(i < path.size() && !tree_covers(path[i], 2 * self)){
+        i++;
+    }
+    if(i == path.size()){
+        throw std::runtime_error("Commit path does not reach this member");
+    }
+    for(auto& s : c.path[i].sealed){
+        auto known = privates.find(s.node);
+        if(known == privates.end()){
+            continue;
+        }
+        uint8_t nonce[TREE_NONCE_BYTES] = {0};
+        tree_key key = tree_seal_key(tree_dh(known->second, c.path[i].ephemeral), c.path[i].ephemeral, pubs[s.node], ctx);
+        tree_key secret;
+        if(!tree_aead(false, key, nonce, s.box, TREE_KEY_BYTES, secret.bytes)){
+            throw std::runtime_error("Path secret does not open");
+        }
+        derivePath(path, i, secret);
+        if(!(pubs[path[i]] == c.path[i].pub)){
+            throw std::runtime_error("Path secret does not match the sender's key");
+        }
+        if(!tree_tag_equal(c.confirm, confirmTag(c, ctx))){
+            throw std::runtime_error("Commit does not confirm this tree");
+        }
+        epoch = c.epoch;
+        keyed = true;
+        return;
+    }
+    throw std::runtime_error("No path secret sealed to this member");
+}
+
+inline std::string GroupTree::Seal(const std::string& msg) const{
+    std::string out(TREE_NONCE_BYTES + msg.size() + TREE_TAG_BYTES, '\0');
+    uint8_t* p = reinterpret_cast<uint8_t*>(&out[0]);
+    if(RAND_bytes(p, TREE_NONCE_BYTES) != 1
+        || !tree_aead(true, group_key, p, reinterpret_cast<const uint8_t*>(msg.data()), msg.size(), p + TREE_NONCE_BYTES)){
+        throw std::runtime_error("Could not seal a group message");
+    }
+    return out;
+}
+
+inline std::string GroupTree::Open(const std::string& cdata) const{
+    if(cdata.size() < TREE_NONCE_BYTES + TREE_TAG_BYTES){
+        throw std::runtime_error("Group message is too short");
+    }
+    std::string msg(cdata.size() - TREE_NONCE_BYTES - TREE_TAG_BYTES, '\0');
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(cdata.data());
+    if(!tree_aead(false, group_key, p, p + TREE_NONCE_BYTES, msg.size(), reinterpret_cast<uint8_t*>(&msg[0]))){
+        throw std::runtime_error("Group message does not open under this epoch's key");
+    }
+    return msg;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+// Hints that let a recipient pick its own messages out of a shared
+// mailbox without a pairing per message. Each user draws a hint key per
+// day and hands it to the people it meets along with its contact data.
+// A sender tags a message with a random nonce and the first 8 bytes of
+// AES-128(hint key, nonce); the recipient encrypts every nonce of a day
+// under its own key in one pass and only tries decrypt() on the few
+// messages whose tag matches. Without the key, tags look random and say
+// nothing about who a message is for.
+//
+// Hint keys are drawn apart from day keys, since day keys are published
+// after a positive test and would give away whose mail was whose. Days
+// are counted as token_day counts them.
+
+const static size_t HINT_NONCE_BYTES = 16;
+
+struct hint_key{
+    uint32_t day;
+    uint8_t key[16];
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(day, key);
+    }
+};
+typedef struct hint_key hint_key;
+
+// Sent in the clear next to a mailbox message
+struct hint{
+    uint32_t day;
+    uint8_t nonce[HINT_NONCE_BYTES];
+    uint64_t tag;
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(day, nonce, tag);
+    }
+};
+typedef struct hint hint;
+
+inline hint_key new_hint_key(uint32_t day){
+    hint_key k;
+    k.day = day;
+    if(RAND_bytes(k.key, sizeof(k.key)) != 1){
+        throw std::runtime_error("Out of randomness for a hint key");
+    }
+    return k;
+}
+
+// Tags of count nonces, 16 bytes apart at nonces, under k
+inline void hint_tags(const hint_key& k, const uint8_t* nonces, size_t count, uint64_t* tags){
+    std::vector<uint8_t> blocks(count * HINT_NONCE_BYTES);
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int n = 0;
+    bool ok = ctx != nullptr && EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), nullptr, k.key, nullptr) == 1
+        && EVP_CIPHER_CTX_set_padding(ctx, 0) == 1
+        && (count == 0 || EVP_EncryptUpdate(ctx, blocks.data(), &n, nonces, static_cast<int>(blocks.size())) == 1);
+    EVP_CIPHER_CTX_free(ctx);
+    if(!ok){
+        throw std::runtime_error("Could not compute hint tags");
+    }
+    for(size_t i = 0; i < count; i++){
+        std::memcpy(&tags[i], &blocks[i * HINT_NONCE_BYTES], sizeof(uint64_t));
+    }
+}
+
+// A hint for a message to the holder of k
+inline hint make_hint(const hint_key& k){
+    hint h;
+    h.day = k.day;
+    if(RAND_bytes(h.nonce, sizeof(h.nonce)) != 1){
+        throw std::runtime_error("Out of randomness for a hint");
+    }
+    hint_tags(k, h.nonce, 1, &h.tag);
+    return h;
+}
+
+// A user's hint keys over the last window days, to hand out and to scan
+// the mailbox with
+class HintKeys
+{
+private:
+    std::map<uint32_t, hint_key> keys;
+    uint32_t window; // Days of keys kept
+public:
+    HintKeys(uint32_t window = 14) : window(window) {}
+
+    const hint_key& Key(uint32_t day);
+    // Forgets keys older than the window ending on day
+    void Expire(uint32_t day);
+    // Indices of the hints tagged for this user, in order
+    std::vector<size_t> Scan(const std::vector<hint>& hints) const;
+};
+
+inline const hint_key& HintKeys::Key(uint32_t day){
+    auto it = keys.find(day);
+    if(it == keys.end()){
+        it = keys.emplace(day, new_hint_key(day)).first;
+    }
+    return it->second;
+}
+
+inline void HintKeys::Expire(uint32_t day){
+    while(!keys.empty() && keys.begin()->first + window <= day){
+        keys.erase(keys.begin());
+    }
+}
+
+inline std::vector<size_t> HintKeys::Scan(const std::vector<hint>& hints) const{
+    // Gather each day's nonces so each key runs over them in one pass
+    std::map<uint32_t, std::vector<size_t>> by_day;
+    for(size_t i = 0; i < hints.size(); i++){
+        if(keys.count(hints[i].day)){
+            by_day[hints[i].day].push_back(i);
+        }
+    }
+    std::vector<size_t> found;
+    std::vector<uint8_t> nonces;
+    std::vector<uint64_t> tags;
+    for(auto& day : by_day){
+        auto& idx = day.second;
+        nonces.resize(idx.size() * HINT_NONCE_BYTES);
+        tags.resize(idx.size());
+        for(size_t j = 0; j < idx.size(); j++){
+            std::memcpy(&nonces[j * HINT_NONCE_BYTES], hints[idx[j]].nonce, HINT_NONCE_BYTES);
+        }
+        hint_tags(keys.at(day.first), nonces.data(), idx.size(), tags.data());
+        for(size_t j = 0; j < idx.size(); j++){
+            if(tags[j] == hints[idx[j]].tag){
+                found.push_back(idx[j]);
+            }
+        }
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
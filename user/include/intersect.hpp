@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+// Intersection of sorted 32 bit keys with SIMD block compares.
+//
+// Both sides are walked in blocks; every key of a block of a is
+// compared against every key of the current block of b by rotating b
+// through the lanes, and the block with the smaller maximum moves on
+// (a on a tie, which keeps runs of equal keys in a from being skipped).
+// The result marks each key of a that is somewhere in b. Kernels for
+// AVX-512 and AVX2 are picked at run time, with a scalar fallback, so
+// the library still builds without -mavx2.
+
+// Counting sort of the n pairs at v on bits [shift, shift + bits) into
+// tmp, leaving in count where each bucket ends
+inline void radix_pass(const uint64_t* v, uint64_t* tmp, size_t n, int shift, int bits, size_t* count){
+    size_t buckets = size_t(1) << bits;
+    uint64_t mask = buckets - 1;
+    std::fill(count, count + buckets, 0);
+    for(size_t i = 0; i < n; i++){
+        count[(v[i] >> shift) & mask]++;
+    }
+    size_t sum = 0;
+    for(size_t b = 0; b < buckets; b++){
+        size_t c = count[b];
+        count[b] = sum;
+        sum += c;
+    }
+    for(size_t i = 0; i < n; i++){
+        tmp[count[(v[i] >> shift) & mask]++] = v[i];
+    }
+}
+
+// Sorts (key, value) pairs packed as key << 32 | value by key. A pass
+// on the top 11 bits splits the pairs into buckets small enough to stay
+// in cache, which are then sorted on the other 21 bits in parallel.
+inline void radix_sort_pairs(std::vector<uint64_t>& v){
+    std::vector<uint64_t> tmp(v.size());
+    std::vector<size_t> end(2048);
+    radix_pass(v.data(), tmp.data(), v.size(), 53, 11, end.data());
+    #pragma omp parallel for schedule(dynamic, 16)
+    for(int b = 0; b < 2048; b++){
+        size_t count[2048];
+        size_t first = b == 0 ? 0 : end[b - 1];
+        size_t n = end[b] - first;
+        radix_pass(&tmp[first], &v[first], n, 32, 11, count);
+        radix_pass(&v[first], &tmp[first], n, 43, 10, count);
+    }
+    v.swap(tmp);
+}
+
+inline void intersect_mask_scalar(const uint32_t* a, size_t na, size_t i,
+    const uint32_t* b, size_t nb, size_t j, uint8_t* hit){
+    while(i < na && j < nb){
+        if(a[i] < b[j]){
+            i++;
+        }else if(a[i] > b[j]){
+            j++;
+        }else{
+            hit[i++] = 1; // b[j] may match the next a too
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+inline void intersect_mask_avx2(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint8_t* hit){
+    size_t i = 0, j = 0;
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while(i + 8 <= na && j + 8 <= nb){
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i eq = _mm256_cmpeq_epi32(va, vb);
+        for(int r = 1; r < 8; r++){
+            vb = _mm256_permutevar8x32_epi32(vb, rotate);
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(va, vb));
+        }
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        while(mask){
+            int lane = __builtin_ctz(mask);
+            hit[i + lane] = 1;
+            mask &= mask - 1;
+        }
+        if(a[i + 7] > b[j + 7]){
+            j += 8;
+        }else{
+            i += 8;
+        }
+    }
+    intersect_mask_scalar(a, na, i, b, nb, j, hit);
+}
+
+__attribute__((target("avx512f")))
+inline void intersect_mask_avx512(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint8_t* hit){
+    size_t i = 0, j = 0;
+    while(i + 16 <= na && j + 16 <= nb){
+        __m512i va = _mm512_loadu_si512(a + i);
+        __m512i vb = _mm512_loadu_si512(b + j);
+        __mmask16 mask = _mm512_cmpeq_epi32_mask(va, vb);
+        for(int r = 1; r < 16; r++){
+            vb = _mm512_alignr_epi32(vb, vb, 1);
+            mask |= _mm512_cmpeq_epi32_mask(va, vb);
+        }
+        uint32_t m = mask;
+        while(m){
+            int lane = __builtin_ctz(m);
+            hit[i + lane] = 1;
+            m &= m - 1;
+        }
+        if(a[i + 15] > b[j + 15]){
+            j += 16;
+        }else{
+            i += 16;
+        }
+    }
+    intersect_mask_scalar(a, na, i, b, nb, j, hit);
+}
+
+// Sets hit[i] for every a[i] found in b. Both must be sorted and hit
+// zeroed; keys may repeat on either side.
+inline void intersect_mask(const uint32_t* a, size_t na, const uint32_t* b, size_t nb, uint8_t* hit){
+    static const int level = __builtin_cpu_supports("avx512f") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+    if(level == 2){
+        intersect_mask_avx512(a, na, b, nb, hit);
+    }else if(level == 1){
+        intersect_mask_avx2(a, na, b, nb, hit);
+    }else{
+        intersect_mask_scalar(a, na, 0, b, nb, 0, hit);
+    }
+}
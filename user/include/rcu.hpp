@@ -0,0 +1,143 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+#include <functional>
+
+// Epoch based reclamation. Readers mark the epoch they entered in and
+// never take a lock; writers publish a new version with an atomic
+// exchange and retire the old one, which is freed once every reader
+// that could still see it has left.
+class Epoch
+{
+private:
+    const static int SLOTS = 256;
+    const static int BATCH = 32; // Retired objects kept before collecting
+
+    struct alignas(64) slot{
+        std::atomic<uint64_t> epoch{0}; // 0 while the owner is not reading
+        std::atomic<bool> owned{false};
+        int depth = 0;
+    };
+
+    // Releases a thread's slot when the thread exits
+    struct owner{
+        slot* s = nullptr;
+        ~owner(){
+            if(s){
+                s->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    std::atomic<uint64_t> global{1};
+    slot slots[SLOTS];
+    std::mutex retire_lock;
+    std::vector<std::pair<uint64_t, std::function<void()>>> retired;
+
+    Epoch() = default;
+    slot& mine();
+    uint64_t oldest();
+public:
+    static Epoch& Global(){
+        static Epoch e;
+        return e;
+    }
+
+    void Enter();
+    void Exit();
+    // Runs free once no reader can still hold what it releases
+    void Retire(std::function<void()> free);
+    void Collect();
+
+    class Guard{
+    public:
+        Guard(){ Epoch::Global().Enter(); }
+        ~Guard(){ Epoch::Global().Exit(); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+};
+
+inline Epoch::slot& Epoch::mine(){
+    static thread_local owner o;
+    if(!o.s){
+        for(int i = 0; i < SLOTS && !o.s; i++){
+            bool free = false;
+            if(slots[i].owned.compare_exchange_strong(free, true)){
+                o.s = &slots[i];
+                o.s->depth = 0;
+            }
+        }
+        if(!o.s){
+            throw std::runtime_error("Too many reader threads");
+        }
+    }
+    return *o.s;
+}
+
+inline void Epoch::Enter(){
+    slot& s = mine();
+    if(s.depth++ == 0){
+        s.epoch.store(global.load());
+    }
+}
+
+inline void Epoch::Exit(){
+    slot& s = mine();
+    if(--s.depth == 0){
+        s.epoch.store(0, std::memory_order_release);
+    }
+}
+
+// Oldest epoch a reader is still in
+inline uint64_t Epoch::oldest(){
+    uint64_t min = UINT64_MAX;
+    for(int i = 0; i < SLOTS; i++){
+        uint64_t e = slots[i].epoch.load();
+        if(e != 0 && e < min){
+            min = e;
+        }
+    }
+    return min;
+}
+
+inline void Epoch::Retire(std::function<void()> free){
+    bool full;
+    {
+        std::lock_guard<std::mutex> l(retire_lock);
+        // Readers entering after this bump can only see the new version
+        retired.push_back(std::make_pair(global.fetch_add(1), std::move(free)));
+        full = retired.size() >= BATCH;
+    }
+    if(full){
+        Collect();
+    }
+}
+
+inline void Epoch::Collect(){
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> l(retire_lock);
+        uint64_t min = oldest();
+        size_t kept = 0;
+        for(size_t i = 0; i < retired.size(); i++){
+            if(retired[i].first < min){
+                ready.push_back(std::move(retired[i].second));
+            }else{
+                if(kept != i){
+                    retired[kept] = std::move(retired[i]);
+                }
+                kept++;
+            }
+        }
+        retired.resize(kept);
+    }
+    for(auto& f : ready){
+        f();
+    }
+}
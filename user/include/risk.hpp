@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include "contact.hpp"
+#include "csr.hpp"
+
+// Exposure risk propagated over weighted contacts.
+//
+// Each edge carries a transmission hazard w = beta * (duration + floor).
+// A vertex's chance of infection after a round is
+//
+//   p(v) = 1 - (1 - seed(v)) * exp(-sum over u of w(u, v) * p(u))
+//
+// so every round is one sparse matrix vector product over the CSR graph
+// followed by an elementwise update. Rows run in parallel with OpenMP
+// and the inner sums are written to vectorize.
+struct risk_params{
+    // Hazard per second of contact; 15 minutes gives about 10%
+    float beta = 1.17e-4f;
+    // Seconds added to every contact so instant ones still count
+    float floor = 60.0f;
+    // Rounds of propagation, i.e. the longest chain considered
+    int iterations = 4;
+};
+typedef struct risk_params risk_params;
+
+// Hazard of every edge of g, in step with g.edges. Contacts carry only
+// their duration; proximity would scale beta per edge once recorded.
+inline std::vector<float> exposure_weights(const csr_graph& g, const risk_params& params = risk_params()){
+    std::vector<float> w(g.edges.size());
+    const contact_interval* t = g.times.data();
+    int64_t n = static_cast<int64_t>(w.size());
+    #pragma omp parallel for simd schedule(static)
+    for(int64_t e = 0; e < n; e++){
+        float duration = t[e].end == UINT32_MAX ? 0.0f : static_cast<float>(t[e].end - t[e].begin);
+        w[e] = params.beta * (duration + params.floor);
+    }
+    return w;
+}
+
+// y = W x over the rows of g
+inline void spmv(const csr_graph& g, const std::vector<float>& w, const float* x, float* y){
+    const uint64_t* offsets = g.offsets.data();
+    const uint32_t* edges = g.edges.data();
+    const float* vals = w.data();
+    int64_t n = g.Vertices();
+    #pragma omp parallel for schedule(dynamic, 4096)
+    for(int64_t u = 0; u < n; u++){
+        float sum = 0.0f;
+        uint64_t end = offsets[u + 1];
+        #pragma omp simd reduction(+:sum)
+        for(uint64_t e = offsets[u]; e < end; e++){
+            sum += vals[e] * x[edges[e]];
+        }
+        y[u] = sum;
+    }
+}
+
+// Infection probability of every vertex given the probability each
+// was infected to begin with
+inline std::vector<float> exposure_risk(const csr_graph& g, const std::vector<float>& w,
+    const std::vector<float>& seed, int iterations){
+    int64_t n = g.Vertices();
+    std::vector<float> p(seed);
+    p.resize(n, 0.0f);
+    std::vector<float> s(n);
+    for(int it = 0; it < iterations; it++){
+        spmv(g, w, p.data(), s.data());
+        #pragma omp parallel for simd schedule(static)
+        for(int64_t v = 0; v < n; v++){
+            float q = v < (int64_t) seed.size() ? seed[v] : 0.0f;
+            p[v] = 1.0f - (1.0f - q) * std::exp(-s[v]);
+        }
+    }
+    return p;
+}
+
+// Contacts of c ranked by risk given confirmed cases, highest first,
+// so notifications can go out in that order
+inline std::vector<std::pair<std::string, float>> exposure_ranking(const Contact& c,
+    const std::vector<std::string>& infected, const risk_params& params = risk_params()){
+    csr_graph g = to_csr(c);
+    std::vector<float> seed(g.Vertices(), 0.0f);
+    for(auto& uid : infected){
+        int v = c.Vertex(uid);
+        if(v >= 0 && v < (int) seed.size()){
+            seed[v] = 1.0f;
+        }
+    }
+
+    auto p = exposure_risk(g, exposure_weights(g, params), seed, params.iterations);
+    std::vector<std::pair<std::string, float>> rez;
+    for(int v = 0; v < (int) p.size(); v++){
+        if(seed[v] == 0.0f && p[v] > 0.0f){
+            rez.push_back(std::make_pair(c.UID(v), p[v]));
+        }
+    }
+    std::sort(rez.begin(), rez.end(), [](const std::pair<std::string, float>& a, const std::pair<std::string, float>& b){
+        return a.second > b.second;
+    });
+    return rez;
+}
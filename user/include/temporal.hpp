@@ -0,0 +1,117 @@
+#pragma once
+
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include "contact.hpp"
+
+// Arrival time of a vertex that can not be reached
+const static uint32_t NEVER = UINT32_MAX;
+
+// Earliest time each vertex can be reached from any of sources,
+// starting at t0 and only following time-respecting paths. An edge with
+// interval [begin, end] can be crossed at any time t <= end and reaches
+// the other side at max(t, begin), so arrival times never decrease
+// along a path and each vertex is settled once in arrival order:
+// O(E log V). If copies is given, copies[v] is the next vertex of the
+// same person, around a ring, and reaching one reaches them all.
+inline std::vector<uint32_t> earliest_arrival(const std::vector<std::vector<int>>& graph,
+    const std::vector<std::vector<contact_interval>>& times, const std::vector<int>& sources, uint32_t t0,
+    const std::vector<int>& copies = std::vector<int>()){
+    std::vector<uint32_t> arrival(graph.size(), NEVER);
+
+    typedef std::pair<uint32_t, int> entry;
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry>> q;
+    for(int source : sources){
+        if(source >= 0 && source < (int) graph.size() && arrival[source] == NEVER){
+            arrival[source] = t0;
+            q.push(entry(t0, source));
+        }
+    }
+    while(!q.empty()){
+        uint32_t t = q.top().first;
+        int u = q.top().second;
+        q.pop();
+        if(t != arrival[u]){
+            continue; // Stale entry
+        }
+        if(!copies.empty() && t < arrival[copies[u]]){
+            arrival[copies[u]] = t;
+            q.push(entry(t, copies[u]));
+        }
+        for(int i = 0; i < (int) graph[u].size(); i++){
+            const contact_interval& w = times[u][i];
+            if(w.end < t){
+                continue; // Contact was over before u was exposed
+            }
+            uint32_t a = std::max(t, w.begin);
+            int v = graph[u][i];
+            if(a < arrival[v]){
+                arrival[v] = a;
+                q.push(entry(a, v));
+            }
+        }
+    }
+    return arrival;
+}
+
+inline std::vector<uint32_t> earliest_arrival(const std::vector<std::vector<int>>& graph,
+    const std::vector<std::vector<contact_interval>>& times, int source, uint32_t t0){
+    return earliest_arrival(graph, times, std::vector<int>{source}, t0);
+}
+
+// Rings of the vertices of each person for earliest_arrival: a user
+// met more than once has a vertex per meeting
+inline std::vector<int> contact_copies(const Contact& c){
+    int n = static_cast<int>(c.Graph().size());
+    std::vector<int> copies(n);
+    std::map<std::string, int> first, last;
+    for(int v = 0; v < n; v++){
+        copies[v] = v;
+        std::string who = c.UID(v);
+        if(who.empty()){
+            continue;
+        }
+        auto it = last.find(who);
+        if(it == last.end()){
+            first[who] = v;
+        }else{
+            copies[it->second] = v;
+            copies[v] = first[who];
+        }
+        last[who] = v;
+    }
+    return copies;
+}
+
+// Everyone that could have been exposed by uid since t0, along with
+// the earliest time they could have been exposed. Every vertex of uid
+// is a source, and exposure at one meeting with someone carries on to
+// the people they met at the others.
+inline std::map<std::string, uint32_t> exposed_contacts(const Contact& c, const std::string& uid, uint32_t t0){
+    std::map<std::string, uint32_t> rez;
+    std::vector<int> sources = c.Vertices(uid);
+    if(sources.empty()){
+        return rez;
+    }
+
+    auto arrival = earliest_arrival(c.Graph(), c.Times(), sources, t0, contact_copies(c));
+    for(int v = 0; v < (int) arrival.size(); v++){
+        std::string who = c.UID(v);
+        if(arrival[v] == NEVER || who == uid){
+            continue;
+        }
+        auto it = rez.find(who);
+        if(it == rez.end()){
+            rez[who] = arrival[v];
+        }else{
+            it->second = std::min(it->second, arrival[v]);
+        }
+    }
+    return rez;
+}
@@ -0,0 +1,534 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <dirent.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include "contact.hpp"
+#include "intersect.hpp"
+
+// Rolling proximity tokens. Each day a user draws a fresh random day
+// key and broadcasts AES-128(day key, interval) for every ten minute
+// interval of the day, so tokens can not be linked to each other or to
+// the user. Phones record the tokens they hear in an append-only log
+// per day. When a user tests positive their day keys are published,
+// and anyone can expand them back into tokens and match their log in
+// bulk, turning each match into a Contact edge.
+
+const static uint32_t TOKEN_INTERVAL = 600;  // Seconds a token is broadcast
+const static uint32_t TOKENS_PER_DAY = 86400 / TOKEN_INTERVAL;
+const static uint32_t TOKEN_TOLERANCE = 12;  // Intervals of clock skew allowed when matching
+
+struct rolling_token{
+    uint64_t hi;
+    uint64_t lo;
+
+    bool operator<(const rolling_token& o) const { return hi != o.hi ? hi < o.hi : lo < o.lo; }
+    bool operator==(const rolling_token& o) const { return hi == o.hi && lo == o.lo; }
+    bool operator!=(const rolling_token& o) const { return !(*this == o); }
+};
+typedef struct rolling_token rolling_token;
+
+struct day_key{
+    uint32_t day; // Days since the epoch
+    uint8_t key[16];
+
+    template<class Archive>
+    void serialize(Archive & archive){
+        archive(day, key);
+    }
+};
+typedef struct day_key day_key;
+
+// A token heard from another phone over [begin, end]
+struct sighting{
+    rolling_token token;
+    uint32_t begin;
+    uint32_t end;
+};
+typedef struct sighting sighting;
+
+inline uint32_t token_day(uint32_t t){
+    return t / 86400;
+}
+
+inline uint32_t token_interval(uint32_t t){
+    return t / TOKEN_INTERVAL;
+}
+
+inline day_key new_day_key(uint32_t day){
+    day_key k;
+    k.day = day;
+    if(RAND_bytes(k.key, sizeof(k.key)) != 1){
+        throw std::runtime_error("Out of randomness for a day key");
+    }
+    return k;
+}
+
+// Who a published day key stands for in the contact graph. Day keys of
+// one person are unlinkable, so each is its own vertex.
+inline std::string key_uid(const day_key& k){
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256(k.key, sizeof(k.key), hash);
+    char hex[33];
+    for(int i = 0; i < 16; i++){
+        sprintf(hex + 2 * i, "%02x", hash[i]);
+    }
+    return hex;
+}
+
+// AES-128 in ECB mode is a PRF over single blocks. One context is
+// reused for every key it expands, and with AES-NI a day's tokens cost
+// well under a microsecond.
+class TokenPRF
+{
+private:
+    EVP_CIPHER_CTX* ctx;
+    std::vector<uint8_t> blocks;
+public:
+    TokenPRF() : ctx(EVP_CIPHER_CTX_new()) {
+        if(!ctx){
+            throw std::runtime_error("Could not allocate a cipher context");
+        }
+    }
+    ~TokenPRF() { EVP_CIPHER_CTX_free(ctx); }
+    TokenPRF(const TokenPRF&) = delete;
+    TokenPRF& operator=(const TokenPRF&) = delete;
+
+    // Tokens of intervals first .. first + count - 1 of k's day
+    void Expand(const day_key& k, uint32_t first, uint32_t count, rolling_token* out);
+};
+
+inline void TokenPRF::Expand(const day_key& k, uint32_t first, uint32_t count, rolling_token* out){
+    if(count == 0){
+        return;
+    }
+    // Block i is the label "SCV-RT", padding and the absolute interval
+    blocks.assign(16 * count, 0);
+    for(uint32_t i = 0; i < count; i++){
+        uint8_t* b = &blocks[16 * i];
+        memcpy(b, "SCV-RT", 6);
+        uint32_t interval = k.day * TOKENS_PER_DAY + first + i;
+        memcpy(b + 12, &interval, sizeof(interval));
+    }
+    int len = 0;
+    if(EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), nullptr, k.key, nullptr) != 1
+        || EVP_CIPHER_CTX_set_padding(ctx, 0) != 1
+        || EVP_EncryptUpdate(ctx, reinterpret_cast<uint8_t*>(out), &len, blocks.data(), 16 * count) != 1){
+        throw std::runtime_error("Token encryption failed");
+    }
+}
+
+// Every token of k's day, in interval order
+inline std::vector<rolling_token> day_tokens(const day_key& k){
+    std::vector<rolling_token> rez(TOKENS_PER_DAY);
+    TokenPRF prf;
+    prf.Expand(k, 0, TOKENS_PER_DAY, rez.data());
+    return rez;
+}
+
+// Open addressing multimap from tokens to 32 bit values. Tokens are
+// AES outputs, so their low bits already make a good hash. Most lookups
+// are for tokens that are not there, and a bitmap of 16 bits per token
+// small enough to stay in cache turns away nearly all of them before
+// they touch the slots.
+class TokenTable
+{
+private:
+    struct slot{
+        rolling_token token;
+        uint32_t value; // EMPTY if the slot is free
+    };
+    const static uint32_t EMPTY = UINT32_MAX;
+    std::vector<slot> slots;
+    uint64_t mask;
+    std::vector<uint64_t> bits;
+    uint64_t bits_mask;
+
+    bool maybe(const rolling_token& t) const { return bits[(t.hi & bits_mask) >> 6] >> (t.hi & 63) & 1; }
+public:
+    const static uint64_t NONE = UINT64_MAX;
+
+    // Room for count tokens at no more than half load
+    explicit TokenTable(uint64_t count){
+        uint64_t n = 16;
+        while(n < count * 2){
+            n <<= 1;
+        }
+        slots.assign(n, slot{rolling_token{0, 0}, EMPTY});
+        mask = n - 1;
+        bits.assign(n / 8, 0);
+        bits_mask = n * 8 - 1;
+    }
+
+    // value must not be UINT32_MAX
+    void Insert(const rolling_token& t, uint32_t value){
+        uint64_t i = t.lo & mask;
+        while(slots[i].value != EMPTY){
+            i = (i + 1) & mask;
+        }
+        slots[i] = slot{t, value};
+        bits[(t.hi & bits_mask) >> 6] |= 1ULL << (t.hi & 63);
+    }
+    void Prefetch(const rolling_token& t) const { __builtin_prefetch(&slots[t.lo & mask]); }
+    // First slot holding t, or NONE
+    uint64_t Find(const rolling_token& t) const { return maybe(t) ? Next(t, (t.lo - 1) & mask) : NONE; }
+    // Slot holding t after slot i, or NONE
+    uint64_t Next(const rolling_token& t, uint64_t i) const{
+        for(i = (i + 1) & mask; slots[i].value != EMPTY; i = (i + 1) & mask){
+            if(slots[i].token == t){
+                return i;
+            }
+        }
+        return NONE;
+    }
+    uint32_t Value(uint64_t i) const { return slots[i].value; }
+};
+
+// Sides this many times larger than the other are hashed against it
+// rather than sorted. Sorting only pays for itself on sides of nearly
+// equal size: with the bitmap in front of the table, streaming 14M
+// tokens past a 3.6M token table is about three times faster than
+// sorting both.
+const static uint64_t TOKEN_SKEW = 2;
+
+// Index pairs (i, j) with a[i] == b[j], in no particular order.
+//
+// Sides of similar size are radix sorted on the top 32 bits of their
+// tokens and intersected with intersect_mask; only the few marked
+// tokens are then merged and compared in full. When one side is
+// TOKEN_SKEW times smaller it goes into a TokenTable and the other is
+// streamed past it unsorted.
+inline std::vector<std::pair<uint32_t, uint32_t>> intersect_tokens(const std::vector<rolling_token>& a,
+    const std::vector<rolling_token>& b){
+    std::vector<std::pair<uint32_t, uint32_t>> rez;
+    if(a.empty() || b.empty()){
+        return rez;
+    }
+
+    if(a.size() >= TOKEN_SKEW * b.size() || b.size() >= TOKEN_SKEW * a.size()){
+        bool flip = a.size() > b.size();
+        const std::vector<rolling_token>& small = flip ? b : a;
+        const std::vector<rolling_token>& large = flip ? a : b;
+        TokenTable table(small.size());
+        for(uint32_t i = 0; i < small.size(); i++){
+            table.Insert(small[i], i);
+        }
+        for(uint32_t j = 0; j < large.size(); j++){
+            if(j + 16 < large.size()){
+                table.Prefetch(large[j + 16]);
+            }
+            for(uint64_t slot = table.Find(large[j]); slot != TokenTable::NONE; slot = table.Next(large[j], slot)){
+                uint32_t i = table.Value(slot);
+                rez.push_back(flip ? std::make_pair(j, i) : std::make_pair(i, j));
+            }
+        }
+        return rez;
+    }
+
+    auto sorted = [](const std::vector<rolling_token>& v, std::vector<uint64_t>& pairs, std::vector<uint32_t>& keys){
+        pairs.resize(v.size());
+        for(uint32_t i = 0; i < v.size(); i++){
+            pairs[i] = (v[i].hi & 0xffffffff00000000ULL) | i;
+        }
+        radix_sort_pairs(pairs);
+        keys.resize(v.size());
+        for(size_t i = 0; i < v.size(); i++){
+            keys[i] = static_cast<uint32_t>(pairs[i] >> 32);
+        }
+    };
+    std::vector<uint64_t> pa, pb;
+    std::vector<uint32_t> ka, kb;
+    sorted(a, pa, ka);
+    sorted(b, pb, kb);
+    std::vector<uint8_t> ha(a.size(), 0), hb(b.size(), 0);
+    intersect_mask(ka.data(), ka.size(), kb.data(), kb.size(), ha.data());
+    intersect_mask(kb.data(), kb.size(), ka.data(), ka.size(), hb.data());
+
+    std::vector<uint64_t> ma, mb;
+    for(size_t i = 0; i < ha.size(); i++){
+        if(ha[i]){
+            ma.push_back(pa[i]);
+        }
+    }
+    for(size_t j = 0; j < hb.size(); j++){
+        if(hb[j]){
+            mb.push_back(pb[j]);
+        }
+    }
+    // Equal top bits are only candidates, compare whole tokens
+    for(size_t i = 0, j = 0; i < ma.size() && j < mb.size(); ){
+        uint32_t x = ma[i] >> 32, y = mb[j] >> 32;
+        if(x < y){
+            i++;
+        }else if(x > y){
+            j++;
+        }else{
+            size_t ie = i, je = j;
+            while(ie < ma.size() && static_cast<uint32_t>(ma[ie] >> 32) == x){
+                ie++;
+            }
+            while(je < mb.size() && static_cast<uint32_t>(mb[je] >> 32) == x){
+                je++;
+            }
+            for(size_t p = i; p < ie; p++){
+                for(size_t q = j; q < je; q++){
+                    uint32_t ai = static_cast<uint32_t>(ma[p]), bj = static_cast<uint32_t>(mb[q]);
+                    if(a[ai] == b[bj]){
+                        rez.push_back(std::make_pair(ai, bj));
+                    }
+                }
+            }
+            i = ie;
+            j = je;
+        }
+    }
+    return rez;
+}
+
+// The day keys of this phone and the token it broadcasts
+class TokenEngine
+{
+private:
+    std::map<uint32_t, day_key> keys;
+    uint32_t window; // Days of keys kept
+    TokenPRF prf;
+public:
+    TokenEngine(uint32_t window = 14) : window(window) {}
+
+    const day_key& Key(uint32_t day);
+    // What to broadcast at time now
+    rolling_token Broadcast(uint32_t now = static_cast<uint32_t>(std::time(nullptr)));
+    // Day keys from day on, to publish after a positive test
+    std::vector<day_key> Keys(uint32_t day = 0) const;
+    // Forgets keys older than the window ending on day
+    void Expire(uint32_t day);
+};
+
+inline const day_key& TokenEngine::Key(uint32_t day){
+    auto it = keys.find(day);
+    if(it == keys.end()){
+        it = keys.emplace(day, new_day_key(day)).first;
+    }
+    return it->second;
+}
+
+inline rolling_token TokenEngine::Broadcast(uint32_t now){
+    rolling_token t;
+    prf.Expand(Key(token_day(now)), token_interval(now) % TOKENS_PER_DAY, 1, &t);
+    return t;
+}
+
+inline std::vector<day_key> TokenEngine::Keys(uint32_t day) const{
+    std::vector<day_key> rez;
+    for(auto it = keys.lower_bound(day); it != keys.end(); ++it){
+        rez.push_back(it->second);
+    }
+    return rez;
+}
+
+inline void TokenEngine::Expire(uint32_t day){
+    while(!keys.empty() && keys.begin()->first + window <= day){
+        keys.erase(keys.begin());
+    }
+}
+
+// A sighting of a published token
+struct token_match{
+    uint32_t key;      // Index of the day key
+    uint32_t interval; // Interval of the day the token belongs to
+    sighting seen;
+};
+typedef struct token_match token_match;
+
+// Tokens heard by this phone, one append-only log per day. Logs live in
+// memory and, given a directory, also in files named by day there.
+class TokenLog
+{
+private:
+    std::string dir;
+    std::map<uint32_t, std::vector<sighting>> days;
+
+    std::string path(uint32_t day) const { return dir + "/" + std::to_string(day) + ".tokens"; }
+    std::vector<sighting>& load(uint32_t day);
+public:
+    TokenLog(std::string dir = "") : dir(dir) {}
+
+    // Appends sightings, filed by the day they began
+    void Record(const std::vector<sighting>& seen);
+    const std::vector<sighting>& Day(uint32_t day) { return load(day); }
+
+    // Sightings of tokens of the published keys, in any order
+    std::vector<token_match> Match(const std::vector<day_key>& keys);
+    // Adds an edge to c for every key heard, over the span it was heard,
+    // and returns the number of edges added. Resolving keys again adds
+    // nothing unless they were heard over a longer span since.
+    size_t Resolve(const std::vector<day_key>& keys, Contact& c);
+    // Drops logs of days before day, files included
+    void Expire(uint32_t day);
+};
+
+inline std::vector<sighting>& TokenLog::load(uint32_t day){
+    auto it = days.find(day);
+    if(it != days.end()){
+        return it->second;
+    }
+    std::vector<sighting>& log = days[day];
+    if(!dir.empty()){
+        std::ifstream in(path(day), std::ios::binary | std::ios::ate);
+        if(in){
+            std::streamoff bytes = in.tellg();
+            if(bytes % sizeof(sighting)){
+                throw std::runtime_error("Truncated token log " + path(day));
+            }
+            log.resize(bytes / sizeof(sighting));
+            in.seekg(0);
+            in.read(reinterpret_cast<char*>(log.data()), bytes);
+        }
+    }
+    return log;
+}
+
+inline void TokenLog::Record(const std::vector<sighting>& seen){
+    std::map<uint32_t, std::vector<sighting>> by_day;
+    for(auto& s : seen){
+        by_day[token_day(s.begin)].push_back(s);
+    }
+    for(auto& d : by_day){
+        std::vector<sighting>& log = load(d.first);
+        log.insert(log.end(), d.second.begin(), d.second.end());
+        if(!dir.empty()){
+            std::ofstream out(path(d.first), std::ios::binary | std::ios::app);
+            out.write(reinterpret_cast<const char*>(d.second.data()), d.second.size() * sizeof(sighting));
+            if(!out){
+                throw std::runtime_error("Could not append to token log " + path(d.first));
+            }
+        }
+    }
+}
+
+inline std::vector<token_match> TokenLog::Match(const std::vector<day_key>& keys){
+    std::vector<token_match> rez;
+    std::map<uint32_t, std::vector<uint32_t>> by_day;
+    for(uint32_t i = 0; i < keys.size(); i++){
+        by_day[keys[i].day].push_back(i);
+    }
+    // Replayed tokens are heard far from their interval
+    auto add = [&](uint32_t k, uint32_t i, const sighting& s){
+        int64_t skew = static_cast<int64_t>(token_interval(s.begin))
+            - (static_cast<int64_t>(keys[k].day) * TOKENS_PER_DAY + i);
+        if(skew >= -static_cast<int64_t>(TOKEN_TOLERANCE) && skew <= TOKEN_TOLERANCE){
+            rez.push_back(token_match{k, i, s});
+        }
+    };
+    TokenPRF prf;
+    for(auto& d : by_day){
+        // Clocks disagree a little, so a token may be logged a day off
+        std::vector<const sighting*> seen;
+        std::vector<rolling_token> heard;
+        for(uint32_t day = d.first > 0 ? d.first - 1 : 0; day <= d.first + 1; day++){
+            for(auto& s : load(day)){
+                seen.push_back(&s);
+                heard.push_back(s.token);
+            }
+        }
+        if(heard.empty()){
+            continue;
+        }
+
+        uint64_t count = d.second.size() * TOKENS_PER_DAY;
+        if(count >= TOKEN_SKEW * heard.size()){
+            // Far fewer sightings: stream the published tokens past them
+            TokenTable table(heard.size());
+            for(uint32_t j = 0; j < heard.size(); j++){
+                table.Insert(heard[j], j);
+            }
+            std::vector<rolling_token> tokens(TOKENS_PER_DAY);
+            for(uint32_t k : d.second){
+                prf.Expand(keys[k], 0, TOKENS_PER_DAY, tokens.data());
+                for(uint32_t i = 0; i < TOKENS_PER_DAY; i++){
+                    for(uint64_t slot = table.Find(tokens[i]); slot != TokenTable::NONE; slot = table.Next(tokens[i], slot)){
+                        add(k, i, *seen[table.Value(slot)]);
+                    }
+                }
+            }
+            continue;
+        }
+
+        std::vector<rolling_token> published(count);
+        for(uint32_t j = 0; j < d.second.size(); j++){
+            prf.Expand(keys[d.second[j]], 0, TOKENS_PER_DAY, &published[j * TOKENS_PER_DAY]);
+        }
+        for(auto& m : intersect_tokens(published, heard)){
+            add(d.second[m.first / TOKENS_PER_DAY], m.first % TOKENS_PER_DAY, *seen[m.second]);
+        }
+    }
+    return rez;
+}
+
+inline size_t TokenLog::Resolve(const std::vector<day_key>& keys, Contact& c){
+    std::map<uint32_t, contact_interval> heard;
+    for(auto& m : Match(keys)){
+        auto it = heard.find(m.key);
+        if(it == heard.end()){
+            heard[m.key] = contact_interval{m.seen.begin, m.seen.end};
+        }else{
+            it->second.begin = std::min(it->second.begin, m.seen.begin);
+            it->second.end = std::max(it->second.end, m.seen.end);
+        }
+    }
+    // Keys resolved before are already contacts of the user over the
+    // span heard then; only spans not covered yet are added
+    std::multimap<std::string, contact_interval> known;
+    if(!c.Graph().empty()){
+        for(size_t i = 0; i < c.Graph()[0].size(); i++){
+            known.insert(std::make_pair(c.UID(c.Graph()[0][i]), c.Times()[0][i]));
+        }
+    }
+    size_t added = 0;
+    for(auto& h : heard){
+        contact_data d;
+        d.uid = key_uid(keys[h.first]);
+        auto range = known.equal_range(d.uid);
+        bool covered = false;
+        for(auto it = range.first; it != range.second && !covered; ++it){
+            covered = it->second.begin <= h.second.begin && h.second.end <= it->second.end;
+        }
+        if(!covered){
+            c.AddContact(d.uid, d, h.second);
+            added++;
+        }
+    }
+    return added;
+}
+
+inline void TokenLog::Expire(uint32_t day){
+    while(!days.empty() && days.begin()->first < day){
+        days.erase(days.begin());
+    }
+    if(dir.empty()){
+        return;
+    }
+    // Logs may be on disk without having been loaded
+    DIR* d = opendir(dir.c_str());
+    if(!d){
+        return;
+    }
+    while(struct dirent* e = readdir(d)){
+        unsigned long n;
+        char rest[8];
+        if(sscanf(e->d_name, "%lu.token%7s", &n, rest) == 2 && strcmp(rest, "s") == 0 && n < day){
+            std::remove((dir + "/" + e->d_name).c_str());
+        }
+    }
+    closedir(d);
+}